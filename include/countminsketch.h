@@ -0,0 +1,149 @@
+/**
+ * @file countminsketch.h
+ * @brief Header file for the CountMinSketch class, a frequency sketch of 64 bit keys.
+ *
+ * Counts how often keys such as class pairs occur without a counter per key:
+ * an exact confusion or co-occurrence matrix of C classes needs C^2 counters,
+ * the sketch a fixed depth x width table. Every key maps to one counter per
+ * row and its estimate is the smallest of them, which never undercounts and
+ * overcounts by at most e / width of the total weight with probability
+ * 1 - e^-depth.
+ *
+ * The update is conservative: only the counters at the current minimum are
+ * raised, which keeps the collisions of frequent keys out of the rare ones.
+ * One 128 bit hash per key gives the column of every row by double hashing.
+ *
+ * The table does not keep keys, so a small set of candidates with the largest
+ * estimates is tracked next to it for the heavy hitter queries.
+ */
+
+#ifndef COUNT_MIN_SKETCH_H
+#define COUNT_MIN_SKETCH_H
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "sketcharena.h"
+
+/**
+ * @class CountMinSketch
+ * @brief Count-min sketch with conservative update and heavy hitter candidates.
+ */
+class CountMinSketch {
+public:
+    // (key, estimated count)
+    typedef std::pair<uint64_t, uint64_t> heavy_hitter;
+
+    static constexpr uint32_t DEFAULT_WIDTH = 2048;
+    static constexpr uint8_t DEFAULT_DEPTH = 4;
+    static constexpr uint32_t MAX_WIDTH = 1u << 24;
+    static constexpr uint8_t MAX_DEPTH = 8;
+    static constexpr uint32_t DEFAULT_MAX_CANDIDATES = 64;
+
+    /**
+     * @brief Constructor to initialize CountMinSketch object
+     * @param width Counters per row, at most MAX_WIDTH, rounded up to a power of two
+     * @param depth Number of rows, in [1, MAX_DEPTH]
+     * @param max_candidates Number of keys tracked for get_heavy_hitters()
+     * @param allocator Arena allocator charging the counters to a profile
+     */
+    explicit CountMinSketch(uint32_t width = DEFAULT_WIDTH, uint8_t depth = DEFAULT_DEPTH,
+                            uint32_t max_candidates = DEFAULT_MAX_CANDIDATES,
+                            const ArenaAllocator<uint32_t>& allocator = ArenaAllocator<uint32_t>());
+    CountMinSketch(const CountMinSketch& other);
+    CountMinSketch& operator=(const CountMinSketch& other) = delete;
+
+    /**
+     * @brief Key of an ordered class pair, e.g. (top-1, top-2)
+     */
+    static uint64_t pair_key(int first, int second) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(first)) << 32) | static_cast<uint32_t>(second);
+    }
+
+    /**
+     * @brief Classes of a key made by pair_key()
+     */
+    static std::pair<int, int> pair_classes(uint64_t key) {
+        return {static_cast<int>(static_cast<uint32_t>(key >> 32)), static_cast<int>(static_cast<uint32_t>(key))};
+    }
+
+    /**
+     * @brief Adds weight occurrences of a key, safe to call from any thread
+     */
+    void update(uint64_t key, uint32_t weight = 1);
+
+    /**
+     * @brief Merges a sketch with the same width and depth, e.g. from another device
+     */
+    void merge(const CountMinSketch& other);
+
+    /**
+     * @brief Returns the estimated count of a key, never below the true count
+     */
+    uint64_t get_estimate(uint64_t key) const;
+
+    /**
+     * @brief Returns the tracked keys with an estimate of at least min_count, largest first
+     */
+    std::vector<heavy_hitter> get_heavy_hitters(uint64_t min_count = 1) const;
+
+    /**
+     * @brief Sum of all update weights
+     */
+    uint64_t get_total_weight() const;
+
+    uint32_t get_width() const { return width_; }
+    uint8_t get_depth() const { return depth_; }
+
+    /**
+     * @brief Overcount bound of an estimate as a fraction of the total weight
+     */
+    double get_relative_error() const;
+
+    /**
+     * @brief Serializes the counters and the candidate keys
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Deserializes a sketch written by serialize()
+     */
+    static CountMinSketch deserialize(std::istream& is,
+                                      const ArenaAllocator<uint32_t>& allocator = ArenaAllocator<uint32_t>());
+
+#ifndef TEST
+private:
+#endif
+    static constexpr uint8_t SERIAL_VERSION = 1;
+    static constexpr uint8_t FAMILY = 0xEA;
+
+    typedef std::vector<uint32_t, ArenaAllocator<uint32_t>> Counters;
+
+    /**
+     * @brief Counter index of the key in every row
+     */
+    void locate(uint64_t key, uint32_t* indices) const;
+    uint32_t estimate_locked(const uint32_t* indices) const;
+
+    /**
+     * @brief Keeps the key among the candidates if its estimate is large enough
+     */
+    void offer_candidate(uint64_t key, uint32_t estimate);
+
+    uint32_t width_;
+    uint8_t depth_;
+    uint32_t max_candidates_;
+    uint64_t total_weight_;
+    // Row-major depth x width table, saturating at UINT32_MAX
+    Counters counters_;
+    // Candidate keys with their estimate when last seen
+    std::unordered_map<uint64_t, uint32_t> candidates_;
+    // Smallest candidate estimate, keys below it are not offered a slot
+    uint32_t candidate_floor_;
+    mutable std::mutex mutex_;
+};
+
+#endif // COUNT_MIN_SKETCH_H
@@ -3,19 +3,24 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <opencv2/opencv.hpp>  // For OpenCV matrix types
 #include <iostream>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <atomic>
 #include "saver.h"
 #include "generic.h"
+#include "shardedsketch.h"
 #include <kll_sketch.hpp>
+#include "sketcharena.h"
 
 
 /**
  * @brief Class for managing and logging model statistics
  */
-typedef datasketches::kll_sketch<float> distributionBox;
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
 
 class CustomProfile {
 public:
@@ -32,7 +37,7 @@ public:
     ~CustomProfile();
 
     /**
-     * @brief Computes and logs selected statistics
+     * @brief Computes and logs selected statistics, safe to call from several threads
      * @param name Name of the statistic to profile
      * @param value Value to update in the statistic
      * @return 1 on success, error code on failure
@@ -47,12 +52,14 @@ private:
     void registerStatistics(const std::string& name);
 
     /**
-     * @brief Gets the distributionBox (KLL sketch) for the given statistic name.
+     * @brief Gets the sharded sketch for the given statistic name.
      * If it doesn't exist, a new one is created and added to the map.
      * @param name Statistic name
-     * @return Pointer to the distributionBox object
+     * @param stats Map of the sketches of this type
+     * @return Pointer to the sketch
      */
-    distributionBox* getBox(const std::string& name);
+    template <typename Box>
+    Box* getBox(const std::string& name, std::unordered_map<int, Box*>& stats);
 
     // Configurations read from the INI file
     std::map<std::string, std::vector<std::string>> customConfig;
@@ -65,7 +72,19 @@ private:
     Saver* saver;
 
     // Map to store KLL sketches based on statistic names
-    std::unordered_map<int, distributionBox*> custom_stat_;
+    std::unordered_map<int, ShardedSketch*> custom_stat_;
+    // Relative-error sketches of the statistics listed in the relative_error key
+    std::unordered_map<int, ShardedReqSketch*> relative_stat_;
+    std::unordered_set<std::string> relative_metrics_;
+    // Allocator charging the sketches to the CustomProfile arena account
+    ArenaAllocator<float> arena_;
+    // Sliding window of the sketches, from the window key of the [custom] section
+    SketchWindow window_;
+    // Guards the sketch maps, threads only take it for statistics they have not seen yet
+    std::mutex stat_mutex_;
+    // Unique id of this profile, keys the thread local lookup caches
+    const uint64_t profile_id_;
+    static std::atomic<uint64_t> next_profile_id_;
 
 };
 
@@ -24,6 +24,7 @@
 #include <stdexcept>
 
 #include "common_defs.hpp"
+#include "kll_helper_simd.hpp"
 
 namespace datasketches {
 
@@ -101,6 +102,7 @@ void kll_helper::randomly_halve_down(T* buf, uint32_t start, uint32_t length) {
 #else
   const uint32_t offset = random_utils::random_bit();
 #endif
+  if (kll_simd::ops<T, std::less<T>>::halve_down(buf, start, half_length, offset)) return;
   uint32_t j = start + offset;
   for (uint32_t i = start; i < (start + half_length); i++) {
     if (i != j) buf[i] = std::move(buf[j]);
@@ -117,6 +119,7 @@ void kll_helper::randomly_halve_up(T* buf, uint32_t start, uint32_t length) {
 #else
   const uint32_t offset = random_utils::random_bit();
 #endif
+  if (kll_simd::ops<T, std::less<T>>::halve_up(buf, start, half_length, offset)) return;
   uint32_t j = (start + length) - 1 - offset;
   for (uint32_t i = (start + length) - 1; i >= (start + half_length); i--) {
     if (i != j) buf[i] = std::move(buf[j]);
@@ -134,6 +137,10 @@ void kll_helper::merge_sorted_arrays(T* buf, uint32_t start_a, uint32_t len_a, u
   const uint32_t lim_b = start_b + len_b;
   const uint32_t lim_c = start_c + len_c;
 
+  // the vectorized merge relies on the layout of compress: a, then the output, which ends with b
+  if (start_a + len_a <= start_c && start_c + len_a == start_b &&
+      kll_simd::ops<T, C>::merge(buf + start_a, len_a, buf + start_b, len_b, buf + start_c)) return;
+
   uint32_t a = start_a;
   uint32_t b = start_b;
 
@@ -166,6 +173,9 @@ void kll_helper::merge_sorted_arrays(const T* buf_a, uint32_t start_a, uint32_t
   const uint32_t lim_b = start_b + len_b;
   const uint32_t lim_c = start_c + len_c;
 
+  // floats need no construction or destruction, the vectorized merge writes them directly
+  if (kll_simd::ops<T, C>::merge(buf_a + start_a, len_a, buf_b + start_b, len_b, buf_c + start_c)) return;
+
   uint32_t a = start_a;
   uint32_t b = start_b;
 
@@ -0,0 +1,217 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef KLL_HELPER_SIMD_HPP_
+#define KLL_HELPER_SIMD_HPP_
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(KLL_NO_SIMD)
+#define KLL_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace datasketches {
+
+/*
+ * Vectorized compaction kernels for kll_sketch<float, std::less<float>>.
+ *
+ * The kernels are selected at runtime: AVX2 when the CPU supports it, the
+ * scalar loops of kll_helper otherwise. The output is bit for bit the output of
+ * the scalar loops: halving is a plain stride-2 copy with the same random
+ * offset, and merging produces the same sorted sequence. The only floats that
+ * compare equal but differ in their bits are -0 and +0, whose relative order
+ * after a merge network could differ from the stable scalar merge, so inputs
+ * containing -0 take the scalar path.
+ */
+namespace kll_simd {
+
+inline std::atomic<bool>& enabled_flag() {
+  static std::atomic<bool> enabled(true);
+  return enabled;
+}
+
+// for tests and benchmarks, forces the scalar loops when set to false
+inline void set_enabled(bool enabled) {
+  enabled_flag().store(enabled, std::memory_order_relaxed);
+}
+
+// generic types and comparators always use the scalar loops
+template<typename T, typename C>
+struct ops {
+  static bool halve_down(T*, uint32_t, uint32_t, uint32_t) { return false; }
+  static bool halve_up(T*, uint32_t, uint32_t, uint32_t) { return false; }
+  static bool merge(const T*, uint32_t, const T*, uint32_t, T*) { return false; }
+};
+
+#ifdef KLL_SIMD_AVX2
+
+inline bool use_avx2() {
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported && enabled_flag().load(std::memory_order_relaxed);
+}
+
+// keeps the even (odd = false) or odd (odd = true) elements of 16 consecutive floats
+__attribute__((target("avx2")))
+inline __m256 gather_stride2_avx2(const float* src, bool odd) {
+  const __m256 lo = _mm256_loadu_ps(src);
+  const __m256 hi = _mm256_loadu_ps(src + 8);
+  const __m256 mixed = odd ? _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))
+                           : _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mixed), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// buf[start + i] = buf[start + offset + 2 * i] for i in [0, half_length)
+__attribute__((target("avx2")))
+inline void halve_down_avx2(float* buf, uint32_t start, uint32_t half_length, uint32_t offset) {
+  uint32_t i = 0;
+  for (; i + 8 <= half_length && offset + 2 * i + 16 <= 2 * half_length; i += 8) {
+    _mm256_storeu_ps(buf + start + i, gather_stride2_avx2(buf + start + offset + 2 * i, false));
+  }
+  for (; i < half_length; i++) {
+    buf[start + i] = buf[start + offset + 2 * i];
+  }
+}
+
+// buf[end - 1 - i] = buf[end - 1 - offset - 2 * i] for i in [0, half_length)
+__attribute__((target("avx2")))
+inline void halve_up_avx2(float* buf, uint32_t start, uint32_t half_length, uint32_t offset) {
+  const uint32_t end = start + 2 * half_length;
+  uint32_t i = 0;
+  for (; i + 8 <= half_length && offset + 2 * i + 16 <= 2 * half_length; i += 8) {
+    _mm256_storeu_ps(buf + end - 8 - i, gather_stride2_avx2(buf + end - 16 - offset - 2 * i, true));
+  }
+  for (; i < half_length; i++) {
+    buf[end - 1 - i] = buf[end - 1 - offset - 2 * i];
+  }
+}
+
+// sorts a bitonic vector with three half-cleaner stages
+__attribute__((target("avx2")))
+inline __m256 bitonic_clean_avx2(__m256 v) {
+  __m256 s = _mm256_permute2f128_ps(v, v, 0x01);
+  v = _mm256_blend_ps(_mm256_min_ps(v, s), _mm256_max_ps(v, s), 0xF0);
+  s = _mm256_permute_ps(v, _MM_SHUFFLE(1, 0, 3, 2));
+  v = _mm256_blend_ps(_mm256_min_ps(v, s), _mm256_max_ps(v, s), 0xCC);
+  s = _mm256_permute_ps(v, _MM_SHUFFLE(2, 3, 0, 1));
+  return _mm256_blend_ps(_mm256_min_ps(v, s), _mm256_max_ps(v, s), 0xAA);
+}
+
+// merges two sorted vectors, lo gets the 8 smallest and hi the 8 largest, both sorted
+__attribute__((target("avx2")))
+inline void bitonic_merge_avx2(__m256& lo, __m256& hi) {
+  const __m256 reversed = _mm256_permutevar8x32_ps(hi, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+  const __m256 mins = _mm256_min_ps(lo, reversed);
+  const __m256 maxs = _mm256_max_ps(lo, reversed);
+  lo = bitonic_clean_avx2(mins);
+  hi = bitonic_clean_avx2(maxs);
+}
+
+__attribute__((target("avx2")))
+inline bool has_negative_zero_avx2(const float* data, uint32_t n) {
+  const __m256i negative_zero = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+  uint32_t i = 0;
+  __m256i found = _mm256_setzero_si256();
+  for (; i + 8 <= n; i += 8) {
+    const __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+    found = _mm256_or_si256(found, _mm256_cmpeq_epi32(bits, negative_zero));
+  }
+  if (!_mm256_testz_si256(found, found)) return true;
+  for (; i < n; i++) {
+    if (data[i] == 0 && std::signbit(data[i])) return true;
+  }
+  return false;
+}
+
+/*
+ * Merges the sorted arrays a and b into out with 8x8 bitonic merges.
+ * out may overlap the inputs as long as it never runs ahead of the unread part
+ * of an input, which holds for the in-place merge of kll_helper::compress.
+ */
+__attribute__((target("avx2")))
+inline bool merge_avx2(const float* a, uint32_t len_a, const float* b, uint32_t len_b, float* out) {
+  if (len_a < 8 || len_b < 8) return false;
+  if (has_negative_zero_avx2(a, len_a) || has_negative_zero_avx2(b, len_b)) return false;
+
+  __m256 lo = _mm256_loadu_ps(a);
+  __m256 hi = _mm256_loadu_ps(b);
+  uint32_t ia = 8;
+  uint32_t ib = 8;
+  bitonic_merge_avx2(lo, hi);
+  _mm256_storeu_ps(out, lo);
+  uint32_t ic = 8;
+
+  // the block with the smaller head holds the next smallest items
+  while (ia + 8 <= len_a && ib + 8 <= len_b) {
+    if (a[ia] < b[ib]) {
+      lo = _mm256_loadu_ps(a + ia);
+      ia += 8;
+    } else {
+      lo = _mm256_loadu_ps(b + ib);
+      ib += 8;
+    }
+    bitonic_merge_avx2(lo, hi);
+    _mm256_storeu_ps(out + ic, lo);
+    ic += 8;
+  }
+
+  // three-way merge of the pending block with the tails of a and b
+  float pending[8];
+  _mm256_storeu_ps(pending, hi);
+  uint32_t ip = 0;
+  while (ip < 8 || ia < len_a || ib < len_b) {
+    if (ip < 8 && (ia == len_a || pending[ip] <= a[ia]) && (ib == len_b || pending[ip] <= b[ib])) {
+      out[ic++] = pending[ip++];
+    } else if (ia < len_a && (ib == len_b || a[ia] < b[ib])) {
+      out[ic++] = a[ia++];
+    } else {
+      out[ic++] = b[ib++];
+    }
+  }
+  return true;
+}
+
+template<>
+struct ops<float, std::less<float>> {
+  static bool halve_down(float* buf, uint32_t start, uint32_t half_length, uint32_t offset) {
+    if (!use_avx2()) return false;
+    halve_down_avx2(buf, start, half_length, offset);
+    return true;
+  }
+  static bool halve_up(float* buf, uint32_t start, uint32_t half_length, uint32_t offset) {
+    if (!use_avx2()) return false;
+    halve_up_avx2(buf, start, half_length, offset);
+    return true;
+  }
+  static bool merge(const float* a, uint32_t len_a, const float* b, uint32_t len_b, float* out) {
+    if (!use_avx2()) return false;
+    return merge_avx2(a, len_a, b, len_b, out);
+  }
+};
+
+#endif // KLL_SIMD_AVX2
+
+} /* namespace kll_simd */
+
+} /* namespace datasketches */
+
+#endif // KLL_HELPER_SIMD_HPP_
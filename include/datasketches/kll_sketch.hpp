@@ -230,6 +230,17 @@ class kll_sketch {
     template<typename FwdT>
     void update(FwdT&& item);
 
+    /**
+     * Updates this sketch with a batch of items.
+     * The items are copied straight into the free space of level 0, which
+     * acts as the staging buffer, and the level is sorted once when it is
+     * compacted. The resulting sketch is the same as after calling update()
+     * for every item, so the error guarantees are unchanged.
+     * @param first pointer to the first item
+     * @param n number of items
+     */
+    void update(const T* first, size_t n);
+
     /**
      * Merges another sketch into this one.
      * @param other sketch to merge into this one
@@ -602,6 +613,9 @@ class kll_sketch {
     // for type converting constructor
     template<typename TT, typename CC, typename AA> friend class kll_sketch;
 
+    // reads the serialized layout without deserializing
+    template<typename TT, typename CC> friend class kll_sketch_view;
+
     void setup_sorted_view() const; // modifies mutable state
     void reset_sorted_view();
 };
@@ -185,6 +185,27 @@ void kll_sketch<T, C, A>::update(FwdT&& item) {
   reset_sorted_view();
 }
 
+template<typename T, typename C, typename A>
+void kll_sketch<T, C, A>::update(const T* first, size_t n) {
+  size_t i = 0;
+  while (i < n) {
+    // Like update(), an invalid item never triggers a compaction
+    while (i < n && !check_update_item(first[i])) ++i;
+    if (i == n) break;
+    if (levels_[0] == 0) compress_while_updating();
+    uint32_t index = levels_[0];
+    for (; i < n && index > 0; i++) {
+      if (!check_update_item(first[i])) continue;
+      update_min_max(first[i]);
+      n_++;
+      new (&items_[--index]) T(first[i]);
+    }
+    if (index != levels_[0]) is_level_zero_sorted_ = false;
+    levels_[0] = index;
+  }
+  reset_sorted_view();
+}
+
 template<typename T, typename C, typename A>
 void kll_sketch<T, C, A>::update_min_max(const T& item) {
   if (is_empty()) {
@@ -0,0 +1,306 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef KLL_SKETCH_VIEW_HPP_
+#define KLL_SKETCH_VIEW_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "kll_sketch.hpp"
+#include "memory_operations.hpp"
+
+namespace datasketches {
+
+/*
+ * Read-only view of a serialized KLL sketch of an arithmetic type.
+ *
+ * The view validates the header once and then answers queries directly from
+ * the borrowed bytes, for example a memory-mapped file, without deserializing
+ * the sketch and without allocating. The bytes must outlive the view.
+ *
+ * Queries follow the semantics of quantiles_sorted_view, so they return the
+ * same results as the deserialized sketch. Instead of merging all levels into
+ * one sorted array, ranks are summed over the levels with a binary search in
+ * every sorted level, and a quantile is the smallest retained item whose
+ * cumulative weight reaches the requested rank.
+ */
+template<typename T, typename C = std::less<T>>
+class kll_sketch_view {
+  static_assert(std::is_arithmetic<T>::value, "kll_sketch_view only supports arithmetic types");
+public:
+  using sketch_type = kll_sketch<T, C>;
+
+  /**
+   * Validates the serialized header and the size of the span
+   * @param bytes pointer to the serialized sketch
+   * @param size size of the serialized sketch in bytes
+   * @param comparator instance of a Comparator
+   */
+  kll_sketch_view(const void* bytes, size_t size, const C& comparator = C());
+
+  bool is_empty() const { return n_ == 0; }
+  uint16_t get_k() const { return k_; }
+  uint64_t get_n() const { return n_; }
+  uint32_t get_num_retained() const { return capacity_ - level_start(0); }
+  bool is_estimation_mode() const { return num_levels_ > 1; }
+
+  T get_min_item() const;
+  T get_max_item() const;
+
+  /**
+   * Returns the approximate normalized rank of the given item, see kll_sketch::get_rank()
+   */
+  double get_rank(T item, bool inclusive = true) const;
+
+  /**
+   * Returns the approximate quantile of the given normalized rank, see kll_sketch::get_quantile()
+   */
+  T get_quantile(double rank, bool inclusive = true) const;
+
+  /**
+   * Writes the approximate CDF of the given split points into cdf, see kll_sketch::get_CDF()
+   * @param split_points unique and monotonically increasing items
+   * @param size number of split points
+   * @param cdf output array of size + 1 ranks, the last one is 1
+   */
+  void get_CDF(const T* split_points, uint32_t size, double* cdf, bool inclusive = true) const;
+
+private:
+  C comparator_;
+  const char* items_;    // first retained item
+  const char* levels_;   // serialized level offsets, nullptr for a single item
+  uint64_t n_;
+  uint32_t capacity_;
+  uint16_t k_;
+  uint8_t num_levels_;
+  bool is_level_zero_sorted_;
+  T min_item_;
+  T max_item_;
+
+  // offset of the level in the items array of the sketch, capacity_ for the end of the top level
+  uint32_t level_start(uint8_t level) const;
+  T item(uint32_t index) const;
+
+  // total weight of the retained items less than (or equal to if inclusive) item
+  uint64_t get_weight(T item, bool inclusive) const;
+};
+
+template<typename T, typename C>
+kll_sketch_view<T, C>::kll_sketch_view(const void* bytes, size_t size, const C& comparator):
+comparator_(comparator),
+items_(nullptr),
+levels_(nullptr),
+n_(0),
+capacity_(0),
+k_(0),
+num_levels_(0),
+is_level_zero_sorted_(false),
+min_item_(),
+max_item_()
+{
+  ensure_minimum_memory(size, sketch_type::EMPTY_SIZE_BYTES);
+  const char* ptr = static_cast<const char*>(bytes);
+  uint8_t preamble_ints;
+  ptr += copy_from_mem(ptr, preamble_ints);
+  uint8_t serial_version;
+  ptr += copy_from_mem(ptr, serial_version);
+  uint8_t family_id;
+  ptr += copy_from_mem(ptr, family_id);
+  uint8_t flags_byte;
+  ptr += copy_from_mem(ptr, flags_byte);
+  ptr += copy_from_mem(ptr, k_);
+  uint8_t m;
+  ptr += copy_from_mem(ptr, m);
+  ptr += sizeof(uint8_t); // skip unused byte
+
+  sketch_type::check_m(m);
+  sketch_type::check_preamble_ints(preamble_ints, flags_byte);
+  sketch_type::check_serial_version(serial_version);
+  sketch_type::check_family_id(family_id);
+  ensure_minimum_memory(size, preamble_ints * sizeof(uint32_t));
+
+  if (flags_byte & (1 << sketch_type::flags::IS_EMPTY)) return;
+
+  const bool is_single_item(flags_byte & (1 << sketch_type::flags::IS_SINGLE_ITEM));
+  if (is_single_item) {
+    n_ = 1;
+    num_levels_ = 1;
+  } else {
+    ptr += copy_from_mem(ptr, n_);
+    ptr += sizeof(uint16_t); // min k
+    ptr += copy_from_mem(ptr, num_levels_);
+    ptr += sizeof(uint8_t); // skip unused byte
+    if (num_levels_ == 0 || num_levels_ > 61) throw std::invalid_argument("number of levels must be in [1, 61]");
+    ensure_minimum_memory(size, sketch_type::DATA_START + num_levels_ * sizeof(uint32_t) + 2 * sizeof(T));
+    levels_ = ptr;
+    ptr += num_levels_ * sizeof(uint32_t);
+    ptr += copy_from_mem(ptr, min_item_);
+    ptr += copy_from_mem(ptr, max_item_);
+  }
+  capacity_ = kll_helper::compute_total_capacity(k_, m, num_levels_);
+  is_level_zero_sorted_ = (flags_byte & (1 << sketch_type::flags::IS_LEVEL_ZERO_SORTED)) > 0;
+  items_ = ptr;
+
+  // the levels are borrowed as they are, so they have to be consistent
+  uint64_t total_weight = 0;
+  for (uint8_t level = 0; level < num_levels_; ++level) {
+    const uint32_t start = level_start(level);
+    const uint32_t end = level_start(level + 1);
+    if (start > end) throw std::invalid_argument("corrupted levels: level " + std::to_string(level) + " is not monotonic");
+    total_weight += static_cast<uint64_t>(end - start) << level;
+  }
+  if (total_weight != n_) throw std::invalid_argument("corrupted levels: total weight " + std::to_string(total_weight)
+      + " != n " + std::to_string(n_));
+  const size_t expected = (items_ - static_cast<const char*>(bytes)) + get_num_retained() * sizeof(T);
+  if (expected != size) throw std::invalid_argument("serialized size mismatch: " + std::to_string(expected)
+      + " != " + std::to_string(size));
+  if (is_single_item) {
+    min_item_ = item(level_start(0));
+    max_item_ = min_item_;
+  }
+}
+
+template<typename T, typename C>
+uint32_t kll_sketch_view<T, C>::level_start(uint8_t level) const {
+  if (level == num_levels_) return capacity_;
+  if (levels_ == nullptr) return capacity_ - 1; // single item
+  uint32_t offset;
+  copy_from_mem(levels_ + level * sizeof(uint32_t), offset);
+  return offset;
+}
+
+template<typename T, typename C>
+T kll_sketch_view<T, C>::item(uint32_t index) const {
+  T value;
+  copy_from_mem(items_ + (index - level_start(0)) * sizeof(T), value);
+  return value;
+}
+
+template<typename T, typename C>
+T kll_sketch_view<T, C>::get_min_item() const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return min_item_;
+}
+
+template<typename T, typename C>
+T kll_sketch_view<T, C>::get_max_item() const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return max_item_;
+}
+
+template<typename T, typename C>
+uint64_t kll_sketch_view<T, C>::get_weight(T value, bool inclusive) const {
+  // an item is counted if it is before value in the sorted order
+  auto counts = [this, value, inclusive](T x) {
+    return inclusive ? !comparator_(value, x) : comparator_(x, value);
+  };
+  uint64_t weight = 0;
+  for (uint8_t level = 0; level < num_levels_; ++level) {
+    uint32_t lo = level_start(level);
+    uint32_t hi = level_start(level + 1);
+    if (level == 0 && !is_level_zero_sorted_) {
+      for (uint32_t i = lo; i < hi; ++i) {
+        if (counts(item(i))) weight += 1;
+      }
+      continue;
+    }
+    const uint32_t start = lo;
+    while (lo < hi) {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (counts(item(mid))) lo = mid + 1; else hi = mid;
+    }
+    weight += static_cast<uint64_t>(lo - start) << level;
+  }
+  return weight;
+}
+
+template<typename T, typename C>
+double kll_sketch_view<T, C>::get_rank(T value, bool inclusive) const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return static_cast<double>(get_weight(value, inclusive)) / n_;
+}
+
+template<typename T, typename C>
+T kll_sketch_view<T, C>::get_quantile(double rank, bool inclusive) const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  if ((rank < 0.0) || (rank > 1.0)) {
+    throw std::invalid_argument("normalized rank cannot be less than zero or greater than 1.0");
+  }
+  const uint64_t weight = static_cast<uint64_t>(inclusive ? std::ceil(rank * n_) : rank * n_);
+  // same as the lower (upper) bound on the cumulative weights of the sorted view
+  auto reaches = [this, weight, inclusive](T x) {
+    const uint64_t cumulative = get_weight(x, true);
+    return inclusive ? cumulative >= weight : cumulative > weight;
+  };
+
+  bool found = false;
+  T best = T();
+  T largest = T();
+  bool has_largest = false;
+  for (uint8_t level = 0; level < num_levels_; ++level) {
+    uint32_t lo = level_start(level);
+    uint32_t hi = level_start(level + 1);
+    if (lo == hi) continue;
+    if (level == 0 && !is_level_zero_sorted_) {
+      for (uint32_t i = lo; i < hi; ++i) {
+        const T x = item(i);
+        if (!has_largest || comparator_(largest, x)) { largest = x; has_largest = true; }
+        if ((!found || comparator_(x, best)) && reaches(x)) { best = x; found = true; }
+      }
+      continue;
+    }
+    const T top = item(hi - 1);
+    if (!has_largest || comparator_(largest, top)) { largest = top; has_largest = true; }
+    // the cumulative weight grows with the item, so the first item reaching it is the candidate of this level
+    while (lo < hi) {
+      const uint32_t mid = lo + (hi - lo) / 2;
+      if (reaches(item(mid))) hi = mid; else lo = mid + 1;
+    }
+    if (lo < level_start(level + 1)) {
+      const T x = item(lo);
+      if (!found || comparator_(x, best)) { best = x; found = true; }
+    }
+  }
+  // like the sorted view, a rank beyond the last cumulative weight returns the largest item
+  return found ? best : largest;
+}
+
+template<typename T, typename C>
+void kll_sketch_view<T, C>::get_CDF(const T* split_points, uint32_t size, double* cdf, bool inclusive) const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  for (uint32_t i = 0; i < size; ++i) {
+    if (std::is_floating_point<T>::value && std::isnan(static_cast<double>(split_points[i]))) {
+      throw std::invalid_argument("Values must not be NaN");
+    }
+    if ((i < (size - 1)) && !comparator_(split_points[i], split_points[i + 1])) {
+      throw std::invalid_argument("Values must be unique and monotonically increasing");
+    }
+  }
+  for (uint32_t i = 0; i < size; ++i) cdf[i] = get_rank(split_points[i], inclusive);
+  cdf[size] = 1;
+}
+
+} /* namespace datasketches */
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef DRIFT_METRICS_H
+#define DRIFT_METRICS_H
+
+#include <kll_sketch.hpp>
+#include "sketcharena.h"
+
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
+// Sorted view of a distributionBox, built once per query batch
+typedef datasketches::quantiles_sorted_view<float, std::less<float>, ArenaAllocator<float>> sortedView;
+
+/**
+ * @brief Drift of a live distribution against its baseline
+ */
+struct DriftScores {
+    // Largest distance between the two CDFs
+    double ks;
+    // Population stability index over bins of equal baseline mass
+    double psi;
+    // Wasserstein-1 (earth mover's) distance, integral |F(x) - G(x)| dx
+    double wasserstein;
+};
+
+/**
+ * @class DriftMetrics
+ * @brief Distances between two distributions summarized by KLL sketches.
+ *
+ * All metrics walk the sorted views of both sketches once, so the cost is
+ * linear in the number of retained items and independent of the stream length.
+ * An empty sketch on either side yields NaN.
+ */
+class DriftMetrics {
+public:
+    static constexpr uint32_t DEFAULT_PSI_BINS = 10;
+
+    /**
+     * @brief Energy distance 2 * integral (F(x) - G(x))^2 dx between two 1-D distributions.
+     *
+     * The energy distance is the MMD of the distance kernel, averaging it over
+     * random projections gives the sliced energy distance of the embeddings.
+     */
+    static double computeEnergyDistance(const distributionBox& live, const distributionBox& baseline);
+
+    /**
+     * @brief Kolmogorov-Smirnov distance, the largest gap between the two CDFs
+     */
+    static double computeKSDistance(const distributionBox& live, const distributionBox& baseline);
+
+    /**
+     * @brief Population stability index, the bins hold equal baseline mass
+     * @param bins Number of bins, the edges are the baseline quantiles
+     */
+    static double computePSI(const distributionBox& live, const distributionBox& baseline,
+                             uint32_t bins = DEFAULT_PSI_BINS);
+
+    /**
+     * @brief Wasserstein-1 distance, integral |F(x) - G(x)| dx
+     */
+    static double computeWasserstein(const distributionBox& live, const distributionBox& baseline);
+
+    /**
+     * @brief Computes KS, PSI and Wasserstein-1 from sorted views in one pass
+     *
+     * The baseline view can be built once and reused for every interval, so
+     * only the live view costs O(k log k) per call.
+     */
+    static DriftScores computeDrift(const sortedView& live, const sortedView& baseline,
+                                    uint32_t bins = DEFAULT_PSI_BINS);
+};
+
+#endif // DRIFT_METRICS_H
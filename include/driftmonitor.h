@@ -0,0 +1,94 @@
+/**
+ * @file driftmonitor.h
+ * @brief Header file for the DriftMonitor class, on-device drift against baseline sketches.
+ *
+ * The baselines are KLL sketches profiled on the training data, stored with
+ * the same file names as the live statistics, e.g. brightness.bin. They are
+ * loaded once at startup and their sorted views are kept, so every save
+ * interval only builds the sorted view of the live sketch. No work is done
+ * per frame. The scores of all metrics go into one small CSV report next to
+ * the statistics, so a device can raise drift alerts without uploading the
+ * sketches.
+ */
+
+#ifndef DRIFT_MONITOR_H
+#define DRIFT_MONITOR_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "driftmetrics.h"
+#include "reqsketch.h"
+
+class DriftMonitor {
+public:
+    /**
+     * @brief Constructor to initialize DriftMonitor object
+     * @param baseline_dir Directory of the baseline sketches
+     * @param report_path File the drift report is written to
+     * @param psi_bins Number of bins of the population stability index
+     */
+    DriftMonitor(const std::string& baseline_dir, const std::string& report_path,
+                 uint32_t psi_bins = DriftMetrics::DEFAULT_PSI_BINS);
+
+    /**
+     * @brief Loads the baseline of a metric from <baseline_dir>/<name>.bin
+     * @return true if the metric has a non-empty baseline
+     */
+    bool addMetric(const std::string& name);
+
+    bool hasMetric(const std::string& name) const;
+
+    /**
+     * @brief Scores the live sketch of a metric against its baseline
+     */
+    void update(const std::string& name, const distributionBox& live);
+
+    /**
+     * @brief Scores the live relative-error sketch of a metric against its baseline
+     */
+    void update(const std::string& name, const ReqSketch& live);
+
+    /**
+     * @brief Writes the latest scores of all metrics, one line per metric:
+     * metric,n,ks,psi,wasserstein
+     *
+     * The Saver writes the report to a temporary file of its save cycle and
+     * renames it into place with the sketches.
+     */
+    void writeReport(std::ostream& os) const;
+
+    /**
+     * @brief Returns the file the Saver writes the report to
+     */
+    const std::string& getReportPath() const;
+
+    /**
+     * @brief Returns the latest scores of a metric, NaN before the first update
+     */
+    DriftScores getScores(const std::string& name) const;
+
+#ifndef TEST
+private:
+#endif
+    // Only the sorted view of a baseline is kept, it holds copies of the items
+    struct Metric {
+        sortedView baseline_view;
+        DriftScores scores;
+        uint64_t n;
+    };
+
+    std::string baseline_dir_;
+    std::string report_path_;
+    uint32_t psi_bins_;
+    // Guards metrics_, profiles register metrics while the saver thread scores
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Metric>> metrics_;
+
+    void score(const std::string& name, const sortedView& live_view, uint64_t n);
+};
+
+#endif // DRIFT_MONITOR_H
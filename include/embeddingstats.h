@@ -0,0 +1,136 @@
+/**
+ * @file embeddingstats.h
+ * @brief Header file for the EmbeddingStats class for per-dimension embedding statistics.
+ *
+ * EmbeddingStats keeps a streaming mean and variance for every dimension of an
+ * embedding, optional KLL sketches for a configured subset of dimensions and a
+ * Frequent Directions summary of the embedding covariance. All three parts are
+ * mergeable, so summaries from different devices can be combined on the server
+ * for drift detection.
+ *
+ * The inference thread updates the statistics while the Saver serializes
+ * them: mean, variance and covariance rows are guarded by a mutex and copied
+ * out under it, the per-dimension sketches are ShardedSketch objects the Saver
+ * reads from their snapshots.
+ */
+
+#ifndef EMBEDDING_STATS_H
+#define EMBEDDING_STATS_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "shardedsketch.h"
+
+/**
+ * @class EmbeddingStats
+ * @brief Per-dimension streaming statistics of fixed size embeddings.
+ */
+class EmbeddingStats {
+public:
+    /**
+     * @brief Constructor to initialize EmbeddingStats object
+     * @param dims Number of dimensions of every embedding
+     * @param sketch_dims Dimensions which additionally get a KLL sketch
+     * @param rank Number of rows kept by the covariance summary (0 disables it)
+     * @param k KLL sketch parameter for the per-dimension sketches
+     */
+    EmbeddingStats(uint32_t dims, const std::vector<uint32_t>& sketch_dims = {},
+                   uint32_t rank = 0, uint16_t k = 200);
+    EmbeddingStats(const EmbeddingStats& other);
+    EmbeddingStats& operator=(const EmbeddingStats& other) = delete;
+    ~EmbeddingStats();
+
+    /**
+     * @brief Updates all statistics with one embedding in a single pass, safe
+     * to call concurrently with serialize()
+     * @param embedding Pointer to get_dims() values
+     */
+    void update(const float* embedding);
+
+    /**
+     * @brief Merges another summary of the same dimensionality into this one
+     * @param other Summary to merge
+     */
+    void merge(const EmbeddingStats& other);
+
+    uint32_t get_dims() const;
+    uint32_t get_rank() const;
+    uint64_t get_n() const;
+
+    /**
+     * @brief Returns a copy of the running mean of every dimension
+     */
+    std::vector<double> get_mean() const;
+
+    /**
+     * @brief Returns the (population) variance of every dimension
+     */
+    std::vector<double> get_variance() const;
+
+    /**
+     * @brief Returns the covariance summary as get_rank() x get_dims() row major matrix B.
+     *
+     * B^T B approximates the (uncentered) second moment matrix X^T X of all
+     * embeddings seen so far, with spectral error at most ||X||_F^2 / rank.
+     * The covariance follows as B^T B / n - mean * mean^T.
+     */
+    std::vector<float> get_covariance_sketch() const;
+
+    /**
+     * @brief Returns the KLL sketches of the configured dimensions keyed by dimension
+     */
+    const std::map<uint32_t, ShardedSketch*>& get_sketches() const;
+
+    /**
+     * @brief Serializes the mean, variance and covariance summary.
+     *
+     * The per-dimension KLL sketches are not part of this stream, they are
+     * saved as regular KLL files next to it. The state is copied under the
+     * lock and written after it is released, so updates only wait for the copy.
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Deserializes a summary written by serialize()
+     *
+     * The dimensions and covariance rows in the header must fit into the
+     * bytes left in the stream when the stream can seek.
+     */
+    static EmbeddingStats deserialize(std::istream& is);
+
+    /**
+     * @brief Deserializes a summary to be merged into configured
+     *
+     * Additionally rejects a header with more dimensions or a higher rank
+     * than configured, before the summary is allocated.
+     */
+    static EmbeddingStats deserialize(std::istream& is, const EmbeddingStats& configured);
+
+private:
+    static const uint8_t SERIAL_VERSION = 1;
+    static const uint8_t FAMILY = 0xE5;
+
+    uint32_t dims_;
+    uint32_t rank_;
+    uint16_t k_;
+    // Guards n_, mean_, m2_, fd_buffer_, rows_ and the sketch map
+    mutable std::mutex mutex_;
+    uint64_t n_;
+    std::vector<double> mean_;
+    std::vector<double> m2_;
+
+    // Frequent Directions buffer of 2 * rank_ rows, rows_ of them are in use
+    std::vector<float> fd_buffer_;
+    uint32_t rows_;
+
+    std::map<uint32_t, ShardedSketch*> sketches_;
+
+    static EmbeddingStats deserialize(std::istream& is, uint32_t max_dims, uint32_t max_rank);
+    void append_row(const float* row);
+    void shrink();
+};
+
+#endif // EMBEDDING_STATS_H
@@ -25,5 +25,20 @@ bool createFolder(const std::string& Savepath);
 int acquire_lock(const std::string& file_path);
 int release_lock(int fd);
 
+/**
+ * @brief Flushes the written data of one file, without its metadata where the
+ * platform allows it: fdatasync() on Linux, fsync() elsewhere.
+ *
+ * @return bool False if path cannot be opened or the flush fails.
+ */
+bool sync_file(const std::string& path);
+
+/**
+ * @brief Makes the entries of a directory durable, e.g. after renames into it.
+ *
+ * @return bool False if dir cannot be opened or fsync() fails.
+ */
+bool sync_directory(const std::string& dir);
+
 #endif // GENERIC_H
 
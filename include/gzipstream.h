@@ -0,0 +1,64 @@
+/**
+ * @file gzipstream.h
+ * @brief Header file for GzipStreambuf, streaming gzip compression of an output stream.
+ *
+ * The Saver serializes into an ostream; with compression enabled the stream
+ * is wrapped in a GzipStreambuf, which deflates every filled input block into
+ * the file as it goes. Memory stays at two fixed blocks whatever the object
+ * size, and the result is a plain gzip file the uploader sends unchanged.
+ */
+
+#ifndef GZIP_STREAM_H
+#define GZIP_STREAM_H
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+/**
+ * @class GzipStreambuf
+ * @brief Stream buffer writing the gzip compression of its input to a sink stream.
+ */
+class GzipStreambuf : public std::streambuf {
+public:
+    /**
+     * @param sink Stream receiving the compressed bytes
+     * @param level zlib level, 1 (fastest) to 9 (smallest), Z_DEFAULT_COMPRESSION for 6
+     * @throws std::runtime_error if zlib rejects the level
+     */
+    GzipStreambuf(std::ostream& sink, int level);
+    ~GzipStreambuf() override;
+
+    GzipStreambuf(const GzipStreambuf& other) = delete;
+    GzipStreambuf& operator=(const GzipStreambuf& other) = delete;
+
+    /**
+     * @brief Compresses the remaining input and writes the gzip trailer
+     * @return false if zlib or the sink failed, the output is then incomplete
+     */
+    bool finish();
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+private:
+    // Deflates the buffered input with the given flush mode
+    bool deflateBuffered(int flush);
+
+    std::ostream& sink_;
+    z_stream stream_;
+    std::vector<char> in_;
+    std::vector<char> out_;
+    bool finished_;
+};
+
+/**
+ * @brief Reads and decompresses a whole gzip file
+ * @return false if the file is missing or not valid gzip data
+ */
+bool readGzipFile(const std::string& path, std::vector<char>& data);
+
+#endif // GZIP_STREAM_H
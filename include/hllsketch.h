@@ -0,0 +1,103 @@
+/**
+ * @file hllsketch.h
+ * @brief Header file for the HllSketch class, a lock-free HyperLogLog counter.
+ *
+ * Counts the distinct items of a stream (track ids, predicted classes, scene
+ * hashes) in a fixed array of 2^lg_k one byte registers, 4 KB by default,
+ * however many items are seen. An item is hashed with the vendored
+ * MurmurHash3, the first half of the hash selects a register and the leading
+ * zeros of the second half give the rank the register keeps the maximum of.
+ * The relative standard error of the estimate is about 1.04 / sqrt(2^lg_k),
+ * 1.6% at the default size.
+ *
+ * Updates are a hash and at most one compare-and-swap, so any thread can call
+ * them while the Saver serializes the registers. Two sketches of the same
+ * size merge by taking the register maximum.
+ */
+
+#ifndef HLL_SKETCH_H
+#define HLL_SKETCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+/**
+ * @class HllSketch
+ * @brief HyperLogLog distinct counter with lock-free updates.
+ */
+class HllSketch {
+public:
+    static constexpr uint8_t DEFAULT_LG_K = 12;
+    static constexpr uint8_t MIN_LG_K = 4;
+    static constexpr uint8_t MAX_LG_K = 16;
+
+    /**
+     * @brief Constructor to initialize HllSketch object
+     * @param lg_k Log2 of the number of registers, in [MIN_LG_K, MAX_LG_K]
+     */
+    explicit HllSketch(uint8_t lg_k = DEFAULT_LG_K);
+    HllSketch(const HllSketch& other);
+    HllSketch& operator=(const HllSketch& other) = delete;
+
+    /**
+     * @brief Adds an item, safe to call concurrently from any thread
+     */
+    void update(const void* data, size_t size);
+    void update(uint64_t item);
+    void update(const std::string& item);
+
+    /**
+     * @brief Merges a sketch with the same number of registers
+     */
+    void merge(const HllSketch& other);
+
+    uint8_t get_lg_k() const { return lg_k_; }
+    bool is_empty() const;
+
+    /**
+     * @brief Returns the estimated number of distinct items
+     */
+    double get_estimate() const;
+
+    /**
+     * @brief Returns the bounds of the estimate at 1, 2 or 3 standard deviations
+     */
+    double get_lower_bound(uint8_t num_std_dev) const;
+    double get_upper_bound(uint8_t num_std_dev) const;
+
+    /**
+     * @brief Number of register changes so far, unchanged while only duplicates arrive
+     */
+    uint64_t get_version() const {
+        return version_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Serializes the registers
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Deserializes a sketch written by serialize()
+     */
+    static HllSketch deserialize(std::istream& is);
+
+#ifndef TEST
+private:
+#endif
+    static constexpr uint8_t SERIAL_VERSION = 1;
+    static constexpr uint8_t FAMILY = 0xE9;
+    // Ranks come from a whole 64 bit hash half, 65 means it was zero
+    static constexpr uint8_t MAX_RANK = 65;
+
+    void update_register(uint32_t index, uint8_t rank);
+
+    uint8_t lg_k_;
+    std::unique_ptr<std::atomic<uint8_t>[]> registers_;
+    std::atomic<uint64_t> version_;
+};
+
+#endif // HLL_SKETCH_H
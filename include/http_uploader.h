@@ -12,6 +12,8 @@
 #include <ctime>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <map>
 
 /// Number of retry attempts for uploading a file.
@@ -70,6 +72,8 @@ private:
     std::mutex upload_mutex_;          ///< Mutex for synchronizing access to shared resources.
 
     std::atomic<bool> exitUploadLoop;  ///< Atomic flag to signal stopping the upload loop.
+    std::mutex exit_mutex_;            ///< Mutex of the wait between two uploads.
+    std::condition_variable exit_cv_;  ///< Wakes the upload loop when it is stopped.
 
     std::string uploader_name_;        ///< Name of the uploader instance.
 
@@ -79,12 +83,21 @@ private:
      * @param sensorId Sensor ID to include in the upload metadata.
      * @param timestamp Timestamp of the upload.
      * @param fileType Type of the file being uploaded.
+     * @param contentType MIME type of the file content.
      * @return True if the file was successfully uploaded, false otherwise.
      */
-    bool postFile(const std::string& filePath, const std::string& sensorId, time_t timestamp, const std::string& fileType);
+    bool postFile(const std::string& filePath, const std::string& sensorId, time_t timestamp, const std::string& fileType, const std::string& contentType);
 
     /**
-     * @brief Uploads the contents of a folder, creating a tar.gz file and sending it.
+     * @brief Uploads a file, retrying up to UPLOAD_RETRY_COUNT times.
+     * @param index Index of the folder in the configuration.
+     * @return True if the file was successfully uploaded, false otherwise.
+     */
+    bool postFileWithRetry(const std::string& filePath, time_t timestamp, int index, const std::string& contentType);
+
+    /**
+     * @brief Uploads the contents of a folder, sketch bundles as they are and the
+     * other files as a tar.gz file.
      * @param index Index of the folder in the configuration.
      * @return True if the upload was successful, false otherwise.
      */
@@ -12,21 +12,26 @@
 #include "imghelpers.h"
 #include "saver.h"
 #include "generic.h"
+#include "shardedsketch.h"
+#include "hllsketch.h"
 #include <kll_sketch.hpp>
+#include "sketcharena.h"
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <map>
 #include <functional>
 
 
-// Typedef for distribution box data structure (assuming datasketches::kll_sketch<float>)
-typedef datasketches::kll_sketch<float> distributionBox;
+// Typedef for distribution box data structure (datasketches::kll_sketch<float> in the sketch arena)
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
 
 /**
  * @class ImageProfile
  * @brief A class for analyzing and storing image statistics.
  *
  * This class provides functionalities for analyzing image properties like distribution of pixel values, contrast, brightness, etc. It utilizes KLL sketches for memory-efficient storage of these statistics.
+ * The sketches are sharded per thread, so profile() can be called from several inference threads at once.
  */
 
 class ImageProfile {
@@ -80,27 +85,46 @@ private:
     std::string dataSavepath;
     std::map<std::string, std::vector<std::string>> imageConfig;
     int channels;
+    /**
+     * @brief Allocator charging all sketches of this profile to its arena account
+     */
+    ArenaAllocator<float> arena;
+    /**
+     * @brief Sliding window of all sketches, from the window key of the [image] section
+     */
+    SketchWindow sketchWindow;
    /**
    * @brief KLL sketch for storing contrast distribution.
    */
-  distributionBox contrastBox;
+  ShardedSketch contrastBox;
 
   /**
    * @brief KLL sketch for storing brightness distribution.
    */
-  distributionBox brightnessBox;
-  distributionBox sharpnessBox;
+  ShardedSketch brightnessBox;
+  ShardedSketch sharpnessBox;
 
-  std::vector<distributionBox *> pixelBox;
+  std::vector<ShardedSketch *> pixelBox;
   /**
    * @brief KLL sketch for storing mean pixel value distribution.
    */
-  std::vector<distributionBox *> meanBox;
+  std::vector<ShardedSketch *> meanBox;
 
   /**
    * @brief KLL sketch for storing noise distribution.
    */
-  distributionBox noiseBox;
+  ShardedSketch noiseBox;
+
+  /**
+   * @brief Relative-error sketches replacing the KLL sketch of the scalar
+   * metrics listed in the relative_error key, e.g. relative_error = NOISE,SHARPNESS
+   */
+  std::map<std::string, ShardedReqSketch *> relativeBoxes;
+
+  /**
+   * @brief Distinct average hashes of the image thumbnails, a count of the scenes seen
+   */
+  HllSketch sceneHashes;
 
 
     /**
@@ -117,6 +141,19 @@ private:
      */
     float computeStatistic(const std::string& name, cv::Mat& img);
 
+    /**
+     * @brief Registers the sketch of a scalar metric, its relative-error sketch if it has one
+     * @param name Statistic name
+     * @param box KLL sketch of the statistic
+     * @param filename File name in statSavepath
+     */
+    void registerBox(const std::string& name, ShardedSketch& box, const std::string& filename);
+
+    /**
+     * @brief Adds the score of a scalar metric to its relative-error sketch if it has one
+     */
+    void updateBox(const std::string& name, ShardedSketch& box, float score);
+
     /**
      * @brief Checks if the statistic value exceeds the configured threshold
      * @param name Statistic name
@@ -138,6 +175,12 @@ private:
      * @param pixelValues Vector of pixel values
      */
     void updatePixelValues(const std::vector<int>& pixelValues);
+
+    /**
+     * @brief Updates the per-channel pixel histograms with a bulk update per channel
+     * @param img OpenCV image matrix
+     */
+    void updatePixelHistograms(const cv::Mat& img);
 };
 
 #endif // IMAGEPROFILE_H
@@ -18,13 +18,15 @@
 #include <sstream>
 #include <stdexcept>
 #include <kll_sketch.hpp>
+#include "sketcharena.h"
 
 #include "iniparser.h"
 #include "saver.h"
 #include "generic.h"
+#include "shardedsketch.h"
 
 // Typedef for distribution box data structure (assuming datasketches::kll_sketch<unit>)
-typedef datasketches::kll_sketch<float> distributionBox;
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
 
 /**
  * @class ImageSampler
@@ -82,10 +84,10 @@ public:
 
 private:   
     // Member variables for storing confidence metric statistics
-    distributionBox marginConfidenceBox;
-    distributionBox leastConfidenceBox;
-    distributionBox ratioConfidenceBox;
-    distributionBox entropyConfidenceBox;
+    ShardedSketch marginConfidenceBox;
+    ShardedSketch leastConfidenceBox;
+    ShardedSketch ratioConfidenceBox;
+    ShardedSketch entropyConfidenceBox;
     std::string model_type;
     Saver *saver;
     //ImageUploader *uploader;
@@ -2,6 +2,7 @@
 #define IMGHELPERS_H
 
 #include <opencv2/opencv.hpp>
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -62,6 +63,18 @@ double calculateContrast(cv::Mat &img);
  */
 double calculateBrightness(cv::Mat &img);
 
+/**
+ * @brief Calculate the average hash of an image thumbnail.
+ * 
+ * The image is shrunk to an 8x8 grayscale thumbnail, every bit of the hash
+ * tells whether a thumbnail pixel is brighter than the thumbnail mean. Frames
+ * of the same scene share the hash despite small noise or compression changes.
+ * 
+ * @param img The input image.
+ * @return uint64_t The 64 bit average hash, 0 for an empty image.
+ */
+uint64_t calculateAverageHash(const cv::Mat &img);
+
 /**
  * @brief Save an image with an incremental name in the specified directory.
  * 
@@ -0,0 +1,100 @@
+/**
+ * @file latencyhistogram.h
+ * @brief Header file for the LatencyHistogram class, a lock-free log-linear histogram.
+ *
+ * Latencies are recorded in microseconds into HDR style buckets: every power
+ * of two range is split into 2^SUB_BUCKET_BITS linear sub-buckets, which bounds
+ * the relative error of a percentile by 2^-SUB_BUCKET_BITS (about 3%).
+ * Recording is a single relaxed atomic increment, so any inference thread can
+ * call it without locks while the Saver serializes the histogram.
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+/**
+ * @class LatencyHistogram
+ * @brief Log-linear latency histogram with lock-free recording.
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 5;
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    // Values up to 2^36 us (about 19 hours), larger values go into the last bucket
+    static constexpr uint32_t MAX_VALUE_BITS = 36;
+    static constexpr uint32_t NUM_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram& other);
+    LatencyHistogram& operator=(const LatencyHistogram& other) = delete;
+
+    /**
+     * @brief Records a latency, safe to call concurrently from any thread
+     * @param latency_ms Latency in milliseconds, negative and NaN values are ignored
+     */
+    inline void record(float latency_ms) {
+        if (!(latency_ms >= 0.0f)) return;
+        const float latency_us = latency_ms * 1000.0f;
+        const uint32_t index = latency_us < static_cast<float>(1ull << MAX_VALUE_BITS)
+            ? bucket_index(static_cast<uint64_t>(latency_us)) : NUM_BUCKETS - 1;
+        counts_[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Adds the counts of another histogram
+     */
+    void merge(const LatencyHistogram& other);
+
+    /**
+     * @brief Returns the total number of recorded latencies
+     */
+    uint64_t get_n() const;
+
+    /**
+     * @brief Returns the latency at the given rank
+     * @param rank Normalized rank in [0, 1], e.g. 0.99 for p99
+     * @return Latency in milliseconds (bucket midpoint), 0 if empty
+     */
+    double get_quantile(double rank) const;
+
+    /**
+     * @brief Serializes the non-empty buckets
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Deserializes a histogram written by serialize()
+     */
+    static LatencyHistogram deserialize(std::istream& is);
+
+    static inline uint32_t bucket_index(uint64_t value_us) {
+        if (value_us < SUB_BUCKETS) return static_cast<uint32_t>(value_us);
+        const uint32_t magnitude = 63 - __builtin_clzll(value_us);
+        if (magnitude >= MAX_VALUE_BITS) return NUM_BUCKETS - 1;
+        const uint32_t shift = magnitude - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<uint32_t>(value_us >> shift) - SUB_BUCKETS;
+    }
+
+    /**
+     * @brief Lowest value in microseconds that falls into the bucket
+     */
+    static uint64_t bucket_lower_bound(uint32_t index);
+
+    /**
+     * @brief Width of the bucket in microseconds
+     */
+    static uint64_t bucket_width(uint32_t index);
+
+private:
+    static constexpr uint8_t SERIAL_VERSION = 1;
+    static constexpr uint8_t FAMILY = 0xE7;
+
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts_;
+};
+
+#endif // LATENCY_HISTOGRAM_H
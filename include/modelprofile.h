@@ -11,7 +11,14 @@
 #include <map>
 #include "saver.h"
 #include "generic.h"
+#include "embeddingstats.h"
+#include "projectionsketch.h"
+#include "latencyhistogram.h"
+#include "hllsketch.h"
+#include "countminsketch.h"
+#include "shardedsketch.h"
 #include <kll_sketch.hpp>
+#include "sketcharena.h"
 #include <frequent_items_sketch.hpp>
 
 // Assuming declarations for Saver, distributionBox, ClassificationResult, and YoloDetection
@@ -19,7 +26,7 @@
 /**
  * @brief Class for managing and logging model statistics
  */
-typedef datasketches::kll_sketch<float> distributionBox;
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
 typedef std::vector<std::pair<float, int>> ClassificationResults;
 typedef datasketches::frequent_items_sketch<std::string> frequent_class_sketch;
 
@@ -42,12 +49,50 @@ public:
    * @return 0 on success, negative value on error
    */
   int log_classification_model_stats(float inference_latency, const ClassificationResults& results);
+  /**
+   * @brief Logs statistics for a classification model from the raw score buffer.
+   * Only the top_classes highest scores update the class sketches.
+   * @param inference_latency Time taken for model inference
+   * @param scores Pointer to the model output scores, indexed by class id
+   * @param num_classes Number of scores in the buffer
+   * @return 0 on success, negative value on error
+   */
+  int log_classification_model_stats(float inference_latency, const float* scores, size_t num_classes);
+  /**
+   * @brief Logs the classes detected in one frame into the co-occurrence pair sketch.
+   * Every unordered pair of distinct classes counts once per frame.
+   * @param classes Pointer to the class ids of the detections, duplicates allowed
+   * @param count Number of detections
+   * @return 0 on success, negative value on error
+   */
+  int log_detected_classes(const int* classes, size_t count);
+  /**
+   * @brief Logs an inference latency into the lock-free latency histogram.
+   * Safe to call concurrently from any inference thread.
+   * @param inference_latency Time taken for model inference in milliseconds
+   */
+  void log_inference_latency(float inference_latency);
   /**
    * @brief Logs model embeddings from the model
    * @param vector of embeddings
    * return 0 on sucess, negative value on error
    * */
   int log_embeddings(const std::vector<float>& embeddings);
+  /**
+   * @brief Logs model embeddings from a raw output buffer
+   * @param embeddings pointer to the embedding values
+   * @param dims number of values in the embedding
+   * return 1 on success, negative value on error
+   * */
+  int log_embeddings(const float* embeddings, size_t dims);
+  /**
+   * @brief Logs a batch of model embeddings
+   * @param embeddings count x dims row major embedding values
+   * @param count number of embeddings in the batch
+   * @param dims number of values in every embedding
+   * return 1 on success, negative value on error
+   * */
+  int log_embeddings_batch(const float* embeddings, size_t count, size_t dims);
   /**
    * @brief Logs Class wise model embeddings
    * @param vector of embeddings
@@ -64,29 +109,77 @@ public:
   private:
 #endif
 
+  // Deletes the Saver and the sketches, from the destructor or a failed constructor
+  void cleanup();
+
   Saver *saver;
+  // Allocator charging the sketches to the ModelProfile arena account
+  ArenaAllocator<float> arena_;
+  // Sliding window of the sketches, from the window key of the [model] section
+  SketchWindow window_;
   // Member variables (declarations only, definitions in .cpp file)
   std::string model_id_;
   int top_classes_;
   std::string statSavepath;
   std::string dataSavepath;
   std::map<std::string, std::vector<std::string>> modelConfig; 
-  std::vector<float> inference_latency_;
+  LatencyHistogram inference_latency_;
+  // Distinct class ids among the logged top classes
+  HllSketch predicted_classes_;
+  // Class pair sketches, enabled with CLASS_PAIRS = <width>,<depth>
+  // (top-1, top-2) pairs of the classification results
+  CountMinSketch *confusion_pairs_;
+  // (smaller, larger) class pairs detected in the same frame
+  CountMinSketch *cooccurring_pairs_;
   std::vector<int> no_detections_per_image_;
   std::vector<double> objectnessbox_;
-  distributionBox *dBox;
-  std::map<int, distributionBox*> model_classes_stat_;
-  distributionBox *model_embeddings;
+  ShardedSketch *dBox;
+  std::map<int, ShardedSketch*> model_classes_stat_;
+  ShardedSketch *model_embeddings;
   /**
-  * @brief Gets the distributionBox (KLL sketch) for the given statistic name.
+  * @brief Gets the KLL sketch for the given statistic name.
   * If it doesn't exist, a new one is created and added to the map.
   * @param name Statistic name
-  * @return Pointer to the distributionBox object
+  * @return Pointer to the ShardedSketch object
+  */
+  ShardedSketch* getBox(const int cls);
+  /**
+  * @brief Updates the per-class sketches and the frequent class sketch
+  * @param results Pointer to (score, class id) pairs
+  * @param count Number of pairs
   */
-  distributionBox* getBox(const int cls);
+  void updateClassStats(const std::pair<float, int>* results, size_t count);
+  // Scratch buffer for the top_classes_ selection
+  ClassificationResults top_results_;
   // Map to store KLL sketches based on statistic names
-  std::unordered_map<int, distributionBox*> embeddings_stat_;
-  
+  std::unordered_map<int, ShardedSketch*> embeddings_stat_;
+
+  // Per-dimension embedding statistics, enabled with EMBEDDING_STATS = per_dimension
+  bool per_dimension_embeddings_;
+  std::vector<uint32_t> embedding_sketch_dims_;
+  uint32_t embedding_rank_;
+  EmbeddingStats *embedding_stats_;
+  /**
+  * @brief Gets the per-dimension embedding statistics, creating and registering
+  * them with the Saver on the first embedding.
+  * @param dims Number of embedding dimensions
+  * @return Pointer to the EmbeddingStats object, nullptr on dimension mismatch
+  */
+  EmbeddingStats* getEmbeddingStats(size_t dims);
+
+  // Random projection drift sketch, enabled with EMBEDDING_PROJECTIONS = <k>
+  uint16_t embedding_projections_;
+  uint64_t projection_seed_;
+  std::string embedding_baseline_;
+  ProjectionSketch *projection_sketch_;
+  /**
+  * @brief Gets the projection sketch, creating it, loading the baseline and
+  * registering it with the Saver on the first embedding.
+  * @param dims Number of embedding dimensions
+  * @return Pointer to the ProjectionSketch object, nullptr on dimension mismatch
+  */
+  ProjectionSketch* getProjectionSketch(size_t dims);
+
 };
 
 #endif // MODEL_STATS_H
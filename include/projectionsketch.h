@@ -0,0 +1,141 @@
+/**
+ * @file projectionsketch.h
+ * @brief Header file for the ProjectionSketch class for on-device embedding drift.
+ *
+ * Embeddings are projected through a fixed, seeded random matrix to a few
+ * dimensions and every projection is summarized by a KLL sketch. Neither the
+ * embeddings nor the projections leave the device, only the sketches and a
+ * sliced energy distance (MMD with the distance kernel) to a baseline.
+ *
+ * The inference thread updates the sketches while the Saver serializes them.
+ * A mutex guards the sketches, the projection itself runs outside of it, and
+ * serialize() copies the sketches under the lock and scores and writes the
+ * copy after releasing it.
+ */
+
+#ifndef PROJECTION_SKETCH_H
+#define PROJECTION_SKETCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <kll_sketch.hpp>
+#include "sketcharena.h"
+
+// Typedef for distribution box data structure (datasketches::kll_sketch<float> in the sketch arena)
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
+
+/**
+ * @class ProjectionSketch
+ * @brief Random projection sketches of embeddings with a drift score against a baseline.
+ */
+class ProjectionSketch {
+public:
+    static const uint16_t DEFAULT_PROJECTIONS = 32;
+    static const uint64_t DEFAULT_SEED = 42;
+
+    /**
+     * @brief Constructor to initialize ProjectionSketch object
+     * @param dims Number of dimensions of every embedding
+     * @param projections Number of random projections (k)
+     * @param seed Seed of the projection matrix, must match the baseline
+     * @param k KLL sketch parameter of the per-projection sketches
+     */
+    ProjectionSketch(uint32_t dims, uint16_t projections = DEFAULT_PROJECTIONS,
+                     uint64_t seed = DEFAULT_SEED, uint16_t k = 200);
+    ProjectionSketch(const ProjectionSketch& other);
+    ProjectionSketch& operator=(const ProjectionSketch& other) = delete;
+
+    /**
+     * @brief Projects a batch of embeddings and updates the per-projection
+     * sketches, safe to call concurrently with serialize()
+     * @param embeddings count x get_dims() row major embeddings
+     * @param count Number of embeddings in the batch
+     */
+    void update(const float* embeddings, size_t count = 1);
+
+    /**
+     * @brief Projects a batch of embeddings without updating the sketches
+     * @param embeddings count x get_dims() row major embeddings
+     * @param count Number of embeddings in the batch
+     * @param out count x get_projections() row major output
+     */
+    void project(const float* embeddings, size_t count, float* out) const;
+
+    /**
+     * @brief Merges a sketch built with the same dimensions, projections and seed
+     */
+    void merge(const ProjectionSketch& other);
+
+    /**
+     * @brief Loads the baseline sketch the drift score is computed against
+     * @param path File written by serialize(), e.g. at training time
+     * @return true on success, false if the file is missing or incompatible
+     */
+    bool load_baseline(const std::string& path);
+
+    /**
+     * @brief Computes the sliced energy distance to the baseline.
+     *
+     * The 1-D energy distances of all projections are averaged. The result is
+     * also cached and returned by get_drift_score().
+     * @return Drift score, NaN without baseline or data
+     */
+    double compute_drift_score() const;
+
+    /**
+     * @brief Returns the drift score of the last compute_drift_score() or serialize()
+     */
+    double get_drift_score() const;
+
+    uint32_t get_dims() const;
+    uint16_t get_projections() const;
+    uint64_t get_seed() const;
+    uint64_t get_n() const;
+
+    /**
+     * @brief Returns a copy of the per-projection sketches
+     */
+    std::vector<distributionBox> get_sketches() const;
+    bool has_baseline() const;
+
+    /**
+     * @brief Serializes the sketches. Called every save interval, so the drift
+     * score is refreshed here and stored in the header.
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Deserializes a sketch written by serialize(), without baseline
+     */
+    static ProjectionSketch deserialize(std::istream& is);
+
+private:
+    static const uint8_t SERIAL_VERSION = 1;
+    static const uint8_t FAMILY = 0xE6;
+
+    // Copies the sketches under the lock, returns the number of embeddings they hold
+    uint64_t snapshot(std::vector<distributionBox>& sketches) const;
+
+    // Sliced energy distance of the sketches to the baseline, NaN without either
+    double drift_score(const std::vector<distributionBox>& sketches, uint64_t n) const;
+
+    uint32_t dims_;
+    uint16_t projections_;
+    uint64_t seed_;
+    uint64_t n_;
+    // projections_ x dims_ row major matrix of +-1/sqrt(dims_) entries
+    std::vector<float> matrix_;
+    // Guards n_, sketches_ and baseline_
+    mutable std::mutex mutex_;
+    std::vector<distributionBox> sketches_;
+    // Never modified once loaded, a save keeps its own reference
+    std::shared_ptr<const std::vector<distributionBox>> baseline_;
+    mutable std::atomic<double> drift_score_;
+};
+
+#endif // PROJECTION_SKETCH_H
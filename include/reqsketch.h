@@ -0,0 +1,168 @@
+/**
+ * @file reqsketch.h
+ * @brief Header file for the ReqSketch class, a relative-error quantile sketch.
+ *
+ * The KLL sketch has the same additive rank error everywhere, so a p99.9 of a
+ * latency-like metric is only as precise as its median. The relative-error
+ * (REQ) sketch of Cormode et al. instead bounds the error of a rank r by a
+ * fraction of 1 - r in high rank accuracy mode: the closer a rank is to 1,
+ * the more exact it is.
+ *
+ * Like KLL, items go through a stack of compactors where level h holds items
+ * of weight 2^h. A REQ compactor is split into sections and only compacts the
+ * lower sections, the number of compacted sections follows a binary counter,
+ * so the largest items stay at level 0 with their exact weight much longer.
+ * Sections get more numerous and smaller as a level sees more compactions,
+ * the retained size grows with log^1.5 of n instead of log n.
+ */
+
+#ifndef REQ_SKETCH_H
+#define REQ_SKETCH_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <quantiles_sorted_view.hpp>
+#include "sketcharena.h"
+
+/**
+ * @class ReqSketch
+ * @brief Relative-error quantile sketch of floats, accurate at the high ranks.
+ */
+class ReqSketch {
+public:
+    typedef datasketches::quantiles_sorted_view<float, std::less<float>, ArenaAllocator<float>> sorted_view;
+
+    // Section size of a fresh compactor, even and at least MIN_K
+    static constexpr uint16_t DEFAULT_K = 12;
+    static constexpr uint16_t MIN_K = 4;
+
+    /**
+     * @brief Constructor to initialize ReqSketch object
+     * @param k Initial section size, rounded down to an even number, larger is more accurate
+     * @param allocator Arena allocator charging the retained items to a profile
+     * @param hra High rank accuracy, false makes the low ranks accurate instead
+     */
+    explicit ReqSketch(uint16_t k = DEFAULT_K, const ArenaAllocator<float>& allocator = ArenaAllocator<float>(),
+                       bool hra = true);
+
+    /**
+     * @brief Adds a value, NaN is ignored like in kll_sketch
+     */
+    void update(float item);
+
+    /**
+     * @brief Adds n values
+     */
+    void update(const float* first, size_t n);
+
+    /**
+     * @brief Merges another sketch of the same accuracy mode into this one
+     */
+    void merge(const ReqSketch& other);
+
+    bool is_empty() const { return n_ == 0; }
+    uint16_t get_k() const { return k_; }
+    bool is_hra() const { return hra_; }
+    uint64_t get_n() const { return n_; }
+    uint32_t get_num_retained() const { return num_retained_; }
+
+    float get_min_item() const;
+    float get_max_item() const;
+
+    /**
+     * @brief Returns the approximate normalized rank of the given item
+     */
+    double get_rank(float item, bool inclusive = true) const;
+
+    /**
+     * @brief Returns the approximate quantile of the given normalized rank
+     */
+    float get_quantile(double rank, bool inclusive = true) const;
+
+    /**
+     * @brief Returns all retained items with their cumulative weights, e.g. for drift scoring
+     */
+    sorted_view get_sorted_view() const;
+
+    /**
+     * @brief Serializes the sketch with all its compactors
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Deserializes a sketch written by serialize()
+     */
+    static ReqSketch deserialize(std::istream& is, const ArenaAllocator<float>& allocator = ArenaAllocator<float>());
+
+#ifndef TEST
+private:
+#endif
+    static constexpr uint8_t SERIAL_VERSION = 1;
+    static constexpr uint8_t FAMILY = 0xE8;
+    static constexpr uint8_t INIT_NUM_SECTIONS = 3;
+
+    typedef std::vector<float, ArenaAllocator<float>> Items;
+
+    /**
+     * Items of one level. The higher levels are always sorted. Level 0 only
+     * appends, the items after num_sorted are sorted and merged into the
+     * sorted prefix before it compacts.
+     */
+    struct Compactor {
+        Compactor(uint8_t lg_weight, uint16_t k, const ArenaAllocator<float>& allocator);
+
+        uint32_t nom_capacity() const {
+            return 2 * num_sections * section_size;
+        }
+
+        /**
+         * @brief Halves the lower sections into next, returns the change of nom_capacity()
+         */
+        int64_t compact(Compactor& next, bool hra);
+
+        /**
+         * @brief Doubles the sections once the compaction counter needs more of them
+         */
+        bool ensure_enough_sections();
+
+        void sort();
+
+        /**
+         * @brief Makes room for n items, growing by a section instead of doubling
+         */
+        void reserve(size_t n);
+
+        bool is_sorted() const {
+            return num_sorted == items.size();
+        }
+
+        uint8_t lg_weight;
+        bool coin;
+        uint32_t num_sorted;
+        uint32_t num_sections;
+        uint32_t section_size;
+        float section_size_raw;
+        // Binary counter of the compactions, its trailing ones select the compacted sections
+        uint64_t state;
+        Items items;
+    };
+    typedef std::vector<Compactor, typename std::allocator_traits<ArenaAllocator<float>>::template rebind_alloc<Compactor>> Compactors;
+
+    void grow();
+    void compress();
+
+    uint16_t k_;
+    bool hra_;
+    ArenaAllocator<float> allocator_;
+    uint64_t n_;
+    uint32_t num_retained_;
+    // Sum of the nominal capacities, the sketch compresses when it holds that many items
+    uint32_t max_nom_size_;
+    float min_item_;
+    float max_item_;
+    Compactors compactors_;
+};
+
+#endif // REQ_SKETCH_H
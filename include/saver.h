@@ -2,11 +2,14 @@
 #define SAVER_H
 
 #include <mutex>
-#include <thread>
-#include <condition_variable>
 #include <queue>
 #include <string>
 #include <atomic>
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+#include <chrono>
 #include <opencv2/opencv.hpp> 
 
 // Filesystem includes
@@ -20,55 +23,198 @@
     #error "No suitable filesystem library available"
 #endif
 
-//#include "MyObject.h" // Include your object header
-typedef struct {
+#include "serializable.h"
+
+struct data_object_t {
     std::string filename;
-	int type;
-	void *obj;
+    std::unique_ptr<Serializable> obj;
     uint32_t max_size;
-}data_object_t;
+    // Update counter of the object when it was last written, see Serializable::get_version
+    uint64_t saved_version;
+    bool saved;
+    // Serialization buffer of the object, sized by its first save and reused by every later one
+    std::vector<char> buffer;
+    // Bytes of the last serialization in buffer, 0 before the first one succeeded
+    size_t size;
+    // Time between writes of the object, the interval of the Saver unless set per metric
+    std::chrono::milliseconds interval;
+    // Earliest save cycle that writes the object again
+    std::chrono::steady_clock::time_point next_due;
+};
 
-typedef enum {
-    KLL_TYPE,
-    FI_TYPE,
-    JPEG_TYPE,
-    PNG_TYPE,
-    TYPE_MAX
-}data_object_type_e;
+// Write of a save cycle waiting in its temporary file for the rename into place
+typedef struct {
+    std::string temp_filename;
+    std::string filename;
+    // Objects in the file with the version they were serialized at, marked saved
+    // once renamed; nullptr for images removed from the queue
+    std::vector<std::pair<data_object_t *, uint64_t>> objects;
+}pending_write_t;
+
+// Counters of the save cycles, objects without updates since their last write are skipped
+typedef struct {
+    uint64_t cycles;
+    uint64_t written;
+    uint64_t skipped;
+    uint64_t failed;
+}save_stats_t;
+
+class DriftMonitor;
 
 class Saver {
 public:
-  // Constructor to specify filename and save interval
+  // Constructor to specify filename and save interval in seconds, throws
+  // std::invalid_argument for an interval that is not positive
   Saver(int interval, std::string class_name);
   ~Saver();
 
-  // Add an object to the queue for saving
-  void AddObjectToSave(void *object, int type, const std::string& filename);
+  // Add an object to the queue for saving, any type with a make_serializable overload
+  // that is safe to read while it is updated, throws std::logic_error otherwise
+  template <typename T>
+  void AddObjectToSave(T *object, const std::string& filename) {
+    AddObjectToSave(make_serializable(object), filename);
+  }
+
+  // Add an image sample, written once in the format of the file extension
+  void AddObjectToSave(cv::Mat *image, const std::string& filename);
 
-  // Start the background thread to save objects from the queue periodically
+  void AddObjectToSave(std::unique_ptr<Serializable> object, const std::string& filename);
+
+  // Registers with the process-wide SaverService, which runs a save cycle
+  // every save interval on its thread
   void StartSaving();
 
   // Manual trigger to save all objects in the queue immediately
   void TriggerSave();
 
+  // Deregisters from the SaverService, waits for a save cycle in progress and
+  // writes every object changed since its last write in a final cycle
   void StopSaving();
 
+  // Writes the objects of a metric, the file name without extension, at their
+  // own interval instead of the one of the Saver; e.g. sub-second for a hot
+  // metric, minutes for a cold one
+  void SetSaveInterval(const std::string& metric, std::chrono::milliseconds interval);
+
+  // Applies the config values "<metric>:<milliseconds>", throws std::invalid_argument
+  // for a malformed value or an interval that is not positive
+  void SetSaveIntervals(const std::vector<std::string>& values);
+
+  // Returns the counters of all save cycles so far
+  save_stats_t GetSaveStats() const;
+
+  // Scores every KLL object with a baseline <baseline_dir>/<file name> against
+  // it at each save and writes the scores to report_path, call before adding objects
+  void EnableDriftMonitor(const std::string& baseline_dir, const std::string& report_path);
+
+  // Writes all objects except images into one bundle file per save cycle instead
+  // of a file each, see sketchbundle.h; call before StartSaving
+  void EnableBundle(const std::string& bundle_path);
+
+  // Writes every file except images gzip-compressed at the given zlib level (1-9)
+  // as <filename>.gz; throws std::invalid_argument for other levels
+  void EnableCompression(int level);
+
+  // Applies the saver settings of a profile config section and removes them from
+  // it: drift_baseline, bundle, compression, save_intervals and fresh_start,
+  // without which StartSaving restores the snapshots of the previous run.
+  // Paths are relative to statSavepath; malformed values are logged and ignored
+  void Configure(std::map<std::string, std::vector<std::string>>& config, const std::string& statSavepath);
+
+  // Merges the last saved snapshot into every object, those already added in
+  // parallel, later ones when they are added; call after EnableBundle and
+  // EnableCompression, which select the files the snapshots are read from
+  void EnableRestore();
+
+  // Writes every object of the queue that is due and changed since its last write,
+  // called by the SaverService; flush writes the changed objects that are not due yet too
+  void RunSaveCycle(bool flush = false);
+
 #ifndef TEST
 private:
 #endif
-  // Function to be executed in the background thread
   std::string parent_name;
-  void SaveLoop();
 
-  std::atomic<bool> exitSaveLoop;
   std::queue<data_object_t *> objects_to_save_;  // Queue of objects to be saved
-  int save_interval_;     // Interval between saves in minutes
-  std::thread save_thread_;        // Thread object for saving
+  std::chrono::milliseconds save_interval_;  // Interval of the objects without one of their own
+  // Intervals set per metric, applied to objects added later as well
+  std::map<std::string, std::chrono::milliseconds> metric_intervals_;
+  // Set by TriggerSave, the next cycle writes every changed object
+  std::atomic<bool> flush_requested_;
   std::mutex queue_mutex_;         // Mutex for queue access
-  std::condition_variable cv_;     // Condition variable for thread synchronization
 
-  // Replace this function with your actual logic to save the object to a file
-  void SaveObjectToFile(data_object_t *object);
+  std::atomic<uint64_t> cycles_;
+  std::atomic<uint64_t> written_;
+  std::atomic<uint64_t> skipped_;
+  std::atomic<uint64_t> failed_;
+  DriftMonitor *drift_monitor_;
+
+  // Bundle file of the objects, empty to write a file per object
+  std::string bundle_path_;
+  // Objects written to the bundle, in the order they were added
+  std::vector<data_object_t *> bundled_objects_;
+  SketchBundleWriter bundle_writer_;
+  // zlib level of the written files, 0 to write them uncompressed
+  int compression_level_;
+
+  // Objects are restored from their last snapshot when they are added
+  bool restore_;
+  // Set by Configure unless fresh_start, StartSaving enables the restore
+  bool restore_on_start_;
+  // Bundle of the previous run, kept while it holds entries of objects not added yet
+  std::unique_ptr<SketchBundle> restore_bundle_;
+  // Verified entries of restore_bundle_ without an object yet, carried into
+  // every new bundle so a restart does not drop them
+  std::set<std::string> restore_pending_;
+
+  // Metric name of an object for the drift monitor, its file name without extension
+  static std::string MetricName(const data_object_t *object);
+
+  // Quota of the directory of a file in KB, checked before each write
+  static const uint32_t DEFAULT_MAX_SIZE = 1024;
+
+  // Suffix of the temporary file an object is written to before the rename into place
+  static const char *TEMP_SUFFIX;
+  // Suffix appended to the file name of compressed files
+  static const char *COMPRESSED_SUFFIX;
+
+  // Shortest interval of the Saver and its objects, the period of its save cycles
+  std::chrono::milliseconds CycleInterval() const;
+
+  // Returns the newer of path and its compressed variant, empty if neither exists
+  static std::string LatestSnapshot(const std::string &path);
+
+  // Merges the last snapshot of the object into it, false if there is none or it is invalid
+  bool RestoreObject(data_object_t *object);
+
+  // Checks the quota of the directory and takes its lock for the rest of the cycle
+  bool ReserveDirectory(const fs::path &baseDir, uint32_t max_size);
+
+  // Serializes the object into its buffer, false if the serialization fails
+  bool SerializeObject(data_object_t *object);
+
+  // Writes the object to its temporary file and queues the rename, false if the
+  // quota, the lock or the serialization fails
+  bool SaveObjectToFile(data_object_t *object, uint64_t version);
+
+  // Writes the last serialization of every bundled object to the temporary bundle
+  // and queues the rename, the changed objects are marked saved on commit
+  bool SaveBundle(const std::vector<std::pair<data_object_t *, uint64_t>> &changed);
+
+  // Writes the drift report of the cycle to its temporary file and queues the rename
+  bool SaveDriftReport();
+
+  // Writes a temporary file and syncs its data, removed again if the write or the sync fails
+  template <typename Writer>
+  bool WriteTempFile(const std::string &tempFilename, bool compress, Writer write);
+
+  // Renames the synced temporary files of the cycle into place and syncs every
+  // directory once, then releases the directory locks
+  void CommitPendingWrites(uint64_t &written, uint64_t &failed);
+
+  // Writes of the current cycle and the directory locks held until they are committed
+  std::vector<pending_write_t> pending_writes_;
+  std::map<std::string, int> cycle_locks_;
 };
 
 #endif // SAVER_H
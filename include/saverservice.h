@@ -0,0 +1,109 @@
+/**
+ * @file saverservice.h
+ * @brief Header file for the SaverService class, the one save thread shared by all profiles.
+ *
+ * Every profile owns a Saver with its own objects and save interval. A thread
+ * per Saver meant one thread per profile, each waking up every second to poll
+ * its exit flag. The savers are instead registered with this process-wide
+ * service, which keeps them ordered by their next deadline and runs their save
+ * cycles one after the other on a single I/O thread. The thread sleeps on a
+ * condition variable until the earliest deadline, a trigger or a registration.
+ *
+ * A Saver deregisters when it stops; deregistration waits for a save cycle of
+ * that Saver in progress, so its objects can be freed right after. The Saver
+ * then runs a final cycle itself, stopping never waits for a deadline.
+ */
+
+#ifndef SAVER_SERVICE_H
+#define SAVER_SERVICE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+class Saver;
+
+/**
+ * @class SaverService
+ * @brief Deadline-ordered schedule of the registered savers and the thread running their save cycles.
+ */
+class SaverService {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    /**
+     * @brief Returns the process-wide saver service, the thread starts with the first registration
+     */
+    static SaverService& instance();
+
+    /**
+     * @brief Schedules a saver, its first save cycle runs right away
+     * @param saver Saver to run, registering it again only updates the interval
+     * and brings the next cycle forward if the new interval ends earlier
+     * @param interval Time between the save cycles of the saver
+     */
+    void registerSaver(Saver* saver, clock::duration interval);
+
+    /**
+     * @brief Removes a saver from the schedule, waits if its save cycle is running
+     * @param saver Saver to remove, ignored if not registered
+     * @return Whether the saver was registered
+     */
+    bool deregisterSaver(Saver* saver);
+
+    /**
+     * @brief Moves the next save cycle of a registered saver to now
+     */
+    void trigger(Saver* saver);
+
+    /**
+     * @brief Writes the changed objects of every registered saver right away,
+     * for the shutdown path of an application that does not destroy its profiles
+     */
+    void flushAll();
+
+    /**
+     * @brief Whether the saver is scheduled
+     */
+    bool isRegistered(Saver* saver) const;
+
+    /**
+     * @brief Returns the number of save cycles run by the service so far
+     */
+    uint64_t get_cycles() const;
+
+#ifndef TEST
+private:
+#endif
+    SaverService();
+
+    struct entry_t {
+        clock::time_point deadline;
+        clock::duration interval;
+    };
+
+    void run();
+
+    /**
+     * @brief Moves the deadline of a registered saver, the caller holds mutex_
+     */
+    void reschedule_locked(Saver* saver, entry_t& entry, clock::time_point deadline);
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    // Signalled when a save cycle ends, for deregistrations waiting on it
+    std::condition_variable cycle_done_;
+    // Next deadline of every saver, the earliest first
+    std::set<std::pair<clock::time_point, Saver*>> schedule_;
+    std::unordered_map<Saver*, entry_t> savers_;
+    // Saver whose save cycle is in progress, nullptr while idle
+    Saver* running_;
+    uint64_t cycles_;
+    bool started_;
+};
+
+#endif // SAVER_SERVICE_H
@@ -0,0 +1,118 @@
+/**
+ * @file serializable.h
+ * @brief Header file for the Serializable interface, the objects written by the Saver.
+ *
+ * The Saver used to take a void pointer and a type enum, and cast it back in
+ * a switch for every save. A wrong enum was undefined behaviour and every new
+ * sketch type meant another case in the Saver. Objects are now wrapped once,
+ * when they are added, by the make_serializable() overload of their type; a
+ * type without an overload does not compile. The wrapper serializes into a
+ * buffer owned by the Saver, which is sized from the first save and reused by
+ * every later one.
+ *
+ * The Saver serializes on its service thread while the profiles keep
+ * updating, so it only accepts objects that are safe to read concurrently:
+ * sharded sketches read from their snapshots, sketches built on atomics and
+ * sketches that copy their state under a lock of their own. Plain KLL and
+ * frequent items sketches can still be wrapped, e.g. to serialize them on the
+ * thread that owns them, but not added to a Saver.
+ */
+
+#ifndef SERIALIZABLE_H
+#define SERIALIZABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <kll_sketch.hpp>
+#include <frequent_items_sketch.hpp>
+#include "sketcharena.h"
+#include "shardedsketch.h"
+#include "sketchbundle.h"
+
+namespace cv {
+class Mat;
+}
+class DriftMonitor;
+class EmbeddingStats;
+class ProjectionSketch;
+class LatencyHistogram;
+class HllSketch;
+class CountMinSketch;
+
+typedef datasketches::frequent_items_sketch<std::string> frequent_class_sketch;
+
+/**
+ * @class Serializable
+ * @brief Type-erased object the Saver writes to a file.
+ */
+class Serializable {
+public:
+    virtual ~Serializable() {}
+
+    /**
+     * @brief Returns the bytes the next serialize() is expected to write,
+     * the size of the last serialization for objects without a size query
+     */
+    virtual size_t get_serialized_size_bytes() const = 0;
+
+    /**
+     * @brief Serializes the object to the start of buffer
+     * @param buffer Buffer of the caller, grown only if the object no longer fits
+     * @param drift Drift monitor to score the object against, nullptr if none
+     * @param metric Metric name of the object in the drift monitor
+     * @return Bytes written
+     */
+    virtual size_t serialize(std::vector<char>& buffer, DriftMonitor* drift, const std::string& metric) const = 0;
+
+    /**
+     * @brief Reads the update counter, it changes whenever the serialized object may change
+     * @return false for objects written only once such as images
+     */
+    virtual bool get_version(uint64_t& version) const = 0;
+
+    /**
+     * @brief Returns the type of the serialized object in a bundle, see bundle_entry_type_e
+     */
+    virtual uint8_t get_type() const = 0;
+
+    /**
+     * @brief Merges a snapshot written by serialize() into the object
+     * @throws std::exception if the data is not a valid snapshot of the object's type
+     */
+    virtual void restore(const char* data, size_t size) = 0;
+
+    /**
+     * @brief Whether the object can be serialized while another thread updates it
+     */
+    virtual bool is_snapshot_safe() const = 0;
+
+    /**
+     * @brief Whether the drift monitor scores the object
+     */
+    virtual bool is_drift_metric() const { return false; }
+
+    /**
+     * @brief Whether the object leaves the save queue once written, e.g. an image sample
+     */
+    virtual bool is_one_shot() const { return false; }
+};
+
+std::unique_ptr<Serializable> make_serializable(distributionBox* sketch);
+std::unique_ptr<Serializable> make_serializable(frequent_class_sketch* sketch);
+std::unique_ptr<Serializable> make_serializable(EmbeddingStats* stats);
+std::unique_ptr<Serializable> make_serializable(ProjectionSketch* sketch);
+std::unique_ptr<Serializable> make_serializable(LatencyHistogram* histogram);
+std::unique_ptr<Serializable> make_serializable(ShardedSketch* sketch);
+std::unique_ptr<Serializable> make_serializable(ShardedReqSketch* sketch);
+std::unique_ptr<Serializable> make_serializable(HllSketch* sketch);
+std::unique_ptr<Serializable> make_serializable(CountMinSketch* sketch);
+
+/**
+ * @brief Wraps an image sample, encoded in the format of the extension, e.g. ".png"
+ */
+std::unique_ptr<Serializable> make_serializable(cv::Mat* image, const std::string& extension);
+
+#endif // SERIALIZABLE_H
@@ -0,0 +1,289 @@
+/**
+ * @file shardedsketch.h
+ * @brief Header file for the ShardedSketch class, a KLL sketch with per-thread shards.
+ *
+ * Every thread that updates a ShardedSketch gets its own shard, created on the
+ * first update of that thread. Updates only touch the shard of the calling
+ * thread, so inference threads never wait for each other. The Saver merges all
+ * shards when it serializes, the file is a regular KLL sketch. When a thread
+ * exits its shards are folded into the retired ring of their sketches and
+ * freed, so thread churn does not grow a metric.
+ *
+ * Every shard is double buffered: the Saver flips the buffers of a shard and
+ * folds the retired one into the accumulated sketch of the shard, so it never
+ * reads a sketch that is being updated and never blocks an update.
+ *
+ * A sketch can optionally cover a sliding window instead of its whole
+ * lifetime: every shard then keeps a ring of interval buckets, e.g. 60 buckets
+ * of one minute, and an update goes to the bucket of the current interval. A
+ * bucket whose interval has left the window is reset and reused by the next
+ * interval that maps to it, so the memory of a metric stays constant. The
+ * sketch of a bucket is only allocated by the first update of its interval,
+ * intervals without updates cost no sketch memory.
+ *
+ * The shards are KLL sketches by default. ShardedReqSketch shards relative-
+ * error sketches instead, for metrics whose high percentiles matter most.
+ */
+
+#ifndef SHARDED_SKETCH_H
+#define SHARDED_SKETCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <kll_sketch.hpp>
+#include "reqsketch.h"
+#include "sketcharena.h"
+#include "snapshotbuffer.h"
+
+// Typedef for distribution box data structure (datasketches::kll_sketch<float> in the sketch arena)
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
+
+/**
+ * @brief Sliding window of a ShardedSketch, the sketch is cumulative when intervals is 0
+ */
+struct SketchWindow {
+    uint32_t intervals = 0;
+    uint32_t interval_seconds = 0;
+
+    bool enabled() const {
+        return intervals > 0 && interval_seconds > 0;
+    }
+
+    /**
+     * @brief Parses the "window" key of a profile section, e.g. window = 60,60
+     * for 60 buckets of one minute
+     * @param value Values of the key, cumulative if missing or invalid
+     */
+    static SketchWindow fromConfig(const std::vector<std::string>& value);
+};
+
+/**
+ * @brief Default parameter and construction of the sketch type of a shard
+ */
+template <typename Sketch>
+struct SketchTraits;
+
+template <>
+struct SketchTraits<distributionBox> {
+    static constexpr uint16_t DEFAULT_K = datasketches::kll_constants::DEFAULT_K;
+    static distributionBox make(uint16_t k, const ArenaAllocator<float>& allocator) {
+        return distributionBox(k, std::less<float>(), allocator);
+    }
+};
+
+template <>
+struct SketchTraits<ReqSketch> {
+    static constexpr uint16_t DEFAULT_K = ReqSketch::DEFAULT_K;
+    static ReqSketch make(uint16_t k, const ArenaAllocator<float>& allocator) {
+        return ReqSketch(k, allocator);
+    }
+};
+
+/**
+ * @class BasicShardedSketch
+ * @brief Thread-safe sketch built from lazily created per-thread shards.
+ */
+template <typename Sketch>
+class BasicShardedSketch {
+public:
+    typedef Sketch sketch_type;
+
+    /**
+     * @brief Constructor to initialize ShardedSketch object
+     * @param k Sketch parameter of every shard
+     * @param allocator Arena allocator charging the shards to a profile
+     * @param window Sliding window of the sketch, cumulative by default
+     */
+    explicit BasicShardedSketch(uint16_t k = SketchTraits<Sketch>::DEFAULT_K,
+                                const ArenaAllocator<float>& allocator = ArenaAllocator<float>(),
+                                const SketchWindow& window = SketchWindow());
+    BasicShardedSketch(const BasicShardedSketch& other) = delete;
+    BasicShardedSketch& operator=(const BasicShardedSketch& other) = delete;
+    ~BasicShardedSketch();
+
+    /**
+     * @brief Updates the shard of the calling thread
+     * @param item Value to add, NaN is ignored
+     */
+    void update(float item);
+
+    /**
+     * @brief Bulk updates the shard of the calling thread
+     * @param first Pointer to the first value
+     * @param n Number of values
+     */
+    void update(const float* first, size_t n);
+
+    /**
+     * @brief Sets the sliding window, only before the first update
+     * @return false if the sketch was already updated
+     */
+    bool set_window(const SketchWindow& window);
+
+    const SketchWindow& get_window() const {
+        return window_;
+    }
+
+    /**
+     * @brief Merges all shards into a single sketch, including every update
+     * that completed before the call. A windowed sketch only includes the
+     * buckets of the current window.
+     */
+    Sketch get_merged() const;
+
+    /**
+     * @brief Returns a counter that changes whenever the merged sketch may
+     * change: the number of updates, plus the interval of a windowed sketch
+     */
+    uint64_t get_version() const;
+
+    /**
+     * @brief Returns the number of shards, i.e. of running threads that updated the sketch
+     */
+    size_t get_num_shards() const;
+
+    /**
+     * @brief Serializes the merged sketch in the format of the sketch type
+     */
+    void serialize(std::ostream& os) const;
+
+    /**
+     * @brief Adds a saved sketch, e.g. the snapshot of the previous run, to the
+     * retired ring. A windowed sketch counts it to the current interval.
+     */
+    void restore(const Sketch& snapshot);
+
+#ifndef TEST
+private:
+#endif
+    /**
+     * Sketch of one interval, epoch is the index of the interval since the
+     * clock started. A cumulative sketch has a single bucket of epoch 0. The
+     * sketch is created by the first update of the interval.
+     */
+    struct Bucket {
+        uint64_t epoch;
+        std::optional<Sketch> sketch;
+
+        bool empty() const {
+            return !sketch || sketch->is_empty();
+        }
+    };
+    typedef std::vector<Bucket> Ring;
+
+    /**
+     * The owning thread writes into the live ring, total holds everything
+     * drained so far and is only touched under shards_mutex_.
+     */
+    struct Shard {
+        Shard(const Ring& empty) : live(empty), total(empty), updates(0) {}
+        SnapshotBuffer<Ring> live;
+        Ring total;
+        // Only incremented by the owning thread after a write, read by get_version()
+        std::atomic<uint64_t> updates;
+    };
+
+    /**
+     * Lets the threads caching a shard find out whether the sketch still
+     * exists, the destructor clears owner under mutex
+     */
+    struct Anchor {
+        std::mutex mutex;
+        BasicShardedSketch* owner;
+    };
+
+    /**
+     * Shards of the calling thread by sketch id, the destructor retires them
+     * when the thread exits
+     */
+    struct ThreadShards {
+        struct Entry {
+            std::weak_ptr<Anchor> anchor;
+            Shard* shard;
+        };
+        std::unordered_map<uint64_t, Entry> entries;
+        ~ThreadShards();
+    };
+
+    /**
+     * @brief Returns the shard of the calling thread, creating it on first use
+     */
+    Shard* local_shard();
+
+    /**
+     * @brief Drains the live ring of a shard into its accumulated ring,
+     * called under shards_mutex_
+     * @return true if the live ring held updates
+     */
+    bool drain(Shard& shard) const;
+
+    /**
+     * @brief Folds the rings of a shard into the retired ring and frees it,
+     * called when its thread exits
+     */
+    void retire(Shard* shard);
+
+    /**
+     * @brief Folds a bucket into the bucket of the same slot of another ring
+     * @return true if the bucket held updates
+     */
+    bool fold(Bucket& into, Bucket& from) const;
+
+    Ring make_ring() const;
+
+    /**
+     * @brief Returns the bucket of the current interval in the ring, recycling
+     * it if it still holds an older interval
+     */
+    Bucket& current_bucket(Ring& ring) const;
+
+    /**
+     * @brief Returns the sketch of the current interval, creating it on first use
+     */
+    Sketch& current_sketch(Ring& ring) const;
+
+    uint64_t current_epoch() const;
+    Sketch empty_sketch() const;
+
+    static uint64_t steady_seconds();
+
+    uint16_t k_;
+    ArenaAllocator<float> allocator_;
+    SketchWindow window_;
+    // Clock of the window in seconds, replaced by the tests
+    uint64_t (*clock_)();
+    // Unique over the lifetime of the process, so a thread never finds the
+    // shard of a destroyed sketch which happened to live at the same address
+    const uint64_t id_;
+    // Guards the shard list and the accumulated sketches, updates only take it
+    // for the first update of a thread
+    mutable std::mutex shards_mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    // Buckets of the exited threads and the restored snapshot, empty until the first of them
+    Ring retired_;
+    uint64_t retired_updates_;
+    std::shared_ptr<Anchor> anchor_;
+    // Last merged window, reused while no shard got new updates and the
+    // window did not move
+    mutable Sketch cached_;
+    mutable uint64_t cached_epoch_;
+    mutable bool cache_valid_;
+
+    static std::atomic<uint64_t> next_id_;
+};
+
+// Both instantiations are compiled once in shardedsketch.cpp
+extern template class BasicShardedSketch<distributionBox>;
+extern template class BasicShardedSketch<ReqSketch>;
+
+typedef BasicShardedSketch<distributionBox> ShardedSketch;
+typedef BasicShardedSketch<ReqSketch> ShardedReqSketch;
+
+#endif // SHARDED_SKETCH_H
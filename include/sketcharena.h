@@ -0,0 +1,191 @@
+/**
+ * @file sketcharena.h
+ * @brief Header file for the SketchArena class and the ArenaAllocator used by distributionBox.
+ *
+ * All KLL sketches of the profilers allocate from one process-wide arena. The
+ * arena reserves its whole budget once at startup and hands out power of two
+ * blocks, freed blocks go to a free list of their size and are reused by the
+ * next allocation of that size. Once the sketches have grown to their steady
+ * state no allocation reaches the heap anymore. Every allocation is charged to
+ * the account of the profile owning the sketch, for a per-profile report.
+ *
+ * The shards of a sketch are updated by different threads, so the arena has
+ * no global lock on the allocation path: every size class has a lock of its
+ * own, the unused part of the arena is handed out by an atomic offset and the
+ * account counters are atomic. Requests larger than the largest size class go
+ * straight to the heap.
+ */
+
+#ifndef SKETCH_ARENA_H
+#define SKETCH_ARENA_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <kll_sketch.hpp>
+
+/**
+ * @class SketchArena
+ * @brief Fixed size block pool shared by all sketches of the process.
+ */
+class SketchArena {
+public:
+    /**
+     * @brief Usage of the arena by one profile
+     */
+    struct Account {
+        Account() = default;
+        // Copies a snapshot of the counters
+        Account(const Account& other);
+
+        std::string name;
+        std::atomic<int64_t> bytes_in_use{0};
+        std::atomic<int64_t> peak_bytes{0};
+        std::atomic<uint64_t> allocations{0};
+        // Allocations served by the heap because the arena was full or not reserved
+        std::atomic<uint64_t> heap_allocations{0};
+    };
+
+    static constexpr size_t MIN_BLOCK_SIZE = 16;
+    static constexpr uint32_t NUM_SIZE_CLASSES = 40;
+
+    /**
+     * @brief Returns the process-wide arena
+     */
+    static SketchArena& instance();
+
+    /**
+     * @brief Reserves the memory of the arena, only the first call has an effect
+     * @param bytes Budget of the arena in bytes
+     * @return true if the arena was reserved by this call
+     */
+    bool reserve(size_t bytes);
+
+    /**
+     * @brief Reserves the arena from the sketch_arena_kb key of the [generic] section.
+     * The arena is process-wide: the first config with the key reserves it, a
+     * later one asking for another size is logged and ignored.
+     * @param conf_path Path to configuration file
+     * @return true if the arena was reserved by this call
+     */
+    bool configure(const std::string& conf_path);
+
+    /**
+     * @brief Returns the account with the given name, creating it on first use
+     */
+    Account* account(const std::string& name);
+
+    /**
+     * @brief Returns the account of sketches created without a profile account
+     */
+    Account* default_account() const;
+
+    void* allocate(size_t bytes, Account* account);
+    void deallocate(void* ptr, size_t bytes, Account* account);
+
+    /**
+     * @brief Returns the reserved bytes, 0 if the arena is not reserved
+     */
+    size_t get_capacity() const;
+
+    /**
+     * @brief Returns the bytes of the arena handed out at least once
+     */
+    size_t get_used() const;
+
+    /**
+     * @brief Returns a copy of all accounts
+     */
+    std::vector<Account> get_usage() const;
+
+    /**
+     * @brief Writes the usage of every account, one line per profile
+     */
+    void report(std::ostream& os) const;
+
+    /**
+     * @brief Writes the usage line of one account, nothing if it does not exist
+     */
+    void report(std::ostream& os, const std::string& name) const;
+
+#ifndef TEST
+private:
+#endif
+    SketchArena();
+
+    static uint32_t size_class(size_t bytes);
+
+    // Takes a block of the size class from its free list, nullptr if it is empty
+    void* pop_free(uint32_t index);
+
+    // Takes a block from the unused part of the arena, nullptr if it does not fit
+    void* bump(size_t block_size);
+
+    static void charge(Account* account, int64_t bytes);
+
+    // Guards the reservation and the account list
+    mutable std::mutex mutex_;
+    // Set once by reserve(), capacity_ is written before region_ is published
+    std::atomic<char*> region_;
+    std::atomic<size_t> capacity_;
+    std::atomic<size_t> offset_;
+    std::array<void*, NUM_SIZE_CLASSES> free_lists_;
+    std::array<std::mutex, NUM_SIZE_CLASSES> free_list_mutexes_;
+    std::vector<std::unique_ptr<Account>> accounts_;
+    Account* default_account_;
+};
+
+/**
+ * @class ArenaAllocator
+ * @brief Standard allocator allocating from the SketchArena, charged to an account.
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator() : account_(SketchArena::instance().default_account()) {}
+    explicit ArenaAllocator(SketchArena::Account* account) : account_(account) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : account_(other.get_account()) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(SketchArena::instance().allocate(n * sizeof(T), account_));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        SketchArena::instance().deallocate(ptr, n * sizeof(T), account_);
+    }
+
+    SketchArena::Account* get_account() const {
+        return account_;
+    }
+
+private:
+    SketchArena::Account* account_;
+};
+
+// All allocators share the arena, memory allocated by one can be freed by any other
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+
+/**
+ * @brief Returns an allocator charging to the account of the named profile
+ */
+inline ArenaAllocator<float> arenaAllocator(const std::string& profile) {
+    return ArenaAllocator<float>(SketchArena::instance().account(profile));
+}
+
+// Typedef for distribution box data structure (datasketches::kll_sketch<float> in the arena)
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
+
+#endif // SKETCH_ARENA_H
@@ -0,0 +1,164 @@
+/**
+ * @file sketchbundle.h
+ * @brief Header file for the sketch bundle format, all sketches of a save cycle in one file.
+ *
+ * A profile used to write one small file per sketch every save cycle, hundreds
+ * of open, truncate, write and close calls, and the uploader packed them into
+ * a tar again. A bundle holds all of them: a header, an index of the entries
+ * and the serialized sketches one after another. It is written with one
+ * sequential pass and read through a memory mapping, every entry is a
+ * pointer into the mapping and its CRC-32 is checked on demand. A compressed
+ * bundle (*.gz) is inflated into memory instead.
+ *
+ * Layout, little endian like the sketches themselves:
+ *   header: u8 serial version, u8 family, u16 unused, u32 number of entries,
+ *           u64 size of header and index
+ *   entry:  u8 type, u8 unused, u16 name length, u32 CRC-32 of the payload,
+ *           u64 offset of the payload from the start of the file,
+ *           u64 length of the payload, then the name
+ *   payloads in the order of the index
+ */
+
+#ifndef SKETCH_BUNDLE_H
+#define SKETCH_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+// Type of a bundle entry, stored in the files: never renumber
+enum bundle_entry_type_e : uint8_t {
+    BUNDLE_UNKNOWN = 0,
+    BUNDLE_KLL = 1,
+    BUNDLE_FREQUENT_ITEMS = 2,
+    BUNDLE_EMBEDDING_STATS = 3,
+    BUNDLE_PROJECTION_SKETCH = 4,
+    BUNDLE_LATENCY_HISTOGRAM = 5,
+    BUNDLE_REQ = 6,
+    BUNDLE_HLL = 7,
+    BUNDLE_COUNT_MIN = 8,
+    BUNDLE_IMAGE = 9
+};
+
+/**
+ * @class SketchBundleWriter
+ * @brief Collects the serialized sketches of a save cycle and writes them as one bundle.
+ *
+ * The payloads are not copied, they must stay unchanged until write().
+ */
+class SketchBundleWriter {
+public:
+    /**
+     * @brief Adds an entry, its checksum is computed here
+     * @param name Name of the entry, e.g. the metric name
+     * @param type Type of the payload, see bundle_entry_type_e
+     */
+    void add(const std::string& name, uint8_t type, const char* data, size_t size);
+
+    /**
+     * @brief Returns the number of entries added since the last clear()
+     */
+    size_t get_num_entries() const { return entries_.size(); }
+
+    /**
+     * @brief Returns the size of the bundle write() produces
+     */
+    size_t get_size_bytes() const;
+
+    /**
+     * @brief Writes header, index and payloads in one sequential pass
+     */
+    void write(std::ostream& os) const;
+
+    /**
+     * @brief Removes all entries, the index memory is kept for the next cycle
+     */
+    void clear() { entries_.clear(); }
+
+private:
+    struct pending_entry {
+        std::string name;
+        uint8_t type;
+        uint32_t checksum;
+        const char* data;
+        size_t size;
+    };
+    std::vector<pending_entry> entries_;
+};
+
+/**
+ * @class SketchBundle
+ * @brief Read-only view of a bundle file through a memory mapping, or of the
+ * inflated contents of a compressed bundle.
+ *
+ * Missing, truncated or corrupted files give an invalid bundle without
+ * entries, callers check valid() instead of catching exceptions.
+ */
+class SketchBundle {
+public:
+    static constexpr uint8_t SERIAL_VERSION = 1;
+    static constexpr uint8_t FAMILY = 0xEB;
+    static constexpr size_t HEADER_SIZE = 16;
+    static constexpr size_t ENTRY_SIZE = 24;
+
+    struct Entry {
+        std::string name;
+        uint8_t type;
+        uint32_t checksum;
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    /**
+     * @brief Maps a bundle file and reads its index, a path ending in .gz is inflated
+     */
+    explicit SketchBundle(const std::string& path);
+    ~SketchBundle();
+
+    SketchBundle(const SketchBundle& other) = delete;
+    SketchBundle& operator=(const SketchBundle& other) = delete;
+
+    bool valid() const { return valid_; }
+
+    const std::vector<Entry>& entries() const { return entries_; }
+
+    /**
+     * @brief Returns the entry of the given name, nullptr if there is none
+     */
+    const Entry* find(const std::string& name) const;
+
+    /**
+     * @brief Returns the payload of an entry inside the mapping
+     */
+    const char* data(const Entry& entry) const;
+
+    /**
+     * @brief Whether the payload of an entry matches its checksum
+     */
+    bool verify(const Entry& entry) const;
+
+    /**
+     * @brief Reads the index of a bundle in memory
+     * @return false if the header or an entry is out of bounds
+     */
+    static bool parse(const char* data, size_t size, std::vector<Entry>& entries);
+
+    /**
+     * @brief CRC-32 of a payload, the checksum stored in the index
+     */
+    static uint32_t checksum(const char* data, size_t size);
+
+private:
+    std::unique_ptr<MappedFile> file_;
+    std::vector<char> inflated_;
+    const char* data_;
+    std::vector<Entry> entries_;
+    bool valid_;
+};
+
+#endif // SKETCH_BUNDLE_H
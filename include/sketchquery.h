@@ -0,0 +1,87 @@
+/**
+ * @file sketchquery.h
+ * @brief Header file for the SketchQuery class, an offline reader of saved sketch directories.
+ *
+ * The profilers write one KLL sketch per metric into their statSavepath, the
+ * uploaded folders of many devices hold the same file names many times.
+ * SketchQuery collects all *.bin files below a list of paths, maps them into
+ * memory and merges the sketches of every metric on all cores. The metric of
+ * a file is its name without the extension, so brightness.bin of every device
+ * ends up in the brightness metric. Files that are not KLL sketches, e.g.
+ * frequent items or latency histograms, fail the header check of
+ * kll_sketch_view and are counted as skipped. Compressed sketches (*.bin.gz)
+ * count to the metric of their name without both extensions. Sketch bundles
+ * (*.bundle, *.bundle.gz) contribute their KLL entries under the entry names.
+ */
+
+#ifndef SKETCH_QUERY_H
+#define SKETCH_QUERY_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <kll_sketch.hpp>
+
+class SketchQuery {
+public:
+    // Merged sketches are only read by the tool, they do not use the profiler arena
+    typedef datasketches::kll_sketch<float> sketch_type;
+
+    /**
+     * @brief Merged sketch of all files of one metric
+     */
+    struct Metric {
+        Metric() : files(0) {}
+        uint64_t files;
+        sketch_type sketch;
+    };
+
+    /**
+     * @brief Constructor to initialize SketchQuery object
+     * @param threads Number of worker threads, 0 for one per core
+     */
+    explicit SketchQuery(unsigned threads = 0);
+
+    /**
+     * @brief Collects the *.bin, *.bin.gz, *.bundle and *.bundle.gz files below the given files or directories
+     * @return Number of files collected so far
+     */
+    size_t addPath(const std::string& path);
+
+    /**
+     * @brief Reads and merges all collected files in parallel
+     */
+    void run();
+
+    const std::map<std::string, Metric>& getMetrics() const;
+
+    /**
+     * @brief Returns the number of files that were not valid KLL sketches
+     */
+    uint64_t getSkipped() const;
+
+    /**
+     * @brief Writes one row per metric: metric, files, n, min, max, one column
+     * per rank and one per CDF split point
+     */
+    void writeCsv(std::ostream& os, const std::vector<double>& ranks, const std::vector<float>& split_points) const;
+
+    /**
+     * @brief Writes the same summary as writeCsv as a JSON object keyed by metric
+     */
+    void writeJson(std::ostream& os, const std::vector<double>& ranks, const std::vector<float>& split_points) const;
+
+#ifndef TEST
+private:
+#endif
+    unsigned threads_;
+    std::vector<std::string> files_;
+    std::map<std::string, Metric> metrics_;
+    uint64_t skipped_;
+
+    static std::string metricName(const std::string& path);
+};
+
+#endif // SKETCH_QUERY_H
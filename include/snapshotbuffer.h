@@ -0,0 +1,83 @@
+/**
+ * @file snapshotbuffer.h
+ * @brief Header file for the SnapshotBuffer class, an epoch based double buffer.
+ *
+ * One writer thread updates the active buffer while the Saver takes the other
+ * one. At save time the Saver flips the active index and waits until the
+ * writer has left the retired buffer, which is at most one update. From then
+ * on the retired buffer belongs to the Saver until the next flip, so it can be
+ * serialized or merged without holding up the writer.
+ */
+
+#ifndef SNAPSHOT_BUFFER_H
+#define SNAPSHOT_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @class SnapshotBuffer
+ * @brief Double buffer with a lock-free writer and a draining reader.
+ *
+ * write() may only be called from one thread at a time and drain() may only
+ * be called from one thread at a time, the two may run concurrently.
+ */
+template <typename T>
+class SnapshotBuffer {
+public:
+    /**
+     * @brief Constructor to initialize both buffers
+     * @param initial Initial value of both buffers, e.g. an empty sketch
+     */
+    explicit SnapshotBuffer(const T& initial)
+        : buffers_{{initial, initial}}, active_(0), writing_(IDLE) {}
+    SnapshotBuffer(const SnapshotBuffer& other) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer& other) = delete;
+
+    /**
+     * @brief Calls f on the active buffer
+     *
+     * The writer announces the buffer it is about to use and checks that it
+     * is still the active one, otherwise a flip happened in between and it
+     * moves to the new active buffer.
+     */
+    template <typename F>
+    void write(F&& f) {
+        uint32_t index = active_.load();
+        for (;;) {
+            writing_.store(index);
+            const uint32_t current = active_.load();
+            if (current == index) break;
+            index = current;
+        }
+        f(buffers_[index]);
+        writing_.store(IDLE, std::memory_order_release);
+    }
+
+    /**
+     * @brief Flips the buffers and calls f on the retired one
+     *
+     * f owns the retired buffer for the duration of the call and is expected
+     * to take its contents and leave it empty for the next writes.
+     */
+    template <typename F>
+    void drain(F&& f) {
+        const uint32_t retired = active_.load();
+        active_.store(retired ^ 1u);
+        while (writing_.load() == retired) {
+            std::this_thread::yield();
+        }
+        f(buffers_[retired]);
+    }
+
+private:
+    static constexpr uint32_t IDLE = 2;
+
+    std::array<T, 2> buffers_;
+    std::atomic<uint32_t> active_;
+    std::atomic<uint32_t> writing_;
+};
+
+#endif // SNAPSHOT_BUFFER_H
@@ -0,0 +1,96 @@
+/**
+ * @file storageaccounting.h
+ * @brief Header file for the StorageAccounting class, the disk usage of the stats and data directories.
+ *
+ * The Saver checks the size of a directory against its quota before every
+ * write. Walking the directory each time costs one full scan per object and
+ * save interval. Instead every directory is scanned once, when its usage is
+ * first asked for, and the Saver, the image saves and the uploader report
+ * each file they write or remove. The size of every file under a tracked
+ * directory is kept, so a rewrite only adds the difference, and the usage of
+ * a directory is a lookup without any file system access.
+ *
+ * Files changed by another process are not seen until rescan().
+ */
+
+#ifndef STORAGE_ACCOUNTING_H
+#define STORAGE_ACCOUNTING_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @class StorageAccounting
+ * @brief Process-wide byte counts of the tracked directories.
+ */
+class StorageAccounting {
+public:
+    /**
+     * @brief Returns the process-wide storage accounting
+     */
+    static StorageAccounting& instance();
+
+    /**
+     * @brief Returns the bytes of the regular files under dir, scanning it on first use
+     * @param dir Directory, a missing directory is tracked with 0 bytes
+     */
+    uint64_t usage(const std::string& dir);
+
+    /**
+     * @brief Records that a file was created or rewritten, costs one stat of the file
+     * @param path File path, ignored if no tracked directory contains it
+     */
+    void fileWritten(const std::string& path);
+
+    /**
+     * @brief Records that a file was removed
+     * @param path File path, ignored if the file was not counted
+     */
+    void fileRemoved(const std::string& path);
+
+    /**
+     * @brief Scans a directory again, e.g. after another process changed it
+     * @return Bytes of the regular files under dir
+     */
+    uint64_t rescan(const std::string& dir);
+
+    /**
+     * @brief Returns the number of directory scans so far
+     */
+    uint64_t get_scans() const;
+
+#ifndef TEST
+private:
+#endif
+    StorageAccounting();
+
+    /**
+     * @brief Absolute, lexically normal form of a path without a trailing separator
+     */
+    static std::string normalize(const std::string& path);
+
+    /**
+     * @brief Whether path lies below the directory root
+     */
+    static bool contains(const std::string& root, const std::string& path);
+
+    bool tracked_locked(const std::string& path) const;
+    void scan_locked(const std::string& dir);
+
+    /**
+     * @brief Sets the known size of a file and moves every directory containing it by the difference
+     */
+    void set_size_locked(const std::string& path, uint64_t size);
+
+    mutable std::mutex mutex_;
+    // Tracked directory -> bytes of the files below it
+    std::map<std::string, uint64_t> directories_;
+    // File below a tracked directory -> size when last written or scanned
+    std::unordered_map<std::string, uint64_t> files_;
+    uint64_t scans_;
+};
+
+#endif // STORAGE_ACCOUNTING_H
@@ -0,0 +1,27 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <cstddef>
+#include <utility>
+
+/**
+ * @brief Selects the k highest scores of a raw score buffer.
+ *
+ * The buffer is scanned in fixed size chunks. Each chunk is first tested
+ * against the current k-th best score with a branch-free compare that the
+ * compiler vectorizes, and only chunks containing a candidate are inserted
+ * into the small sorted output. The cost is O(n) with a small constant for
+ * k much smaller than n. A larger k partitions the candidates instead, in
+ * O(n + k log k), and k >= n copies every score in one pass. NaN scores are
+ * never selected, -inf scores are.
+ *
+ * @param scores Pointer to n class scores, indexed by class id.
+ * @param n Number of classes.
+ * @param k Number of entries to select.
+ * @param out Output buffer of at least min(k, n) (score, class id) pairs, sorted by
+ * descending score for k < n and in class id order otherwise.
+ * @return size_t Number of selected entries, min(k, number of non-NaN scores).
+ */
+size_t selectTopK(const float* scores, size_t n, size_t k, std::pair<float, int>* out);
+
+#endif // TOPK_H
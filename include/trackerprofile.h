@@ -5,14 +5,11 @@
 #include <map>
 #include "saver.h"
 #include "generic.h"
-#include "kll_sketch.hpp"
+#include "shardedsketch.h"
 
 // Forward declaration of classes or structs if needed
 class Saver;
 
-// Define KLL sketch type
-typedef datasketches::kll_sketch<float> distributionBox;
-
 /**
  * @class TrackerProfile
  * @brief Class responsible for managing and logging tracking-related statistics.
@@ -53,10 +50,10 @@ private:
     std::map<std::string, std::string> modelConfig;  ///< Model configuration map.
     std::string statSavepath;  ///< Path to save statistics.
 
-    // KLL sketches for tracking statistics
-    distributionBox confidence_sketch_;
-    distributionBox track_length_sketch_;
-    distributionBox iou_sketch_;
+    // KLL sketches for tracking statistics, sharded so the Saver reads them from snapshots
+    ShardedSketch confidence_sketch_;
+    ShardedSketch track_length_sketch_;
+    ShardedSketch iou_sketch_;
 
     /**
      * @brief Register statistics to be saved.
@@ -5,7 +5,10 @@
 #include <map>
 #include "saver.h"
 #include "generic.h"
+#include "shardedsketch.h"
+#include "hllsketch.h"
 #include "kll_sketch.hpp"
+#include "sketcharena.h"
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -15,7 +18,7 @@
 class Saver;
 
 // Define KLL sketch type
-typedef datasketches::kll_sketch<float> distributionBox;
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
 
 // 2D and 3D position structs
 struct Position2D {
@@ -70,6 +73,12 @@ public:
      * @param iou IoU value to be logged.
      */
     void log_iou(float iou);
+
+    /**
+     * @brief Log a track ID to the distinct tracks sketch.
+     * @param track_id ID assigned by the tracker, repeated IDs are counted once.
+     */
+    void log_track_id(uint64_t track_id);
     void log_orientation_error(float orientation_error); 
     void log_angular_velocity_latency(float angular_velocity_latency);
     // Methods for Data Sketches (KLL Sketch)
@@ -86,16 +95,18 @@ private:
     std::string statSavepath;  ///< Path to save statistics.
 
     // KLL sketches for tracking statistics
-    distributionBox confidence_sketch_;
-    distributionBox track_length_sketch_;
-    distributionBox iou_sketch_;
-    distributionBox positionError_sketch;
-    distributionBox orientationError_sketch;
-    distributionBox angularVelocityLatency_sketch;
-    distributionBox covarianceSpread_sketch;
-    distributionBox angularDivergence_sketch;
-    distributionBox anomalousRotation_sketch;
-    distributionBox quaternionDrift_sketch;
+    ShardedSketch confidence_sketch_;
+    ShardedSketch track_length_sketch_;
+    ShardedSketch iou_sketch_;
+    ShardedSketch positionError_sketch;
+    ShardedSketch orientationError_sketch;
+    ShardedSketch angularVelocityLatency_sketch;
+    ShardedSketch covarianceSpread_sketch;
+    ShardedSketch angularDivergence_sketch;
+    ShardedSketch anomalousRotation_sketch;
+    ShardedSketch quaternionDrift_sketch;
+    // Distinct track IDs, a fixed 4 KB however many tracks are seen
+    HllSketch trackIds_sketch;
 
     float positionError2D, positionError3D;
     float orientationError;
@@ -0,0 +1,139 @@
+#include "driftmetrics.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Energy distance from the step CDFs of both sorted views
+double DriftMetrics::computeEnergyDistance(const distributionBox& live, const distributionBox& baseline) {
+    if (live.is_empty() || baseline.is_empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    const auto live_view = live.get_sorted_view();
+    const auto base_view = baseline.get_sorted_view();
+    const double live_n = static_cast<double>(live.get_n());
+    const double base_n = static_cast<double>(baseline.get_n());
+
+    auto live_it = live_view.begin();
+    auto base_it = base_view.begin();
+    double live_cdf = 0.0, base_cdf = 0.0;
+    double prev_x = 0.0;
+    bool started = false;
+    double sum = 0.0;
+
+    while (live_it != live_view.end() || base_it != base_view.end()) {
+        double x;
+        if (base_it == base_view.end() || (live_it != live_view.end() && live_it->first < base_it->first)) {
+            x = live_it->first;
+        } else {
+            x = base_it->first;
+        }
+        if (started) {
+            const double diff = live_cdf - base_cdf;
+            sum += diff * diff * (x - prev_x);
+        }
+        while (live_it != live_view.end() && live_it->first == x) {
+            live_cdf = live_it->second / live_n;
+            ++live_it;
+        }
+        while (base_it != base_view.end() && base_it->first == x) {
+            base_cdf = base_it->second / base_n;
+            ++base_it;
+        }
+        prev_x = x;
+        started = true;
+    }
+    return 2.0 * sum;
+}
+
+double DriftMetrics::computeKSDistance(const distributionBox& live, const distributionBox& baseline) {
+    if (live.is_empty() || baseline.is_empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return computeDrift(live.get_sorted_view(), baseline.get_sorted_view()).ks;
+}
+
+double DriftMetrics::computePSI(const distributionBox& live, const distributionBox& baseline, uint32_t bins) {
+    if (live.is_empty() || baseline.is_empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return computeDrift(live.get_sorted_view(), baseline.get_sorted_view(), bins).psi;
+}
+
+double DriftMetrics::computeWasserstein(const distributionBox& live, const distributionBox& baseline) {
+    if (live.is_empty() || baseline.is_empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return computeDrift(live.get_sorted_view(), baseline.get_sorted_view()).wasserstein;
+}
+
+// Total weight of a view, the cumulative weight of its last entry
+static double totalWeight(const sortedView& view) {
+    auto last = view.end();
+    --last;
+    return static_cast<double>(last->second);
+}
+
+/**
+ * @brief Walks both step CDFs in item order for KS and Wasserstein-1, then
+ * bins the live CDF at the baseline quantiles for the PSI
+ */
+DriftScores DriftMetrics::computeDrift(const sortedView& live, const sortedView& baseline, uint32_t bins) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (live.size() == 0 || baseline.size() == 0) {
+        return DriftScores{nan, nan, nan};
+    }
+    const double live_n = totalWeight(live);
+    const double base_n = totalWeight(baseline);
+
+    auto live_it = live.begin();
+    auto base_it = baseline.begin();
+    double live_cdf = 0.0, base_cdf = 0.0;
+    double prev_x = 0.0;
+    bool started = false;
+    double ks = 0.0, wasserstein = 0.0;
+
+    while (live_it != live.end() || base_it != baseline.end()) {
+        double x;
+        if (base_it == baseline.end() || (live_it != live.end() && live_it->first < base_it->first)) {
+            x = live_it->first;
+        } else {
+            x = base_it->first;
+        }
+        if (started) {
+            wasserstein += std::fabs(live_cdf - base_cdf) * (x - prev_x);
+        }
+        while (live_it != live.end() && live_it->first == x) {
+            live_cdf = live_it->second / live_n;
+            ++live_it;
+        }
+        while (base_it != baseline.end() && base_it->first == x) {
+            base_cdf = base_it->second / base_n;
+            ++base_it;
+        }
+        ks = std::max(ks, std::fabs(live_cdf - base_cdf));
+        prev_x = x;
+        started = true;
+    }
+
+    // Bin edges at the baseline quantiles, ties collapse into one bin
+    std::vector<float> edges;
+    for (uint32_t i = 1; i < bins; ++i) {
+        const float edge = baseline.get_quantile(static_cast<double>(i) / bins);
+        if (edges.empty() || edges.back() < edge) edges.push_back(edge);
+    }
+    // Empty bins would make the log infinite
+    const double floor = 1e-4;
+    double psi = 0.0;
+    double live_prev = 0.0, base_prev = 0.0;
+    for (size_t i = 0; i <= edges.size(); ++i) {
+        const double live_rank = i < edges.size() ? live.get_rank(edges[i]) : 1.0;
+        const double base_rank = i < edges.size() ? baseline.get_rank(edges[i]) : 1.0;
+        const double p = std::max(live_rank - live_prev, floor);
+        const double q = std::max(base_rank - base_prev, floor);
+        psi += (p - q) * std::log(p / q);
+        live_prev = live_rank;
+        base_prev = base_rank;
+    }
+    return DriftScores{ks, psi, wasserstein};
+}
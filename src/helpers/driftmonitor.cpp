@@ -0,0 +1,96 @@
+/**
+ * @file driftmonitor.cpp
+ * @brief Implements the DriftMonitor class, scores live sketches against baselines
+ */
+
+#include "driftmonitor.h"
+#include "datatracer_log.h"
+#include <fstream>
+#include <limits>
+
+DriftMonitor::DriftMonitor(const std::string& baseline_dir, const std::string& report_path, uint32_t psi_bins)
+    : baseline_dir_(baseline_dir), report_path_(report_path), psi_bins_(psi_bins) {
+    if (!baseline_dir_.empty() && baseline_dir_.back() != '/') {
+        baseline_dir_ += '/';
+    }
+}
+
+bool DriftMonitor::addMetric(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (metrics_.count(name)) {
+        return true;
+    }
+    std::ifstream is(baseline_dir_ + name + ".bin", std::ios::binary);
+    if (!is) {
+        return false;
+    }
+    try {
+        const ArenaAllocator<float> allocator(SketchArena::instance().account("DriftBaseline"));
+        distributionBox baseline = distributionBox::deserialize(is, datasketches::serde<float>(),
+                                                                std::less<float>(), allocator);
+        if (baseline.is_empty()) {
+            return false;
+        }
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        metrics_[name].reset(new Metric{baseline.get_sorted_view(), DriftScores{nan, nan, nan}, 0});
+    } catch (const std::exception& e) {
+        log_err << "DriftMonitor: invalid baseline for " << name << ": " << e.what() << std::endl;
+        return false;
+    }
+    log_info << "DriftMonitor: loaded baseline of " << name << std::endl;
+    return true;
+}
+
+bool DriftMonitor::hasMetric(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_.count(name) > 0;
+}
+
+void DriftMonitor::update(const std::string& name, const distributionBox& live) {
+    if (live.is_empty() || !hasMetric(name)) {
+        return;
+    }
+    score(name, live.get_sorted_view(), live.get_n());
+}
+
+void DriftMonitor::update(const std::string& name, const ReqSketch& live) {
+    if (live.is_empty() || !hasMetric(name)) {
+        return;
+    }
+    score(name, live.get_sorted_view(), live.get_n());
+}
+
+void DriftMonitor::score(const std::string& name, const sortedView& live_view, uint64_t n) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = metrics_.find(name);
+    if (it == metrics_.end()) {
+        return;
+    }
+    Metric& metric = *it->second;
+    metric.scores = DriftMetrics::computeDrift(live_view, metric.baseline_view, psi_bins_);
+    metric.n = n;
+}
+
+DriftScores DriftMonitor::getScores(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = metrics_.find(name);
+    if (it == metrics_.end()) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        return DriftScores{nan, nan, nan};
+    }
+    return it->second->scores;
+}
+
+void DriftMonitor::writeReport(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "metric,n,ks,psi,wasserstein\n";
+    for (const auto& entry : metrics_) {
+        const Metric& metric = *entry.second;
+        os << entry.first << "," << metric.n << "," << metric.scores.ks << ","
+           << metric.scores.psi << "," << metric.scores.wasserstein << "\n";
+    }
+}
+
+const std::string& DriftMonitor::getReportPath() const {
+    return report_path_;
+}
@@ -6,6 +6,7 @@
 #include <sys/file.h>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
 
 #include <datatracer_log.h>
 
@@ -46,6 +47,36 @@ int release_lock(int fd) {
     return 0;
 }
 
+static int open_directory(const std::string& dir) {
+    return open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+}
+
+bool sync_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        log_err << path << " : open failed, " << strerror(errno) << std::endl;
+        return false;
+    }
+#ifdef __linux__
+    const bool synced = fdatasync(fd) == 0;
+#else
+    const bool synced = fsync(fd) == 0;
+#endif
+    close(fd);
+    return synced;
+}
+
+bool sync_directory(const std::string& dir) {
+    int fd = open_directory(dir);
+    if (fd == -1) {
+        log_err << dir << " : open failed, " << strerror(errno) << std::endl;
+        return false;
+    }
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
 bool createFolderIfNotExists(const std::string& statSavepath, const std::string& dataSavepath) {
     try {
         if (!std::filesystem::exists(statSavepath)) {
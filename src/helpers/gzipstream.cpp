@@ -0,0 +1,81 @@
+/**
+ * @file gzipstream.cpp
+ * @brief Implements the GzipStreambuf class
+ */
+
+#include "gzipstream.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// Input and output blocks, a few KB of sketch compress into far less
+const size_t BLOCK_SIZE = 16 * 1024;
+// 15 bits of window plus 16 selects the gzip header and trailer instead of zlib's
+const int GZIP_WINDOW_BITS = 15 + 16;
+}
+
+GzipStreambuf::GzipStreambuf(std::ostream& sink, int level)
+    : sink_(sink), in_(BLOCK_SIZE), out_(BLOCK_SIZE), finished_(false) {
+    std::memset(&stream_, 0, sizeof(stream_));
+    if (deflateInit2(&stream_, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("GzipStreambuf: invalid compression level " + std::to_string(level));
+    }
+    setp(in_.data(), in_.data() + in_.size());
+}
+
+GzipStreambuf::~GzipStreambuf() {
+    deflateEnd(&stream_);
+}
+
+bool GzipStreambuf::deflateBuffered(int flush) {
+    stream_.next_in = reinterpret_cast<Bytef*>(pbase());
+    stream_.avail_in = static_cast<uInt>(pptr() - pbase());
+    int ret;
+    do {
+        stream_.next_out = reinterpret_cast<Bytef*>(out_.data());
+        stream_.avail_out = static_cast<uInt>(out_.size());
+        ret = deflate(&stream_, flush);
+        if (ret == Z_STREAM_ERROR) return false;
+        sink_.write(out_.data(), out_.size() - stream_.avail_out);
+        // Space left in the output block means all input was taken
+    } while (stream_.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    setp(in_.data(), in_.data() + in_.size());
+    return sink_.good();
+}
+
+GzipStreambuf::int_type GzipStreambuf::overflow(int_type ch) {
+    if (finished_ || !deflateBuffered(Z_NO_FLUSH)) return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+// Hands the buffered input to zlib without a flush point, which would cost ratio
+int GzipStreambuf::sync() {
+    return finished_ || deflateBuffered(Z_NO_FLUSH) ? 0 : -1;
+}
+
+bool GzipStreambuf::finish() {
+    if (finished_) return true;
+    finished_ = true;
+    return deflateBuffered(Z_FINISH);
+}
+
+bool readGzipFile(const std::string& path, std::vector<char>& data) {
+    data.clear();
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+    char buffer[BLOCK_SIZE];
+    int bytes;
+    while ((bytes = gzread(file, buffer, sizeof(buffer))) > 0) {
+        data.insert(data.end(), buffer, buffer + bytes);
+    }
+    int error = Z_OK;
+    gzerror(file, &error);
+    // zlib passes files without a gzip header through unchanged
+    const bool compressed = !gzdirect(file);
+    gzclose(file);
+    return bytes == 0 && error == Z_OK && compressed;
+}
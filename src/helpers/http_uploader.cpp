@@ -4,6 +4,7 @@
 @brief Implementation of the HttpUploader class for uploading files via HTTP.
 */
 
+#include <algorithm>
 #include <fstream>
 #include <vector>
 #include <ctime>
@@ -15,6 +16,7 @@
 #include "http_uploader.h"
 #include "iniparser.h"
 #include "generic.h"
+#include "storageaccounting.h"
 #include "datatracer_log.h"
 
 namespace fs = std::filesystem;
@@ -95,6 +97,9 @@ void HttpUploader::StartUpload() {
 /**
 
 @brief The main loop for uploading files. This function runs in a separate thread.
+
+Between two uploads the thread waits on a condition variable, StopUpload wakes it
+right away instead of after the rest of the interval.
 */
 
 void HttpUploader::UploadLoop() {
@@ -103,13 +108,13 @@ void HttpUploader::UploadLoop() {
         do {
 
             if (exitUploadLoop.load()) {
-              pthread_exit(nullptr);// Thread termination condition
+                return;// Thread termination condition
             }
 
             std::unique_lock<std::mutex> lock(upload_mutex_);
 
             if (exitUploadLoop.load()) {
-                pthread_exit(nullptr);// Thread termination condition
+                return;// Thread termination condition
             }
 
             uploadFolder(index);
@@ -118,11 +123,10 @@ void HttpUploader::UploadLoop() {
                 index = 0;
         }while(0); //scope of queue_mutex_
 
-        for (int i = 0; i < http_uploader_data_.interval; i++) {
-            if (exitUploadLoop.load()) {
-                pthread_exit(nullptr);// Thread termination condition
-            }
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+        std::unique_lock<std::mutex> lock(exit_mutex_);
+        if (exit_cv_.wait_for(lock, std::chrono::seconds(http_uploader_data_.interval),
+                              [this] { return exitUploadLoop.load(); })) {
+            return;// Thread termination condition
         }
     }
 }
@@ -135,7 +139,11 @@ void HttpUploader::UploadLoop() {
 
 void HttpUploader::StopUpload(void) {
     if (upload_thread_.joinable()) {
-        exitUploadLoop.store(true);
+        {
+            std::lock_guard<std::mutex> lock(exit_mutex_);
+            exitUploadLoop.store(true);
+        }
+        exit_cv_.notify_all();
         upload_thread_.join();
     }
 }
@@ -149,6 +157,10 @@ void HttpUploader::StopUpload(void) {
 @return True if the upload was successful, false otherwise.
 */
 
+static bool hasSuffix(const std::string& name, const std::string& suffix) {
+    return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
 bool HttpUploader::uploadFolder(int &index) {
     bool ret = false;
     // Get current time as time_point
@@ -157,55 +169,83 @@ bool HttpUploader::uploadFolder(int &index) {
     std::time_t timestamp = std::chrono::system_clock::to_time_t(now);
     TarGzCreator tarGzCreator;
 
-    // Step 1: Create tar file
     std::vector<std::string> folders = { http_uploader_data_.folderPath[index]};
     std::vector<std::string> files = tarGzCreator.collectFilesFromFolders(folders);
     std::string tarFilePath = http_uploader_data_.folderPath[index] + "_archive_lock.tar";
     std::string gzFilePath = http_uploader_data_.folderPath[index] + "_archive_lock.tar.gz";
 
+    // Sketch bundles are sent as they are, only the other files need a tar
+    std::vector<std::string> bundles;
+    files.erase(std::remove_if(files.begin(), files.end(), [&bundles](const std::string& file) {
+        if (!hasSuffix(file, ".bundle") && !hasSuffix(file, ".bundle.gz")) return false;
+        bundles.push_back(file);
+        return true;
+    }), files.end());
+    // Files the Saver already compressed gain nothing from a second gzip pass
+    const bool compressed = !files.empty() && std::all_of(files.begin(), files.end(), [](const std::string& file) {
+        return hasSuffix(file, ".gz");
+    });
+
     int fd = acquire_lock(folders[0]);
     if (fd == -1) {
         uploader_err << "Failed to acquire_lock." << std::endl;
         return ret;
     }
 
-    if (!tarGzCreator.createTar(tarFilePath, files, http_uploader_data_.folderPath[index])) {
-        uploader_err << "Failed to create tar file." << std::endl;
-        goto del_tar_gz;
+    // Step 1: Upload the bundles
+    for (const std::string& bundle : bundles) {
+        if (!postFileWithRetry(bundle, timestamp, index, hasSuffix(bundle, ".gz") ? "application/gzip" : "application/octet-stream")) {
+            goto del_tar_gz;
+        }
     }
 
-    // Step 2: Compress to tar.gz
-    if (!tarGzCreator.compressToGz(tarFilePath, gzFilePath)) {
-        uploader_err << "Failed to compress tar file to gz." << std::endl;
-        goto del_tar_gz;
-    }
+    if (!files.empty() || bundles.empty()) {
+        // Step 2: Create tar file
+        if (!tarGzCreator.createTar(tarFilePath, files, http_uploader_data_.folderPath[index])) {
+            uploader_err << "Failed to create tar file." << std::endl;
+            goto del_tar_gz;
+        }
+        StorageAccounting::instance().fileWritten(tarFilePath);
 
-    // Step 3: Upload the file
-    for(int retry = 0; retry < UPLOAD_RETRY_COUNT; retry++) {
-        if (postFile(gzFilePath, http_uploader_data_.sensorId, timestamp, http_uploader_data_.fileType[index])) {
-            ret = true;
-            // Step 4: Empty the folder
-            uploader_info << "emptyFolder " << http_uploader_data_.folderPath[index] << " : " << http_uploader_data_.deletedata[index] << std::endl;
-            if (!tarGzCreator.emptyFolder(http_uploader_data_.folderPath[index]) && http_uploader_data_.deletedata[index]) {
-                uploader_err << "Failed to empty the folder." << std::endl;
+        // Step 3: Compress to tar.gz, unless the files are compressed already
+        if (compressed) {
+            if (!postFileWithRetry(tarFilePath, timestamp, index, "application/x-tar")) {
+                goto del_tar_gz;
+            }
+        } else {
+            if (!tarGzCreator.compressToGz(tarFilePath, gzFilePath)) {
+                uploader_err << "Failed to compress tar file to gz." << std::endl;
+                goto del_tar_gz;
+            }
+            StorageAccounting::instance().fileWritten(gzFilePath);
+
+            // Step 4: Upload the file
+            if (!postFileWithRetry(gzFilePath, timestamp, index, "application/gzip")) {
+                goto del_tar_gz;
             }
-            goto del_tar_gz;
         }
-        uploader_err << "Failed to upload gz file. Try - " << retry << std::endl;
-        sleep(1);
+    }
+    ret = true;
+
+    // Step 5: Empty the folder
+    uploader_info << "emptyFolder " << http_uploader_data_.folderPath[index] << " : " << http_uploader_data_.deletedata[index] << std::endl;
+    if (!tarGzCreator.emptyFolder(http_uploader_data_.folderPath[index]) && http_uploader_data_.deletedata[index]) {
+        uploader_err << "Failed to empty the folder." << std::endl;
     }
 
 del_tar_gz:
     release_lock(fd);
 
-    // Step 5: Delete the gz file
+    // Step 6: Delete the gz file
     if (fs::exists(gzFilePath)) {
         fs::remove(gzFilePath);
+        StorageAccounting::instance().fileRemoved(gzFilePath);
     }
 
-    // Step 6: Delete the tar file
+    // Step 7: Delete the tar file
     if (fs::exists(tarFilePath)) {
         fs::remove(tarFilePath);
+        StorageAccounting::instance().fileRemoved(tarFilePath);
     }
 
     return ret;
@@ -213,6 +253,24 @@ del_tar_gz:
 
 /**
 
+@brief Sends a file, retrying up to UPLOAD_RETRY_COUNT times.
+
+@return True if the file was successfully uploaded, false otherwise.
+*/
+
+bool HttpUploader::postFileWithRetry(const std::string& filePath, time_t timestamp, int index, const std::string& contentType) {
+    for(int retry = 0; retry < UPLOAD_RETRY_COUNT; retry++) {
+        if (postFile(filePath, http_uploader_data_.sensorId, timestamp, http_uploader_data_.fileType[index], contentType)) {
+            return true;
+        }
+        uploader_err << "Failed to upload " << filePath << ". Try - " << retry << std::endl;
+        sleep(1);
+    }
+    return false;
+}
+
+/**
+
 @brief Sends the specified file via HTTP POST.
 
 @param filePath Path to the file to upload.
@@ -223,10 +281,12 @@ del_tar_gz:
 
 @param fileType Type of the file being uploaded.
 
+@param contentType MIME type of the file content.
+
 @return True if the file was successfully uploaded, false otherwise.
 */
 
-bool HttpUploader::postFile(const std::string& filePath, const std::string& sensorId, time_t timestamp, const std::string& fileType) {
+bool HttpUploader::postFile(const std::string& filePath, const std::string& sensorId, time_t timestamp, const std::string& fileType, const std::string& contentType) {
     CURL* curl = curl_easy_init();
     if (!curl) {
         return false;
@@ -276,7 +336,7 @@ bool HttpUploader::postFile(const std::string& filePath, const std::string& sens
         CURLFORM_BUFFER, filePath.c_str(),
         CURLFORM_BUFFERLENGTH, fileBuffer.size(),
         CURLFORM_BUFFERPTR, fileBuffer.data(),
-        CURLFORM_CONTENTTYPE, "application/gzip", // Specify the content type as gzip
+        CURLFORM_CONTENTTYPE, contentType.c_str(),
         CURLFORM_END);
 
     curl_easy_setopt(curl, CURLOPT_HTTPPOST, formpost);
@@ -13,6 +13,7 @@
 #include <iomanip>
 #include <chrono>
 #include <ctime>
+#include "storageaccounting.h"
 
 
 /**
@@ -173,6 +174,40 @@ double calculateBrightness(cv::Mat &img) {
     }
 }
 
+/**
+ * @brief Calculate the average hash of an image thumbnail.
+ * 
+ * @param img The input image.
+ * @return uint64_t The 64 bit average hash, 0 for an empty image.
+ */
+uint64_t calculateAverageHash(const cv::Mat &img) {
+    if (img.empty()) {
+        return 0;
+    }
+    cv::Mat grayscale;
+    if (img.channels() == 3) {
+        cv::cvtColor(img, grayscale, cv::COLOR_BGR2GRAY);
+    } else if (img.channels() == 4) {
+        cv::cvtColor(img, grayscale, cv::COLOR_BGRA2GRAY);
+    } else {
+        grayscale = img;
+    }
+    // Area interpolation averages all pixels of a cell, not just a sample
+    cv::Mat thumbnail;
+    cv::resize(grayscale, thumbnail, cv::Size(8, 8), 0, 0, cv::INTER_AREA);
+    thumbnail.convertTo(thumbnail, CV_32F);
+    const double mean = cv::mean(thumbnail)[0];
+
+    uint64_t hash = 0;
+    for (int row = 0; row < 8; ++row) {
+        const float* pixel = thumbnail.ptr<float>(row);
+        for (int col = 0; col < 8; ++col) {
+            hash = (hash << 1) | (pixel[col] > mean ? 1u : 0u);
+        }
+    }
+    return hash;
+}
+
 /**
  * @brief Save an image with an incremental name in the specified directory.
  * 
@@ -216,6 +251,7 @@ std::string saveImageWithIncrementalName(const cv::Mat &img, const std::string &
     std::string newFilename = ss.str();
 
     cv::imwrite(newFilename, img);
+    StorageAccounting::instance().fileWritten(newFilename);
 
     return newFilename;
 }
@@ -251,6 +287,7 @@ std::string saveImageWithTimestamp(const cv::Mat &img, const std::string &path,
 
     // Save the image
     cv::imwrite(newFilename, img);
+    StorageAccounting::instance().fileWritten(newFilename);
 
     return newFilename;
 }
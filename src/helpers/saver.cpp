@@ -1,16 +1,21 @@
 #include "saver.h"
+#include <algorithm>
 #include <fstream>
+#include <stdexcept>
 #include <datatracer_log.h>
 #include <generic.h>
+#include <storageaccounting.h>
+#include <saverservice.h>
+#include <sketcharena.h>
+#include <gzipstream.h>
+#include <mappedfile.h>
+#include <thread>
 
-// Sketch includes
-#include <kll_sketch.hpp>
-#include <frequent_items_sketch.hpp>
-
-typedef datasketches::kll_sketch<float> distributionBox;
-typedef datasketches::frequent_items_sketch<std::string> frequent_class_sketch;
+#include <driftmonitor.h>
 
 Saver::~Saver(){
+    // No save cycle runs once deregistered, the objects can go
+    StopSaving();
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
         while (!(objects_to_save_.empty())) {
@@ -19,146 +24,656 @@ Saver::~Saver(){
           delete object;
         }
     }
-    StopSaving();
+    delete drift_monitor_;
 }
 
 Saver::Saver(int interval, std::string class_name) {
-    save_interval_ = interval;
+    // The save cycles are scheduled in multiples of the interval
+    if (interval <= 0) {
+        throw std::invalid_argument("Saver: save interval of " + class_name + " must be positive, got "
+                                    + std::to_string(interval));
+    }
+    save_interval_ = std::chrono::seconds(interval);
     parent_name = class_name;
-    exitSaveLoop.store(false);
+    cycles_.store(0);
+    written_.store(0);
+    skipped_.store(0);
+    failed_.store(0);
+    drift_monitor_ = nullptr;
+    compression_level_ = 0;
+    restore_ = false;
+    restore_on_start_ = false;
+    flush_requested_.store(false);
+}
+
+void Saver::EnableDriftMonitor(const std::string& baseline_dir, const std::string& report_path) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (drift_monitor_ == nullptr) {
+        drift_monitor_ = new DriftMonitor(baseline_dir, report_path);
+        log_info << parent_name << ": drift against baselines in " << baseline_dir << std::endl;
+    }
+}
+
+void Saver::EnableBundle(const std::string& bundle_path) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    bundle_path_ = bundle_path;
+    log_info << parent_name << ": saving into the bundle " << bundle_path << std::endl;
+}
+
+void Saver::EnableCompression(int level) {
+    if (level < 1 || level > 9) {
+        throw std::invalid_argument("Saver: compression level must be 1 to 9, got " + std::to_string(level));
+    }
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    compression_level_ = level;
+    log_info << parent_name << ": gzip compression at level " << level << std::endl;
+}
+
+/**
+ * @brief Applies the settings every profile shares to the Saver
+ *
+ * The keys are removed, profiles that register a statistic per remaining key
+ * only see their own ones.
+ */
+void Saver::Configure(std::map<std::string, std::vector<std::string>>& config, const std::string& statSavepath) {
+    if (!config["drift_baseline"].empty()) {
+        EnableDriftMonitor(config["drift_baseline"][0], statSavepath + "drift_report.csv");
+    }
+    config.erase("drift_baseline");
+    // Optional single bundle file of all sketches per save cycle instead of a file each
+    if (!config["bundle"].empty()) {
+        EnableBundle(statSavepath + config["bundle"][0]);
+    }
+    config.erase("bundle");
+    // Optional gzip compression of the written sketches, zlib level 1-9
+    if (!config["compression"].empty()) {
+        const std::string& value = config["compression"][0];
+        size_t parsed = 0;
+        int level = 0;
+        try {
+            level = std::stoi(value, &parsed);
+        } catch (const std::exception& e) {
+            parsed = 0;
+        }
+        if (parsed == 0 || parsed != value.size() || level < 1 || level > 9) {
+            log_err << parent_name << ": compression must be a zlib level 1-9, got " << value
+                    << ", writing uncompressed" << std::endl;
+        } else {
+            EnableCompression(level);
+        }
+    }
+    config.erase("compression");
+    // Optional save interval per metric, <metric>:<milliseconds>
+    for (const std::string& value : config["save_intervals"]) {
+        try {
+            SetSaveIntervals({value});
+        } catch (const std::invalid_argument& e) {
+            log_err << e.what() << ", keeping the interval of " << parent_name << std::endl;
+        }
+    }
+    config.erase("save_intervals");
+    // Sketches continue from the snapshot of the previous run unless fresh_start = true
+    const bool freshStart = !config["fresh_start"].empty() && config["fresh_start"][0] == "true";
+    config.erase("fresh_start");
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    restore_on_start_ = !freshStart;
+}
+
+/**
+ * @brief Restores the objects added so far across all cores
+ *
+ * Each object reads only its own file or bundle entry, so the workers share
+ * nothing but the index of the next object. The remaining verified entries
+ * of a bundle wait for objects created later, e.g. on the first inference of
+ * a class.
+ */
+void Saver::EnableRestore() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (restore_) return;
+    restore_ = true;
+
+    if (!bundle_path_.empty()) {
+        const std::string path = LatestSnapshot(bundle_path_);
+        if (!path.empty()) {
+            restore_bundle_.reset(new SketchBundle(path));
+            if (!restore_bundle_->valid()) {
+                log_err << parent_name << " : Ignoring invalid bundle " << path << std::endl;
+                restore_bundle_.reset();
+            } else {
+                for (const SketchBundle::Entry& entry : restore_bundle_->entries()) {
+                    if (restore_bundle_->verify(entry)) {
+                        restore_pending_.insert(entry.name);
+                    } else {
+                        log_err << parent_name << " : Checksum mismatch of " << entry.name << " in " << path << std::endl;
+                    }
+                }
+            }
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> restored(0);
+    auto worker = [this, &next, &restored]() {
+        for (size_t i = next.fetch_add(1); i < bundled_objects_.size(); i = next.fetch_add(1)) {
+            if (RestoreObject(bundled_objects_[i])) ++restored;
+        }
+    };
+    const size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), bundled_objects_.size());
+    std::vector<std::thread> workers;
+    for (size_t id = 1; id < threads; ++id) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    for (const data_object_t *object : bundled_objects_) {
+        restore_pending_.erase(MetricName(object));
+    }
+    if (restore_pending_.empty()) restore_bundle_.reset();
+    log_info << parent_name << ": restored " << restored.load() << " of " << bundled_objects_.size() << " objects" << std::endl;
+}
+
+std::string Saver::LatestSnapshot(const std::string &path) {
+    std::error_code ec;
+    const std::string compressed = path + COMPRESSED_SUFFIX;
+    const bool plain_exists = fs::exists(path, ec);
+    const bool compressed_exists = fs::exists(compressed, ec);
+    if (plain_exists && compressed_exists) {
+        return fs::last_write_time(compressed, ec) > fs::last_write_time(path, ec) ? compressed : path;
+    }
+    return compressed_exists ? compressed : plain_exists ? path : std::string();
+}
+
+/**
+ * @brief Merges the last snapshot of an object into it
+ *
+ * Bundle entries are checked against their CRC-32 and type, compressed files
+ * against the CRC-32 of the gzip trailer. Every snapshot must then pass the
+ * serial version and family checks of its deserializer and be consumed
+ * exactly; a snapshot failing any check is skipped and the object starts
+ * empty.
+ */
+bool Saver::RestoreObject(data_object_t *object) {
+    const char *data = nullptr;
+    size_t size = 0;
+    std::vector<char> inflated;
+    std::unique_ptr<MappedFile> file;
+    std::string source;
+
+    if (restore_bundle_ != nullptr) {
+        const std::string name = MetricName(object);
+        if (restore_pending_.count(name) == 0) return false;
+        const SketchBundle::Entry *entry = restore_bundle_->find(name);
+        if (entry->type != object->obj->get_type()) {
+            log_err << parent_name << " : Snapshot of " << name << " has another sketch type, not restored" << std::endl;
+            return false;
+        }
+        data = restore_bundle_->data(*entry);
+        size = entry->length;
+        source = bundle_path_ + ":" + name;
+    } else if (bundle_path_.empty()) {
+        source = LatestSnapshot(object->filename);
+        if (source.empty()) return false;
+        if (source.size() > object->filename.size()) {
+            if (!readGzipFile(source, inflated)) {
+                log_err << parent_name << " : Invalid compressed snapshot " << source << std::endl;
+                return false;
+            }
+            data = inflated.data();
+            size = inflated.size();
+        } else {
+            file.reset(new MappedFile(source));
+            if (!file->valid()) return false;
+            data = static_cast<const char *>(file->data());
+            size = file->size();
+        }
+    } else {
+        return false;
+    }
+
+    try {
+        object->obj->restore(data, size);
+    } catch (const std::exception& e) {
+        log_err << parent_name << " : Invalid snapshot " << source << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
 }
 
-void Saver::AddObjectToSave(void *object, int type, const std::string& filename) {
+std::string Saver::MetricName(const data_object_t *object) {
+    return fs::path(object->filename).stem().string();
+}
+
+void Saver::AddObjectToSave(cv::Mat *image, const std::string& filename) {
+    AddObjectToSave(make_serializable(image, fs::path(filename).extension().string()), filename);
+}
+
+void Saver::AddObjectToSave(std::unique_ptr<Serializable> object, const std::string& filename) {
+    // The save cycle runs on the service thread while the profile keeps updating the object
+    if (!object->is_snapshot_safe()) {
+        throw std::logic_error("Saver: " + filename + " cannot be saved while it is updated, use a sharded sketch");
+    }
     std::lock_guard<std::mutex> lock(queue_mutex_);
     data_object_t *tmp_obj = new data_object_t;
-    tmp_obj->obj = object;
-    tmp_obj->type = type;
+    tmp_obj->obj = std::move(object);
     tmp_obj->filename = filename;
-    tmp_obj->max_size = 1024; //size in KB
+    tmp_obj->max_size = DEFAULT_MAX_SIZE;
+    tmp_obj->saved_version = 0;
+    tmp_obj->saved = false;
+    tmp_obj->size = 0;
+    auto interval = metric_intervals_.find(MetricName(tmp_obj));
+    tmp_obj->interval = interval != metric_intervals_.end() ? interval->second : save_interval_;
+    // Written by the first save cycle
+    tmp_obj->next_due = std::chrono::steady_clock::now();
+    if (!tmp_obj->obj->is_one_shot()) {
+        bundled_objects_.push_back(tmp_obj);
+        // Objects created on first use pick up their snapshot here
+        if (restore_) {
+            RestoreObject(tmp_obj);
+            restore_pending_.erase(MetricName(tmp_obj));
+            if (restore_pending_.empty()) restore_bundle_.reset();
+        }
+    }
+    if (drift_monitor_ != nullptr && tmp_obj->obj->is_drift_metric()) {
+        drift_monitor_->addMetric(MetricName(tmp_obj));
+    }
     objects_to_save_.push(tmp_obj);
-    cv_.notify_one(); // Notify the waiting thread about a new object
     log_info << parent_name << ": added " << filename << " into saver" << std::endl;
 }
 
+std::chrono::milliseconds Saver::CycleInterval() const {
+    std::chrono::milliseconds interval = save_interval_;
+    for (const auto& entry : metric_intervals_) {
+        interval = std::min(interval, entry.second);
+    }
+    return interval;
+}
+
+void Saver::SetSaveInterval(const std::string& metric, std::chrono::milliseconds interval) {
+    if (interval <= std::chrono::milliseconds::zero()) {
+        throw std::invalid_argument("Saver: save interval of " + metric + " must be positive");
+    }
+    std::chrono::milliseconds cycle;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        metric_intervals_[metric] = interval;
+        // The queue is rotated back into its order
+        for (size_t i = 0; i < objects_to_save_.size(); ++i) {
+            data_object_t *object = objects_to_save_.front();
+            if (MetricName(object) == metric) object->interval = interval;
+            objects_to_save_.pop();
+            objects_to_save_.push(object);
+        }
+        cycle = CycleInterval();
+    }
+    log_info << parent_name << ": " << metric << " saved every " << interval.count() << " ms" << std::endl;
+    // A shorter interval takes effect right away on a running Saver
+    SaverService& service = SaverService::instance();
+    if (service.isRegistered(this)) {
+        service.registerSaver(this, cycle);
+    }
+}
+
+void Saver::SetSaveIntervals(const std::vector<std::string>& values) {
+    for (const std::string& value : values) {
+        const size_t colon = value.rfind(':');
+        size_t parsed = 0;
+        long long milliseconds = 0;
+        try {
+            if (colon != std::string::npos && colon > 0) {
+                milliseconds = std::stoll(value.substr(colon + 1), &parsed);
+            }
+        } catch (const std::exception& e) {
+            parsed = 0;
+        }
+        if (parsed == 0 || parsed != value.size() - colon - 1) {
+            throw std::invalid_argument("Saver: save interval must be <metric>:<milliseconds>, got " + value);
+        }
+        SetSaveInterval(value.substr(0, colon), std::chrono::milliseconds(milliseconds));
+    }
+}
+
 void Saver::StartSaving() {
-    save_thread_ = std::thread(&Saver::SaveLoop, this);
-    log_debug << parent_name << ": saver thread started" << std::endl;
+    std::chrono::milliseconds interval;
+    bool restore;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        interval = CycleInterval();
+        restore = restore_on_start_;
+    }
+    if (restore) {
+        EnableRestore();
+    }
+    SaverService::instance().registerSaver(this, interval);
+    log_debug << parent_name << ": registered with the saver service" << std::endl;
 }
 
 // Trigger method is to asynchronously trigger the object save
 void Saver::TriggerSave() {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    cv_.notify_one(); // Notify the waiting thread to process the queue manually
-    log_debug << parent_name << ": save notification sent to saver thread" << std::endl;
+    flush_requested_.store(true);
+    SaverService::instance().trigger(this);
+    log_debug << parent_name << ": save triggered" << std::endl;
 }
 
-void Saver::SaveLoop() {
-    while (true) {
-        do {
-            if (exitSaveLoop.load()) {
-                log_debug << parent_name << ": exited from saver thread" << std::endl;
-                pthread_exit(nullptr); // Thread termination condition
-            }
+/**
+ * @brief Runs one save cycle
+ *
+ * The SaverService runs the cycles at the shortest interval of the Saver and
+ * its objects; an object is written once its own interval has passed. Its
+ * next due time counts from the previous one, so it keeps its phase against
+ * the cycles instead of slipping to every other one.
+ */
+void Saver::RunSaveCycle(bool flush) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    flush = flush_requested_.exchange(false) || flush;
+    if (objects_to_save_.empty()) {
+        return;
+    }
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            cv_.wait(lock, [&] { return !objects_to_save_.empty() || exitSaveLoop.load(); }); // Wait for a new object or thread termination
+    // Images leave the queue once written, every object is visited once
+    const size_t count = objects_to_save_.size();
+    uint64_t written = 0, skipped = 0, failed = 0;
+    // Changed objects serialized for the bundle, with their version
+    std::vector<std::pair<data_object_t *, uint64_t>> changed;
 
-            if (exitSaveLoop.load()) {
-                log_debug << parent_name << ": exited from saver thread" << std::endl;
-                pthread_exit(nullptr); // Thread termination condition
+    for (size_t i = 0; i < count; ++i) {
+        data_object_t *object = objects_to_save_.front();
+        const bool due = object->obj->is_one_shot() || flush || object->next_due <= now;
+        if (due && object->next_due <= now) {
+            // Stays in phase: the first multiple of the interval after now
+            object->next_due += ((now - object->next_due) / object->interval + 1) * object->interval;
+        }
+        // The version is read before serializing, so an update racing
+        // with the write marks the object dirty for the next cycle
+        uint64_t version = 0;
+        const bool versioned = object->obj->get_version(version);
+        if (!due) {
+            // Left for a later cycle, neither written nor skipped
+        } else if (versioned && object->saved && object->saved_version == version) {
+            ++skipped;
+        } else if (!bundle_path_.empty() && !object->obj->is_one_shot()) {
+            if (SerializeObject(object)) {
+                changed.emplace_back(object, version);
+            } else {
+                ++failed;
             }
+        } else if (!SaveObjectToFile(object, version)) {
+            ++failed;
+        }
 
-            data_object_t *start_object = objects_to_save_.front();
+        if (object->obj->is_one_shot()) {
+            // FIFO logic: remove the object after saving
+            delete object;
+            objects_to_save_.pop();
+        } else {
+            // Rotate the queue by one element (circular approach)
+            objects_to_save_.push(objects_to_save_.front());
+            objects_to_save_.pop();
+        }
+    }
 
-            do {
-                data_object_t *object = objects_to_save_.front();
-                SaveObjectToFile(object);
+    if (!changed.empty() && !SaveBundle(changed)) {
+        failed += changed.size();
+    }
+    // The scores were refreshed by the objects serialized in this cycle
+    if (drift_monitor_ != nullptr && !pending_writes_.empty()) {
+        SaveDriftReport();
+    }
 
-                if (object->type == PNG_TYPE || object->type == JPEG_TYPE) {
-                    // FIFO logic: remove the object after saving
-                    delete object;
-                    objects_to_save_.pop();
-                } else {
-                    // Rotate the queue by one element (circular approach)
-                    objects_to_save_.push(objects_to_save_.front());
-                    objects_to_save_.pop();
-                }
-            } while (start_object != objects_to_save_.front());
+    // Objects are marked saved only once their file is in place
+    CommitPendingWrites(written, failed);
 
-        } while (0); //scope of queue_mutex_
+    cycles_.fetch_add(1);
+    written_.fetch_add(written);
+    skipped_.fetch_add(skipped);
+    failed_.fetch_add(failed);
+    log_debug << parent_name << ": saved " << written << " objects, skipped " << skipped
+              << " unchanged, " << failed << " failed" << std::endl;
+#if DEBUG
+    // Arena usage of the sketches of the profile, the account is named after it
+    SketchArena::instance().report(log_debug, parent_name);
+#endif
+}
 
-        for (int i = 0; i < save_interval_; i++) {
-            if (exitSaveLoop.load()) {
-                log_debug << parent_name << ": exited from saver thread" << std::endl;
-                pthread_exit(nullptr); // Thread termination condition
-            }
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-        }
+const uint32_t Saver::DEFAULT_MAX_SIZE;
+const char *Saver::TEMP_SUFFIX = ".tmp";
+const char *Saver::COMPRESSED_SUFFIX = ".gz";
+
+bool Saver::ReserveDirectory(const fs::path &baseDir, uint32_t max_size) {
+    // Scanned once per directory, then kept up to date by every write
+    StorageAccounting& storage = StorageAccounting::instance();
+    uint64_t dirSize = storage.usage(baseDir.string());
+
+    if (dirSize >= (max_size * 1024))
+        return false;
+
+    auto held = cycle_locks_.find(baseDir.string());
+    if (held == cycle_locks_.end()) {
+        int fd = acquire_lock(baseDir);
+        log_debug << baseDir << " " << fd << std::endl;
+
+        if (fd == -1)
+            return false;
+        cycle_locks_.emplace(baseDir.string(), fd);
     }
+    return true;
 }
 
-static uintmax_t calculateDirectorySize(const fs::path& dir) {
-    uintmax_t size = 0;
-    for (const auto& entry : fs::recursive_directory_iterator(dir)) {
-        if (fs::is_regular_file(entry)) {
-            size += fs::file_size(entry);
+bool Saver::SerializeObject(data_object_t *object) {
+    // The buffer keeps its size between cycles, only a grown object reallocates it
+    try {
+        if (object->buffer.size() < object->obj->get_serialized_size_bytes()) {
+            object->buffer.resize(object->obj->get_serialized_size_bytes());
         }
+        object->size = object->obj->serialize(object->buffer, drift_monitor_, MetricName(object));
+    } catch (const std::exception& e) {
+        log_err << parent_name << " : Error saving file: " << object->filename << ": " << e.what() << std::endl;
+        return false;
     }
-    return size;
+    return true;
 }
 
-void Saver::SaveObjectToFile(data_object_t *object) {
-    std::ofstream os(object->filename.c_str());
+/**
+ * @brief Writes a temporary file through write(ostream&), deflated on the way
+ * when compress is set
+ */
+template <typename Writer>
+bool Saver::WriteTempFile(const std::string &tempFilename, bool compress, Writer write) {
+    StorageAccounting& storage = StorageAccounting::instance();
+    std::ofstream os(tempFilename.c_str(), std::ios::binary | std::ios::trunc);
+    try {
+        if (compress) {
+            GzipStreambuf gzip(os, compression_level_);
+            std::ostream gzos(&gzip);
+            write(gzos);
+            if (gzos.fail() || !gzip.finish()) os.setstate(std::ios::failbit);
+        } else {
+            write(os);
+        }
+    } catch (const std::exception& e) {
+        log_err << parent_name << " : Error writing file: " << tempFilename << ": " << e.what() << std::endl;
+        os.setstate(std::ios::failbit);
+    }
+    // The data must be on disk before the rename can expose it, an unsynced
+    // file is dropped and the previous version stays in place
+    os.flush();
+    if (os.good() && !sync_file(tempFilename)) {
+        log_err << parent_name << " : Error syncing file: " << tempFilename << std::endl;
+        os.setstate(std::ios::failbit);
+    }
+    os.close();
+    if (os.fail()) {
+        log_err << parent_name << " : Error writing file: " << tempFilename << std::endl;
+        std::error_code ec;
+        fs::remove(tempFilename, ec);
+        storage.fileRemoved(tempFilename);
+        return false;
+    }
+    storage.fileWritten(tempFilename);
+    return true;
+}
 
-    fs::path filePath(object->filename);
-    fs::path baseDir = filePath.parent_path();
-    uintmax_t dirSize = calculateDirectorySize(baseDir);
+/**
+ * @brief Writes an object to <filename>.tmp and queues its rename
+ *
+ * With compression enabled sketches go to <filename>.gz; images are already
+ * compressed by their format and are written as they are.
+ * The file in place is never opened for writing: a crash, a full disk or a
+ * quota rejection leaves the previous version intact. The lock of the
+ * directory is taken on its first write of the cycle and held until
+ * CommitPendingWrites, so the uploader never packs a half-renamed cycle.
+ */
+bool Saver::SaveObjectToFile(data_object_t *object, uint64_t version) {
+    if (!ReserveDirectory(fs::path(object->filename).parent_path(), object->max_size))
+        return false;
+    if (!SerializeObject(object))
+        return false;
 
-    if (dirSize >= (object->max_size * 1024))
-        return;
+    const bool compress = compression_level_ != 0 && !object->obj->is_one_shot();
+    const std::string filename = compress ? object->filename + COMPRESSED_SUFFIX : object->filename;
+    const std::string tempFilename = filename + TEMP_SUFFIX;
+    if (!WriteTempFile(tempFilename, compress, [object](std::ostream& os) { os.write(object->buffer.data(), object->size); }))
+        return false;
 
-    int fd = acquire_lock(baseDir);
-    log_debug << baseDir << " " << fd << std::endl;
+    pending_write_t pending;
+    pending.temp_filename = tempFilename;
+    pending.filename = filename;
+    // One-shot objects are removed from the queue right after this call
+    pending.objects.emplace_back(object->obj->is_one_shot() ? nullptr : object, version);
+    pending_writes_.push_back(pending);
+    return true;
+}
 
-    if (fd == -1)
-        return;
+/**
+ * @brief Writes all bundled objects into <bundle_path>.tmp and queues its rename
+ *
+ * With compression enabled the whole bundle is deflated into <bundle_path>.gz.
+ * Unchanged objects were not serialized again, their buffers still hold the
+ * bytes of their last write. Objects that never serialized are left out.
+ */
+bool Saver::SaveBundle(const std::vector<std::pair<data_object_t *, uint64_t>> &changed) {
+    if (!ReserveDirectory(fs::path(bundle_path_).parent_path(), changed.front().first->max_size))
+        return false;
 
+    bundle_writer_.clear();
     try {
-        switch (object->type) {
-            case KLL_TYPE: {
-                distributionBox *obj = (distributionBox *)(object->obj);
-                obj->serialize(os);
-                break;
+        for (data_object_t *object : bundled_objects_) {
+            if (object->size > 0) {
+                bundle_writer_.add(MetricName(object), object->obj->get_type(), object->buffer.data(), object->size);
             }
-            case FI_TYPE: {
-                frequent_class_sketch *obj = (frequent_class_sketch *)(object->obj);
-                obj->serialize(os);
-                break;
-            }
-            case PNG_TYPE:
-            case JPEG_TYPE: {
-                // FIFO logic handled in SaveLoop
-		cv::Mat* img = (cv::Mat*)(object->obj);
-                if (!cv::imwrite(object->filename, *img)) {
-                    log_err << parent_name << " : Error saving image file: " << object->filename << std::endl;
-                }
-                break;
-            }
-            default:
-                log_err << parent_name << " : Unknown object type: " << object->type << std::endl;
+        }
+        // Entries of the previous run whose objects were not created yet
+        for (const std::string& name : restore_pending_) {
+            const SketchBundle::Entry *entry = restore_bundle_->find(name);
+            bundle_writer_.add(name, entry->type, restore_bundle_->data(*entry), entry->length);
         }
     } catch (const std::exception& e) {
-        log_err << parent_name << " : Error saving file: " << e.what() << std::endl;
+        log_err << parent_name << " : Error bundling: " << e.what() << std::endl;
+        return false;
     }
 
-    release_lock(fd);
+    const bool compress = compression_level_ != 0;
+    const std::string filename = compress ? bundle_path_ + COMPRESSED_SUFFIX : bundle_path_;
+    const std::string tempFilename = filename + TEMP_SUFFIX;
+    if (!WriteTempFile(tempFilename, compress, [this](std::ostream& os) { bundle_writer_.write(os); }))
+        return false;
+
+    pending_write_t pending;
+    pending.temp_filename = tempFilename;
+    pending.filename = filename;
+    pending.objects = changed;
+    pending_writes_.push_back(pending);
+    return true;
 }
 
-void Saver::StopSaving(void) {
-    if (save_thread_.joinable()) {
-        exitSaveLoop.store(true);
-        cv_.notify_one(); // Notify the waiting thread to process the queue manually
-        save_thread_.join();
+/**
+ * @brief Writes the drift report to its temporary file and queues its rename
+ *
+ * The report goes through the quota, the accounting and the commit of the
+ * cycle like every sketch, so the uploader never packs a half-written report.
+ * It holds no object and does not count as a written one.
+ */
+bool Saver::SaveDriftReport() {
+    const std::string& filename = drift_monitor_->getReportPath();
+    if (!ReserveDirectory(fs::path(filename).parent_path(), DEFAULT_MAX_SIZE)) {
+        log_err << parent_name << " : No room for the drift report " << filename << std::endl;
+        return false;
+    }
+    const std::string tempFilename = filename + TEMP_SUFFIX;
+    if (!WriteTempFile(tempFilename, false, [this](std::ostream& os) { drift_monitor_->writeReport(os); }))
+        return false;
+
+    pending_write_t pending;
+    pending.temp_filename = tempFilename;
+    pending.filename = filename;
+    pending_writes_.push_back(pending);
+    return true;
+}
+
+/**
+ * @brief Commits the writes of a save cycle
+ *
+ * Every temporary file had its data synced when it was written, so a rename
+ * never exposes a file whose blocks are not on disk yet. Each directory is
+ * then synced once to persist the renames, instead of one fsync per file.
+ */
+void Saver::CommitPendingWrites(uint64_t &written, uint64_t &failed) {
+    StorageAccounting& storage = StorageAccounting::instance();
+    std::vector<std::string> directories;
+    for (const pending_write_t& pending : pending_writes_) {
+        const std::string directory = fs::path(pending.filename).parent_path().string();
+        if (std::find(directories.begin(), directories.end(), directory) == directories.end()) {
+            directories.push_back(directory);
+        }
     }
+
+    for (const pending_write_t& pending : pending_writes_) {
+        std::error_code ec;
+        fs::rename(pending.temp_filename, pending.filename, ec);
+        storage.fileRemoved(pending.temp_filename);
+        if (ec) {
+            log_err << parent_name << " : Error renaming " << pending.temp_filename << ": " << ec.message() << std::endl;
+            fs::remove(pending.temp_filename, ec);
+            failed += pending.objects.size();
+            continue;
+        }
+        storage.fileWritten(pending.filename);
+        for (const auto& entry : pending.objects) {
+            if (entry.first != nullptr) {
+                entry.first->saved_version = entry.second;
+                entry.first->saved = true;
+            }
+            ++written;
+        }
+    }
+    pending_writes_.clear();
+
+    for (const std::string& directory : directories) {
+        if (!sync_directory(directory)) {
+            log_err << parent_name << " : Error syncing directory " << directory << std::endl;
+        }
+    }
+    for (const auto& held : cycle_locks_) {
+        release_lock(held.second);
+    }
+    cycle_locks_.clear();
+}
+
+save_stats_t Saver::GetSaveStats() const {
+    save_stats_t stats;
+    stats.cycles = cycles_.load();
+    stats.written = written_.load();
+    stats.skipped = skipped_.load();
+    stats.failed = failed_.load();
+    return stats;
 }
 
+void Saver::StopSaving(void) {
+    // Nothing updated since the last cycle is lost on a clean shutdown
+    if (SaverService::instance().deregisterSaver(this)) {
+        RunSaveCycle(true);
+    }
+}
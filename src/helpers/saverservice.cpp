@@ -0,0 +1,131 @@
+/**
+ * @file saverservice.cpp
+ * @brief Implements the SaverService class
+ */
+
+#include "saverservice.h"
+#include "saver.h"
+#include <datatracer_log.h>
+#include <thread>
+
+SaverService& SaverService::instance() {
+    static SaverService* service = new SaverService();
+    return *service;
+}
+
+SaverService::SaverService() : running_(nullptr), cycles_(0), started_(false) {}
+
+void SaverService::reschedule_locked(Saver* saver, entry_t& entry, clock::time_point deadline) {
+    schedule_.erase(std::make_pair(entry.deadline, saver));
+    entry.deadline = deadline;
+    schedule_.emplace(deadline, saver);
+}
+
+void SaverService::registerSaver(Saver* saver, clock::duration interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const clock::time_point now = clock::now();
+    auto it = savers_.find(saver);
+    if (it != savers_.end()) {
+        it->second.interval = interval;
+        // A shorter interval must not wait out the deadline of the longer one
+        if (now + interval < it->second.deadline) {
+            reschedule_locked(saver, it->second, now + interval);
+            wakeup_.notify_one();
+        }
+        return;
+    }
+    savers_.emplace(saver, entry_t{now, interval});
+    schedule_.emplace(now, saver);
+    if (!started_) {
+        // Runs for the lifetime of the process, like the service itself
+        std::thread(&SaverService::run, this).detach();
+        started_ = true;
+        log_debug << "saver service thread started" << std::endl;
+    }
+    wakeup_.notify_one();
+}
+
+bool SaverService::deregisterSaver(Saver* saver) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = savers_.find(saver);
+    const bool registered = it != savers_.end();
+    if (registered) {
+        schedule_.erase(std::make_pair(it->second.deadline, saver));
+        savers_.erase(it);
+    }
+    cycle_done_.wait(lock, [&] { return running_ != saver; });
+    return registered;
+}
+
+void SaverService::trigger(Saver* saver) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = savers_.find(saver);
+    if (it == savers_.end()) return;
+    reschedule_locked(saver, it->second, clock::now());
+    wakeup_.notify_one();
+}
+
+/**
+ * @brief Runs a flush cycle of every registered saver on the calling thread
+ *
+ * The lock is held throughout, so no saver can deregister and be destroyed
+ * while it is flushed; a cycle the service thread is running completes first
+ * on the queue lock of its saver.
+ */
+void SaverService::flushAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : savers_) {
+        entry.first->RunSaveCycle(true);
+    }
+}
+
+bool SaverService::isRegistered(Saver* saver) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return savers_.count(saver) != 0;
+}
+
+uint64_t SaverService::get_cycles() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cycles_;
+}
+
+/**
+ * @brief Runs the save cycles in deadline order
+ *
+ * The next deadline counts from the previous one, so a slow cycle does not
+ * shift the schedule of a saver; a saver more than one interval late is
+ * rescheduled from now instead of running cycles back to back.
+ */
+void SaverService::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (schedule_.empty()) {
+            wakeup_.wait(lock);
+            continue;
+        }
+        const auto next = *schedule_.begin();
+        if (clock::now() < next.first) {
+            wakeup_.wait_until(lock, next.first);
+            continue;
+        }
+        Saver* saver = next.second;
+        schedule_.erase(schedule_.begin());
+        running_ = saver;
+        lock.unlock();
+
+        saver->RunSaveCycle();
+
+        lock.lock();
+        running_ = nullptr;
+        ++cycles_;
+        auto it = savers_.find(saver);
+        if (it != savers_.end() && it->second.deadline == next.first) {
+            const clock::time_point now = clock::now();
+            clock::time_point deadline = next.first + it->second.interval;
+            if (deadline < now) deadline = now + it->second.interval;
+            it->second.deadline = deadline;
+            schedule_.emplace(deadline, saver);
+        }
+        cycle_done_.notify_all();
+    }
+}
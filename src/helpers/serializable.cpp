@@ -0,0 +1,279 @@
+/**
+ * @file serializable.cpp
+ * @brief Implements the Serializable wrappers of the sketch types
+ */
+
+#include "serializable.h"
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <type_traits>
+#include <opencv2/opencv.hpp>
+#include <embeddingstats.h>
+#include <projectionsketch.h>
+#include <latencyhistogram.h>
+#include <hllsketch.h>
+#include <countminsketch.h>
+#include <driftmonitor.h>
+
+namespace {
+
+/**
+ * @brief Stream buffer writing to the start of a caller-owned vector
+ *
+ * The vector grows only when a serialization is larger than every previous
+ * one, its size is never reduced, so a buffer sized by the first save takes
+ * no allocation afterwards.
+ */
+class VectorStreambuf : public std::streambuf {
+public:
+    explicit VectorStreambuf(std::vector<char>& buffer) : buffer_(buffer) {
+        if (buffer_.empty()) buffer_.resize(64);
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+
+    size_t written() const { return pptr() - pbase(); }
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+        grow(written() + 1);
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+        return ch;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        if (epptr() - pptr() < n) grow(written() + n);
+        std::copy(s, s + n, pptr());
+        pbump(static_cast<int>(n));
+        return n;
+    }
+
+private:
+    void grow(size_t needed) {
+        const size_t used = written();
+        buffer_.resize(std::max(needed, buffer_.size() * 2));
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+        pbump(static_cast<int>(used));
+    }
+
+    std::vector<char>& buffer_;
+};
+
+// Stream buffer reading a snapshot in place, without a copy into a stringstream
+class ReadStreambuf : public std::streambuf {
+public:
+    ReadStreambuf(const char* data, size_t size) {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    // Seeking lets deserializers check a header against the bytes left
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+        char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+        if (off < eback() - base || off > egptr() - base) return pos_type(off_type(-1));
+        setg(eback(), base + off, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+/*
+ * Per-type access of the wrapper: size() returns 0 when the type has no size
+ * query, serialize() also scores drift metrics when a monitor is passed,
+ * deserialize() reads a snapshot that merge() adds to the object. snapshot_safe
+ * is false for the sketches without any synchronization of their own.
+ */
+template <typename T>
+struct SerializableTraits;
+
+template <>
+struct SerializableTraits<distributionBox> {
+    static constexpr uint8_t type = BUNDLE_KLL;
+    static constexpr bool drift = true;
+    static constexpr bool snapshot_safe = false;
+    static size_t size(const distributionBox& sketch) { return sketch.get_serialized_size_bytes(); }
+    static uint64_t version(const distributionBox& sketch) { return sketch.get_n(); }
+    static void serialize(const distributionBox& sketch, std::ostream& os, DriftMonitor* monitor, const std::string& metric) {
+        sketch.serialize(os);
+        if (monitor != nullptr) monitor->update(metric, sketch);
+    }
+    static distributionBox deserialize(const distributionBox& sketch, std::istream& is) {
+        return distributionBox::deserialize(is, datasketches::serde<float>(), std::less<float>(), sketch.get_allocator());
+    }
+    static void merge(distributionBox& sketch, const distributionBox& snapshot) { sketch.merge(snapshot); }
+};
+
+template <>
+struct SerializableTraits<frequent_class_sketch> {
+    static constexpr uint8_t type = BUNDLE_FREQUENT_ITEMS;
+    static constexpr bool drift = false;
+    static constexpr bool snapshot_safe = false;
+    static size_t size(const frequent_class_sketch& sketch) { return sketch.get_serialized_size_bytes(); }
+    static uint64_t version(const frequent_class_sketch& sketch) { return sketch.get_total_weight(); }
+    static void serialize(const frequent_class_sketch& sketch, std::ostream& os, DriftMonitor*, const std::string&) {
+        sketch.serialize(os);
+    }
+    static frequent_class_sketch deserialize(const frequent_class_sketch&, std::istream& is) {
+        return frequent_class_sketch::deserialize(is);
+    }
+    static void merge(frequent_class_sketch& sketch, const frequent_class_sketch& snapshot) { sketch.merge(snapshot); }
+};
+
+// Sharded sketches are merged once for both the file and the drift scores
+template <typename Sketch>
+struct SerializableTraits<BasicShardedSketch<Sketch>> {
+    static constexpr uint8_t type = std::is_same<Sketch, ReqSketch>::value ? BUNDLE_REQ : BUNDLE_KLL;
+    static constexpr bool drift = true;
+    static constexpr bool snapshot_safe = true;
+    static size_t size(const BasicShardedSketch<Sketch>&) { return 0; }
+    static uint64_t version(const BasicShardedSketch<Sketch>& sketch) { return sketch.get_version(); }
+    static void serialize(const BasicShardedSketch<Sketch>& sketch, std::ostream& os, DriftMonitor* monitor, const std::string& metric) {
+        const Sketch merged = sketch.get_merged();
+        merged.serialize(os);
+        if (monitor != nullptr) monitor->update(metric, merged);
+    }
+    static Sketch deserialize(const BasicShardedSketch<Sketch>&, std::istream& is) { return Sketch::deserialize(is); }
+    static void merge(BasicShardedSketch<Sketch>& sketch, const Sketch& snapshot) { sketch.restore(snapshot); }
+};
+
+// Sketches with only a stream serialization, an update counter and a merge,
+// all of them locked or atomic
+template <typename T, uint8_t Type, uint64_t (T::*Version)() const>
+struct StreamTraits {
+    static constexpr uint8_t type = Type;
+    static constexpr bool drift = false;
+    static constexpr bool snapshot_safe = true;
+    static size_t size(const T&) { return 0; }
+    static uint64_t version(const T& object) { return (object.*Version)(); }
+    static void serialize(const T& object, std::ostream& os, DriftMonitor*, const std::string&) {
+        object.serialize(os);
+    }
+    static T deserialize(const T&, std::istream& is) { return T::deserialize(is); }
+    static void merge(T& object, const T& snapshot) { object.merge(snapshot); }
+};
+
+template <>
+struct SerializableTraits<EmbeddingStats> : StreamTraits<EmbeddingStats, BUNDLE_EMBEDDING_STATS, &EmbeddingStats::get_n> {
+    static EmbeddingStats deserialize(const EmbeddingStats& stats, std::istream& is) {
+        return EmbeddingStats::deserialize(is, stats);
+    }
+};
+template <>
+struct SerializableTraits<ProjectionSketch> : StreamTraits<ProjectionSketch, BUNDLE_PROJECTION_SKETCH, &ProjectionSketch::get_n> {};
+template <>
+struct SerializableTraits<LatencyHistogram> : StreamTraits<LatencyHistogram, BUNDLE_LATENCY_HISTOGRAM, &LatencyHistogram::get_n> {};
+template <>
+struct SerializableTraits<HllSketch> : StreamTraits<HllSketch, BUNDLE_HLL, &HllSketch::get_version> {};
+template <>
+struct SerializableTraits<CountMinSketch> : StreamTraits<CountMinSketch, BUNDLE_COUNT_MIN, &CountMinSketch::get_total_weight> {};
+
+template <typename T>
+class SerializableSketch : public Serializable {
+public:
+    explicit SerializableSketch(T* object) : object_(object), last_size_(0) {}
+
+    size_t get_serialized_size_bytes() const override {
+        const size_t size = SerializableTraits<T>::size(*object_);
+        return size != 0 ? size : last_size_;
+    }
+
+    size_t serialize(std::vector<char>& buffer, DriftMonitor* drift, const std::string& metric) const override {
+        VectorStreambuf streambuf(buffer);
+        std::ostream os(&streambuf);
+        SerializableTraits<T>::serialize(*object_, os, drift, metric);
+        last_size_ = streambuf.written();
+        return last_size_;
+    }
+
+    bool get_version(uint64_t& version) const override {
+        version = SerializableTraits<T>::version(*object_);
+        return true;
+    }
+
+    uint8_t get_type() const override { return SerializableTraits<T>::type; }
+
+    // The snapshot must be consumed exactly, trailing bytes mean a foreign or damaged file
+    void restore(const char* data, size_t size) override {
+        ReadStreambuf streambuf(data, size);
+        std::istream is(&streambuf);
+        const auto snapshot = SerializableTraits<T>::deserialize(*object_, is);
+        if (is.peek() != std::char_traits<char>::eof()) {
+            throw std::runtime_error("snapshot has trailing bytes");
+        }
+        SerializableTraits<T>::merge(*object_, snapshot);
+    }
+
+    bool is_snapshot_safe() const override { return SerializableTraits<T>::snapshot_safe; }
+
+    bool is_drift_metric() const override { return SerializableTraits<T>::drift; }
+
+private:
+    T* object_;
+    mutable size_t last_size_;
+};
+
+class SerializableImage : public Serializable {
+public:
+    SerializableImage(cv::Mat* image, const std::string& extension) : image_(image), extension_(extension), last_size_(0) {}
+
+    size_t get_serialized_size_bytes() const override { return last_size_; }
+
+    // Encoded in memory, the Saver writes the file
+    size_t serialize(std::vector<char>& buffer, DriftMonitor*, const std::string&) const override {
+        std::vector<unsigned char> encoded;
+        if (!cv::imencode(extension_, *image_, encoded)) {
+            throw std::runtime_error("cannot encode image as " + extension_);
+        }
+        if (buffer.size() < encoded.size()) buffer.resize(encoded.size());
+        std::copy(encoded.begin(), encoded.end(), buffer.begin());
+        last_size_ = encoded.size();
+        return last_size_;
+    }
+
+    bool get_version(uint64_t&) const override { return false; }
+
+    uint8_t get_type() const override { return BUNDLE_IMAGE; }
+
+    void restore(const char*, size_t) override {
+        throw std::logic_error("image samples are not restored");
+    }
+
+    // Written once by the next cycle, the caller hands the image over when adding it
+    bool is_snapshot_safe() const override { return true; }
+
+    bool is_one_shot() const override { return true; }
+
+private:
+    cv::Mat* image_;
+    std::string extension_;
+    mutable size_t last_size_;
+};
+
+template <typename T>
+std::unique_ptr<Serializable> wrap(T* object) {
+    return std::unique_ptr<Serializable>(new SerializableSketch<T>(object));
+}
+
+} // namespace
+
+std::unique_ptr<Serializable> make_serializable(distributionBox* sketch) { return wrap(sketch); }
+std::unique_ptr<Serializable> make_serializable(frequent_class_sketch* sketch) { return wrap(sketch); }
+std::unique_ptr<Serializable> make_serializable(EmbeddingStats* stats) { return wrap(stats); }
+std::unique_ptr<Serializable> make_serializable(ProjectionSketch* sketch) { return wrap(sketch); }
+std::unique_ptr<Serializable> make_serializable(LatencyHistogram* histogram) { return wrap(histogram); }
+std::unique_ptr<Serializable> make_serializable(ShardedSketch* sketch) { return wrap(sketch); }
+std::unique_ptr<Serializable> make_serializable(ShardedReqSketch* sketch) { return wrap(sketch); }
+std::unique_ptr<Serializable> make_serializable(HllSketch* sketch) { return wrap(sketch); }
+std::unique_ptr<Serializable> make_serializable(CountMinSketch* sketch) { return wrap(sketch); }
+
+std::unique_ptr<Serializable> make_serializable(cv::Mat* image, const std::string& extension) {
+    return std::unique_ptr<Serializable>(new SerializableImage(image, extension));
+}
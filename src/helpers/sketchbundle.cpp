@@ -0,0 +1,147 @@
+/**
+ * @file sketchbundle.cpp
+ * @brief Implements the SketchBundleWriter and SketchBundle classes
+ */
+
+#include "sketchbundle.h"
+#include "mappedfile.h"
+#include "gzipstream.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <zlib.h>
+#include <common_defs.hpp>
+
+uint32_t SketchBundle::checksum(const char* data, size_t size) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    // crc32 takes the length as uInt, larger payloads go in pieces
+    while (size > 0) {
+        const uInt chunk = static_cast<uInt>(std::min<size_t>(size, std::numeric_limits<uInt>::max()));
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), chunk);
+        data += chunk;
+        size -= chunk;
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+void SketchBundleWriter::add(const std::string& name, uint8_t type, const char* data, size_t size) {
+    if (name.size() > std::numeric_limits<uint16_t>::max()) {
+        throw std::invalid_argument("SketchBundleWriter: entry name too long: " + name.substr(0, 64));
+    }
+    entries_.push_back(pending_entry{name, type, SketchBundle::checksum(data, size), data, size});
+}
+
+size_t SketchBundleWriter::get_size_bytes() const {
+    size_t size = SketchBundle::HEADER_SIZE;
+    for (const pending_entry& entry : entries_) {
+        size += SketchBundle::ENTRY_SIZE + entry.name.size() + entry.size;
+    }
+    return size;
+}
+
+void SketchBundleWriter::write(std::ostream& os) const {
+    uint64_t index_size = SketchBundle::HEADER_SIZE;
+    for (const pending_entry& entry : entries_) {
+        index_size += SketchBundle::ENTRY_SIZE + entry.name.size();
+    }
+    datasketches::write(os, SketchBundle::SERIAL_VERSION);
+    datasketches::write(os, SketchBundle::FAMILY);
+    datasketches::write(os, static_cast<uint16_t>(0));
+    datasketches::write(os, static_cast<uint32_t>(entries_.size()));
+    datasketches::write(os, index_size);
+
+    uint64_t offset = index_size;
+    for (const pending_entry& entry : entries_) {
+        datasketches::write(os, entry.type);
+        datasketches::write(os, static_cast<uint8_t>(0));
+        datasketches::write(os, static_cast<uint16_t>(entry.name.size()));
+        datasketches::write(os, entry.checksum);
+        datasketches::write(os, offset);
+        datasketches::write(os, static_cast<uint64_t>(entry.size));
+        datasketches::write(os, entry.name.data(), entry.name.size());
+        offset += entry.size;
+    }
+    for (const pending_entry& entry : entries_) {
+        datasketches::write(os, entry.data, entry.size);
+    }
+}
+
+template <typename T>
+static T load(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+bool SketchBundle::parse(const char* data, size_t size, std::vector<Entry>& entries) {
+    entries.clear();
+    if (data == nullptr || size < HEADER_SIZE) return false;
+    const uint8_t serial_version = load<uint8_t>(data);
+    const uint8_t family = load<uint8_t>(data + 1);
+    const uint32_t count = load<uint32_t>(data + 4);
+    const uint64_t index_size = load<uint64_t>(data + 8);
+    // Every entry takes at least ENTRY_SIZE bytes of the index
+    if (serial_version != SERIAL_VERSION || family != FAMILY || index_size < HEADER_SIZE || index_size > size ||
+        count > (index_size - HEADER_SIZE) / ENTRY_SIZE) {
+        return false;
+    }
+
+    entries.reserve(count);
+    size_t pos = HEADER_SIZE;
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pos + ENTRY_SIZE > index_size) {
+            entries.clear();
+            return false;
+        }
+        Entry entry;
+        entry.type = load<uint8_t>(data + pos);
+        const uint16_t name_length = load<uint16_t>(data + pos + 2);
+        entry.checksum = load<uint32_t>(data + pos + 4);
+        entry.offset = load<uint64_t>(data + pos + 8);
+        entry.length = load<uint64_t>(data + pos + 16);
+        pos += ENTRY_SIZE;
+        if (pos + name_length > index_size || entry.offset < index_size ||
+            entry.offset > size || entry.length > size - entry.offset) {
+            entries.clear();
+            return false;
+        }
+        entry.name.assign(data + pos, name_length);
+        pos += name_length;
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+SketchBundle::SketchBundle(const std::string& path) : data_(nullptr), valid_(false) {
+    const std::string suffix = ".gz";
+    if (path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        if (readGzipFile(path, inflated_)) {
+            data_ = inflated_.data();
+            valid_ = parse(data_, inflated_.size(), entries_);
+        }
+        return;
+    }
+    file_.reset(new MappedFile(path));
+    if (file_->valid()) {
+        data_ = static_cast<const char*>(file_->data());
+        valid_ = parse(data_, file_->size(), entries_);
+    }
+}
+
+SketchBundle::~SketchBundle() {}
+
+const SketchBundle::Entry* SketchBundle::find(const std::string& name) const {
+    for (const Entry& entry : entries_) {
+        if (entry.name == name) return &entry;
+    }
+    return nullptr;
+}
+
+const char* SketchBundle::data(const Entry& entry) const {
+    return data_ + entry.offset;
+}
+
+bool SketchBundle::verify(const Entry& entry) const {
+    return checksum(data(entry), entry.length) == entry.checksum;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file sketchquery.cpp
+ * @brief Implements the SketchQuery class, merges saved KLL sketches by metric
+ */
+
+#include "sketchquery.h"
+#include "gzipstream.h"
+#include "mappedfile.h"
+#include "sketchbundle.h"
+#include <kll_sketch_view.hpp>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+static bool isBundle(const fs::path& path) {
+    return path.extension() == ".bundle" || (path.extension() == ".gz" && path.stem().extension() == ".bundle");
+}
+
+// A sketch written by a Saver with compression enabled
+static bool isCompressed(const fs::path& path) {
+    return path.extension() == ".gz" && path.stem().extension() == ".bin";
+}
+
+SketchQuery::SketchQuery(unsigned threads) : threads_(threads), skipped_(0) {
+    if (threads_ == 0) {
+        threads_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+size_t SketchQuery::addPath(const std::string& path) {
+    std::error_code ec;
+    if (fs::is_regular_file(path, ec)) {
+        files_.push_back(path);
+    } else if (fs::is_directory(path, ec)) {
+        for (fs::recursive_directory_iterator it(path, ec), end; it != end; it.increment(ec)) {
+            if (ec) break;
+            if (it->is_regular_file(ec) && (it->path().extension() == ".bin" || isCompressed(it->path()) ||
+                                          isBundle(it->path()))) {
+                files_.push_back(it->path().string());
+            }
+        }
+    }
+    return files_.size();
+}
+
+std::string SketchQuery::metricName(const std::string& path) {
+    fs::path name = fs::path(path).filename();
+    if (isCompressed(name)) {
+        name = name.stem();
+    }
+    return name.stem().string();
+}
+
+/**
+ * @brief Merges all collected files
+ *
+ * Every worker takes the next file from a shared index and merges it into
+ * sketches of its own, keyed by metric, so the workers never lock. The view
+ * checks the header straight from the mapping, so other file types and empty
+ * sketches are rejected without deserializing. A bundle counts as one file
+ * for each of its KLL entries, keyed by entry name; entries failing their
+ * checksum are skipped. A compressed sketch is inflated into memory first,
+ * like a compressed bundle. The partial sketches of the workers are merged at
+ * the end.
+ */
+void SketchQuery::run() {
+    typedef std::unordered_map<std::string, Metric> Partial;
+    std::vector<Partial> partials(threads_);
+    std::vector<uint64_t> skipped(threads_, 0);
+    std::atomic<size_t> next(0);
+
+    auto merge = [](Partial& partial, const std::string& name, const void* data, size_t size) {
+        const datasketches::kll_sketch_view<float> view(data, size);
+        Metric& metric = partial[name];
+        ++metric.files;
+        if (!view.is_empty()) {
+            metric.sketch.merge(sketch_type::deserialize(data, size));
+        }
+    };
+
+    auto worker = [this, &partials, &skipped, &next, &merge](unsigned id) {
+        Partial& partial = partials[id];
+        for (size_t i = next.fetch_add(1); i < files_.size(); i = next.fetch_add(1)) {
+            if (isBundle(files_[i])) {
+                const SketchBundle bundle(files_[i]);
+                if (!bundle.valid()) {
+                    ++skipped[id];
+                    continue;
+                }
+                for (const SketchBundle::Entry& entry : bundle.entries()) {
+                    if (entry.type != BUNDLE_KLL) continue;
+                    try {
+                        if (!bundle.verify(entry)) throw std::runtime_error("checksum mismatch");
+                        merge(partial, entry.name, bundle.data(entry), entry.length);
+                    } catch (const std::exception& e) {
+                        ++skipped[id];
+                    }
+                }
+                continue;
+            }
+            if (isCompressed(files_[i])) {
+                std::vector<char> data;
+                if (!readGzipFile(files_[i], data)) {
+                    ++skipped[id];
+                    continue;
+                }
+                try {
+                    merge(partial, metricName(files_[i]), data.data(), data.size());
+                } catch (const std::exception& e) {
+                    ++skipped[id];
+                }
+                continue;
+            }
+            MappedFile file(files_[i]);
+            if (!file.valid()) {
+                ++skipped[id];
+                continue;
+            }
+            try {
+                merge(partial, metricName(files_[i]), file.data(), file.size());
+            } catch (const std::exception& e) {
+                ++skipped[id];
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned id = 1; id < threads_; ++id) {
+        workers.emplace_back(worker, id);
+    }
+    worker(0);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    for (unsigned id = 0; id < threads_; ++id) {
+        skipped_ += skipped[id];
+        for (auto& entry : partials[id]) {
+            Metric& metric = metrics_[entry.first];
+            metric.files += entry.second.files;
+            metric.sketch.merge(std::move(entry.second.sketch));
+        }
+    }
+    files_.clear();
+}
+
+const std::map<std::string, SketchQuery::Metric>& SketchQuery::getMetrics() const {
+    return metrics_;
+}
+
+uint64_t SketchQuery::getSkipped() const {
+    return skipped_;
+}
+
+void SketchQuery::writeCsv(std::ostream& os, const std::vector<double>& ranks,
+                           const std::vector<float>& split_points) const {
+    os << "metric,files,n,min,max";
+    for (double rank : ranks) os << ",q" << rank;
+    for (float point : split_points) os << ",cdf" << point;
+    os << "\n";
+
+    for (const auto& entry : metrics_) {
+        const sketch_type& sketch = entry.second.sketch;
+        os << entry.first << "," << entry.second.files << "," << sketch.get_n();
+        if (sketch.is_empty()) {
+            os << ",,";
+            for (size_t i = 0; i < ranks.size() + split_points.size(); ++i) os << ",";
+            os << "\n";
+            continue;
+        }
+        os << "," << sketch.get_min_item() << "," << sketch.get_max_item();
+        for (double rank : ranks) os << "," << sketch.get_quantile(rank);
+        if (!split_points.empty()) {
+            const auto cdf = sketch.get_CDF(split_points.data(), split_points.size());
+            for (size_t i = 0; i < split_points.size(); ++i) os << "," << cdf[i];
+        }
+        os << "\n";
+    }
+}
+
+/**
+ * @brief Escapes the characters of a metric name that are special in JSON
+ */
+static std::string jsonString(const std::string& value) {
+    std::string escaped = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) continue;
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+void SketchQuery::writeJson(std::ostream& os, const std::vector<double>& ranks,
+                            const std::vector<float>& split_points) const {
+    os << "{";
+    bool first = true;
+    for (const auto& entry : metrics_) {
+        const sketch_type& sketch = entry.second.sketch;
+        os << (first ? "\n" : ",\n") << "  " << jsonString(entry.first) << ": {\"files\": " << entry.second.files
+           << ", \"n\": " << sketch.get_n();
+        first = false;
+        if (!sketch.is_empty()) {
+            os << ", \"min\": " << sketch.get_min_item() << ", \"max\": " << sketch.get_max_item();
+            os << ", \"quantiles\": {";
+            for (size_t i = 0; i < ranks.size(); ++i) {
+                os << (i ? ", " : "") << "\"" << ranks[i] << "\": " << sketch.get_quantile(ranks[i]);
+            }
+            os << "}";
+            if (!split_points.empty()) {
+                const auto cdf = sketch.get_CDF(split_points.data(), split_points.size());
+                os << ", \"cdf\": {";
+                for (size_t i = 0; i < split_points.size(); ++i) {
+                    os << (i ? ", " : "") << "\"" << split_points[i] << "\": " << cdf[i];
+                }
+                os << "}";
+            }
+        }
+        os << "}";
+    }
+    os << "\n}\n";
+}
@@ -0,0 +1,146 @@
+/**
+ * @file storageaccounting.cpp
+ * @brief Implements the StorageAccounting class
+ */
+
+#include "storageaccounting.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+StorageAccounting& StorageAccounting::instance() {
+    static StorageAccounting* storage = new StorageAccounting();
+    return *storage;
+}
+
+StorageAccounting::StorageAccounting() : scans_(0) {}
+
+std::string StorageAccounting::normalize(const std::string& path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path.empty() ? fs::path(".") : fs::path(path), ec);
+    std::string normal = (ec ? fs::path(path) : absolute).lexically_normal().string();
+    while (normal.size() > 1 && normal.back() == '/') {
+        normal.pop_back();
+    }
+    return normal;
+}
+
+bool StorageAccounting::contains(const std::string& root, const std::string& path) {
+    if (root == "/") {
+        return path.size() > 1 && path[0] == '/';
+    }
+    return path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/';
+}
+
+bool StorageAccounting::tracked_locked(const std::string& path) const {
+    for (const auto& directory : directories_) {
+        if (contains(directory.first, path)) return true;
+    }
+    return false;
+}
+
+void StorageAccounting::set_size_locked(const std::string& path, uint64_t size) {
+    auto it = files_.find(path);
+    const uint64_t old_size = it == files_.end() ? 0 : it->second;
+    if (it == files_.end()) {
+        files_.emplace(path, size);
+    } else {
+        it->second = size;
+    }
+    for (auto& directory : directories_) {
+        if (contains(directory.first, path)) {
+            directory.second = directory.second + size - old_size;
+        }
+    }
+}
+
+/**
+ * @brief Scans a directory and counts it from the sizes on disk
+ *
+ * Files already known through another tracked directory take their size on
+ * disk, the directories containing them move by the difference.
+ */
+void StorageAccounting::scan_locked(const std::string& dir) {
+    ++scans_;
+    directories_[dir] = 0;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code file_ec;
+        if (!it->is_regular_file(file_ec)) continue;
+        const uint64_t size = it->file_size(file_ec);
+        if (file_ec) continue;
+        const std::string path = it->path().lexically_normal().string();
+        auto known = files_.find(path);
+        if (known != files_.end() && known->second != size) {
+            // also moves this directory, reset below
+            set_size_locked(path, size);
+        } else if (known == files_.end()) {
+            files_.emplace(path, size);
+        }
+        total += size;
+    }
+    directories_[dir] = total;
+}
+
+uint64_t StorageAccounting::usage(const std::string& dir) {
+    const std::string normal = normalize(dir);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = directories_.find(normal);
+    if (it != directories_.end()) {
+        return it->second;
+    }
+    scan_locked(normal);
+    return directories_[normal];
+}
+
+uint64_t StorageAccounting::rescan(const std::string& dir) {
+    const std::string normal = normalize(dir);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Forget the files below dir that are gone, then count what is on disk
+    for (auto it = files_.begin(); it != files_.end();) {
+        std::error_code ec;
+        if (contains(normal, it->first) && !fs::is_regular_file(it->first, ec)) {
+            for (auto& directory : directories_) {
+                if (contains(directory.first, it->first)) directory.second -= it->second;
+            }
+            it = files_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    scan_locked(normal);
+    return directories_[normal];
+}
+
+void StorageAccounting::fileWritten(const std::string& path) {
+    const std::string normal = normalize(path);
+    std::error_code ec;
+    const uint64_t size = fs::file_size(normal, ec);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ec) {
+        // The write failed or the file is already gone again
+        if (files_.count(normal)) {
+            set_size_locked(normal, 0);
+            files_.erase(normal);
+        }
+        return;
+    }
+    if (files_.count(normal) || tracked_locked(normal)) {
+        set_size_locked(normal, size);
+    }
+}
+
+void StorageAccounting::fileRemoved(const std::string& path) {
+    const std::string normal = normalize(path);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (files_.count(normal)) {
+        set_size_locked(normal, 0);
+        files_.erase(normal);
+    }
+}
+
+uint64_t StorageAccounting::get_scans() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return scans_;
+}
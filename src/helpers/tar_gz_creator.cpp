@@ -1,4 +1,5 @@
 #include "tar_gz_creator.h"
+#include "storageaccounting.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -11,6 +12,7 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -41,7 +43,8 @@ std::vector<std::string> TarGzCreator::collectFilesFromFolders(const std::vector
     for (const auto& folder : folders) {
         if (fs::exists(folder) && fs::is_directory(folder)) {
             for (const auto& entry : fs::recursive_directory_iterator(folder)) {
-                if (fs::is_regular_file(entry.path())) {
+                // Temporary files of an unfinished save are renamed into place later
+                if (fs::is_regular_file(entry.path()) && entry.path().extension() != ".tmp") {
                     collectedFiles.push_back(entry.path().string());
                 }
             }
@@ -80,28 +83,31 @@ bool TarGzCreator::createTar(const std::string& tarFilePath, const std::vector<s
     return true;
 }
 
+// Streams the tar through gzwrite in blocks instead of reading it whole
 bool TarGzCreator::compressToGz(const std::string& tarFilePath, const std::string& gzFilePath) {
-    std::ifstream tarFile(tarFilePath, std::ios::binary | std::ios::ate);
+    std::ifstream tarFile(tarFilePath, std::ios::binary);
     gzFile gzOutput = gzopen(gzFilePath.c_str(), "wb");
 
     if (!tarFile.is_open() || !gzOutput) {
         std::cerr << "compressToGz : " << tarFile.is_open() << " gzOutput: " << gzOutput << std::endl;
+        if (gzOutput) gzclose(gzOutput);
         return false;
     }
 
-    std::streamsize size = tarFile.tellg();
-    tarFile.seekg(0, std::ios::beg);
-    std::cout << "compressToGz : " << size << std::endl;
-
-    std::vector<char> buffer(size);
-    tarFile.read(buffer.data(), size);
-
-    gzwrite(gzOutput, buffer.data(), buffer.size());
+    std::vector<char> buffer(64 * 1024);
+    bool ok = true;
+    while (ok && tarFile) {
+        tarFile.read(buffer.data(), buffer.size());
+        const std::streamsize bytes = tarFile.gcount();
+        if (bytes > 0 && gzwrite(gzOutput, buffer.data(), static_cast<unsigned>(bytes)) != bytes) {
+            ok = false;
+        }
+    }
 
-    gzclose(gzOutput);
+    if (gzclose(gzOutput) != Z_OK) ok = false;
     tarFile.close();
 
-    return true;
+    return ok;
 }
 
 // Function to decompress a gz file
@@ -142,6 +148,7 @@ bool TarGzCreator::emptyFolder(const std::string& folderPath) {
             for (const auto& entry : fs::recursive_directory_iterator(folderPath)) {
                 if (fs::is_regular_file(entry.path())) {
                     fs::remove(entry.path());
+                    StorageAccounting::instance().fileRemoved(entry.path().string());
                 }
             }
         } else {
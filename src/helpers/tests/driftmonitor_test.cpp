@@ -0,0 +1,65 @@
+#include "driftmonitor.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+static distributionBox normalSketch(float mean, uint32_t seed, int n = 50000) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dist(mean, 1.0f);
+    distributionBox sketch;
+    for (int i = 0; i < n; ++i) sketch.update(dist(gen));
+    return sketch;
+}
+
+TEST(DriftMonitorTest, SameDistributionHasNoDrift) {
+    const distributionBox live = normalSketch(0.0f, 1);
+    const distributionBox baseline = normalSketch(0.0f, 2);
+    EXPECT_LT(DriftMetrics::computeKSDistance(live, baseline), 0.03);
+    EXPECT_LT(DriftMetrics::computePSI(live, baseline), 0.01);
+    EXPECT_LT(DriftMetrics::computeWasserstein(live, baseline), 0.05);
+}
+
+TEST(DriftMonitorTest, ShiftedDistributionDrifts) {
+    const distributionBox live = normalSketch(0.5f, 1);
+    const distributionBox baseline = normalSketch(0.0f, 2);
+    // KS of two unit normals 0.5 apart is 2 * Phi(0.25) - 1 = 0.197
+    EXPECT_NEAR(DriftMetrics::computeKSDistance(live, baseline), 0.197, 0.03);
+    // Wasserstein-1 of a shift is the shift
+    EXPECT_NEAR(DriftMetrics::computeWasserstein(live, baseline), 0.5, 0.05);
+    EXPECT_GT(DriftMetrics::computePSI(live, baseline), 0.1);
+    EXPECT_TRUE(std::isnan(DriftMetrics::computeKSDistance(distributionBox(), baseline)));
+}
+
+TEST(DriftMonitorTest, ScoresMetricsWithBaseline) {
+    const std::string dir = "/tmp/driftmonitor_test/";
+    fs::create_directories(dir);
+    {
+        std::ofstream os(dir + "brightness.bin", std::ios::binary);
+        normalSketch(0.0f, 2).serialize(os);
+    }
+
+    DriftMonitor monitor(dir, dir + "drift_report.csv");
+    EXPECT_TRUE(monitor.addMetric("brightness"));
+    EXPECT_FALSE(monitor.addMetric("noise"));
+    EXPECT_TRUE(std::isnan(monitor.getScores("brightness").ks));
+
+    monitor.update("brightness", normalSketch(1.0f, 1));
+    const DriftScores scores = monitor.getScores("brightness");
+    EXPECT_NEAR(scores.wasserstein, 1.0, 0.05);
+    EXPECT_GT(scores.ks, 0.3);
+
+    EXPECT_EQ(monitor.getReportPath(), dir + "drift_report.csv");
+    std::stringstream is;
+    monitor.writeReport(is);
+    std::string header, line;
+    std::getline(is, header);
+    std::getline(is, line);
+    EXPECT_EQ(header, "metric,n,ks,psi,wasserstein");
+    EXPECT_EQ(line.rfind("brightness,50000,", 0), 0u);
+    fs::remove_all(dir);
+}
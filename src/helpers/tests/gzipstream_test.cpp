@@ -0,0 +1,84 @@
+#include "gzipstream.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+class GzipStreamTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        fs::remove_all(root);
+        fs::create_directories(root);
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    // Larger than the blocks of the stream buffer, with some redundancy
+    static std::string sample() {
+        std::string data;
+        for (int i = 0; i < 20000; ++i) {
+            data += std::to_string(i % 97) + ',';
+        }
+        return data;
+    }
+
+    size_t writeCompressed(const std::string& path, const std::string& data, int level) {
+        std::ofstream file(path, std::ios::binary);
+        GzipStreambuf gzip(file, level);
+        std::ostream os(&gzip);
+        // Small writes like the field by field serialization of a sketch
+        for (size_t pos = 0; pos < data.size(); pos += 7) {
+            os.write(data.data() + pos, std::min<size_t>(7, data.size() - pos));
+        }
+        EXPECT_TRUE(gzip.finish());
+        file.close();
+        return fs::file_size(path);
+    }
+
+    const std::string root = "/tmp/gzipstream_test/";
+};
+
+TEST_F(GzipStreamTest, RoundTripsAtEveryLevel) {
+    const std::string data = sample();
+    size_t fastest = 0, smallest = 0;
+    for (int level : {1, 6, 9}) {
+        const std::string path = root + "level" + std::to_string(level) + ".gz";
+        const size_t size = writeCompressed(path, data, level);
+        EXPECT_LT(size, data.size() / 4);
+        if (level == 1) fastest = size;
+        if (level == 9) smallest = size;
+
+        std::vector<char> read;
+        ASSERT_TRUE(readGzipFile(path, read));
+        EXPECT_EQ(std::string(read.begin(), read.end()), data);
+    }
+    EXPECT_LE(smallest, fastest);
+}
+
+TEST_F(GzipStreamTest, WritesEmptyStream) {
+    const std::string path = root + "empty.gz";
+    EXPECT_GT(writeCompressed(path, "", 6), 0u);
+    std::vector<char> read(1);
+    EXPECT_TRUE(readGzipFile(path, read));
+    EXPECT_TRUE(read.empty());
+}
+
+TEST_F(GzipStreamTest, RejectsInvalidInput) {
+    std::ofstream sink(root + "unused.gz", std::ios::binary);
+    EXPECT_THROW(GzipStreambuf(sink, 42), std::runtime_error);
+
+    std::ofstream(root + "plain.bin", std::ios::binary) << "not compressed";
+    std::vector<char> read;
+    EXPECT_FALSE(readGzipFile(root + "plain.bin", read));
+    EXPECT_FALSE(readGzipFile(root + "missing.gz", read));
+
+    // A gzip file cut short misses its trailer
+    const std::string path = root + "cut.gz";
+    const size_t size = writeCompressed(path, sample(), 6);
+    fs::resize_file(path, size - 8);
+    EXPECT_FALSE(readGzipFile(path, read));
+}
@@ -43,6 +43,20 @@ TEST_F(ImageProcessingTest, calculateContrast) {
     EXPECT_GE(contrast, 0); // Contrast should not be negative
 }
 
+// Test calculateAverageHash function
+TEST_F(ImageProcessingTest, calculateAverageHash) {
+    cv::Mat halves(100, 100, CV_8UC1, cv::Scalar(0));
+    halves(cv::Rect(0, 0, 100, 50)).setTo(cv::Scalar(255));
+    // the top four thumbnail rows are brighter than the mean
+    EXPECT_EQ(calculateAverageHash(halves), 0xFFFFFFFF00000000ull);
+
+    cv::Mat noisy = halves.clone();
+    noisy.at<uchar>(70, 70) = 40;
+    EXPECT_EQ(calculateAverageHash(noisy), calculateAverageHash(halves));
+    EXPECT_EQ(calculateAverageHash(grayscaleImage), 0u); // flat image, no pixel above the mean
+    EXPECT_EQ(calculateAverageHash(cv::Mat()), 0u);
+}
+
 // Test saveImageWithIncrementalName function
 TEST_F(ImageProcessingTest, SaveImageWithIncrementalName) {
     std::string savedImagePath = saveImageWithIncrementalName(colorImage, testImagePath, testImageBaseName);
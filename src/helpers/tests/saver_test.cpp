@@ -1,21 +1,32 @@
 #include <gtest/gtest.h>
 #include "saver.h" // Include your Saver header
 #include <fstream>
+#include <sstream>
 #include <thread>
 #include <chrono>
 #include <vector>
 #include <algorithm>
 #include <kll_sketch.hpp>
+#include "sketcharena.h"
+#include "shardedsketch.h"
+#include "hllsketch.h"
+#include "countminsketch.h"
+#include "saverservice.h"
+#include "storageaccounting.h"
+#include "sketchbundle.h"
+#include "gzipstream.h"
 
-typedef datasketches::kll_sketch<float> distributionBox;
+typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> distributionBox;
 
 // Test class with common test utilities
 class SaverTest : public ::testing::Test {
 protected:
-    std::string testFilename = "test_save.dat"; // Name of the file to save
+    // In a directory of its own, the quota of the Saver applies to the whole directory
+    std::string testFilename = "/tmp/saver_test/test_save.dat"; // Name of the file to save
 
     void SetUp() override {
         // Clear the file before each test
+        fs::create_directories(fs::path(testFilename).parent_path());
         std::ofstream ofs(testFilename, std::ios::trunc);
         ofs.close();
     }
@@ -28,19 +39,24 @@ protected:
 
 TEST_F(SaverTest, AddObjectToSave) {
     Saver saver(5, "SaverTest"); // Save interval of 5 minutes
-    distributionBox noiseBox;
+    ShardedSketch noiseBox;
 
-    saver.AddObjectToSave((void*)(&noiseBox), KLL_TYPE, testFilename);
+    saver.AddObjectToSave(&noiseBox, testFilename);
     // Check if the object was added to the queue
     EXPECT_TRUE(!saver.objects_to_save_.empty());
+
+    // A plain sketch would be read by the service thread while it is updated
+    distributionBox plain;
+    EXPECT_THROW(saver.AddObjectToSave(&plain, testFilename), std::logic_error);
+    EXPECT_EQ(saver.objects_to_save_.size(), 1u);
 }
 
 TEST_F(SaverTest, StartSavingAndTriggerSave) {
     Saver saver(5, "SaverTest"); // Save interval of 5 minutes
-    distributionBox noiseBox;
+    ShardedSketch noiseBox;
 
     saver.StartSaving(); // Start the save loop
-    saver.AddObjectToSave((void*)(&noiseBox), KLL_TYPE, testFilename);
+    saver.AddObjectToSave(&noiseBox, testFilename);
     
     // Trigger save manually
     saver.TriggerSave();
@@ -57,3 +73,498 @@ TEST_F(SaverTest, StartSavingAndTriggerSave) {
 //    EXPECT_EQ(u.get_min_item(), "42");
 }
 
+TEST_F(SaverTest, ObjectVersionFollowsUpdates) {
+    ShardedSketch sharded;
+    distributionBox plain;
+    cv::Mat image;
+    std::unique_ptr<Serializable> sharded_object = make_serializable(&sharded);
+    std::unique_ptr<Serializable> plain_object = make_serializable(&plain);
+    std::unique_ptr<Serializable> image_object = make_serializable(&image, ".png");
+
+    uint64_t before = 0, after = 0;
+    ASSERT_TRUE(sharded_object->get_version(before));
+    sharded.update(1.0f);
+    ASSERT_TRUE(sharded_object->get_version(after));
+    EXPECT_NE(before, after);
+
+    ASSERT_TRUE(plain_object->get_version(before));
+    plain.update(1.0f);
+    ASSERT_TRUE(plain_object->get_version(after));
+    EXPECT_NE(before, after);
+
+    // Images are written once and never versioned
+    EXPECT_FALSE(image_object->get_version(before));
+    EXPECT_TRUE(image_object->is_one_shot());
+    EXPECT_TRUE(plain_object->is_drift_metric());
+    EXPECT_TRUE(sharded_object->is_snapshot_safe());
+    EXPECT_TRUE(image_object->is_snapshot_safe());
+    EXPECT_FALSE(plain_object->is_snapshot_safe());
+}
+
+TEST_F(SaverTest, SkipsUnchangedObjects) {
+    const std::string dir = "/tmp/saver_dirty_test/";
+    fs::create_directories(dir);
+    ShardedSketch updated, idle;
+    {
+        Saver saver(1, "SaverTest");
+        saver.AddObjectToSave(&updated, dir + "updated.bin");
+        saver.AddObjectToSave(&idle, dir + "idle.bin");
+        saver.StartSaving();
+        for (int i = 0; i < 3; ++i) {
+            updated.update(static_cast<float>(i));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        }
+        saver.StopSaving();
+
+        save_stats_t stats = saver.GetSaveStats();
+        ASSERT_GE(stats.cycles, 2u);
+        EXPECT_EQ(stats.written + stats.skipped + stats.failed, 2 * stats.cycles);
+        // The idle sketch is only written by the first cycle
+        EXPECT_GE(stats.skipped, stats.cycles - 1);
+        EXPECT_GE(stats.written, 2u);
+    }
+
+    std::ifstream is(dir + "updated.bin");
+    EXPECT_GE(distributionBox::deserialize(is).get_n(), 2u);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, SavesRelativeErrorSketch) {
+    const std::string dir = "/tmp/saver_req_test/";
+    fs::create_directories(dir);
+    ShardedReqSketch sketch;
+    std::unique_ptr<Serializable> object = make_serializable(&sketch);
+    uint64_t before = 0, after = 0;
+    ASSERT_TRUE(object->get_version(before));
+    for (int i = 0; i < 10000; ++i) {
+        sketch.update(static_cast<float>(i));
+    }
+    ASSERT_TRUE(object->get_version(after));
+    EXPECT_NE(before, after);
+    {
+        Saver saver(1, "SaverTest");
+        saver.AddObjectToSave(&sketch, dir + "latency.bin");
+        saver.StartSaving();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        saver.StopSaving();
+    }
+
+    std::ifstream is(dir + "latency.bin");
+    ReqSketch loaded = ReqSketch::deserialize(is);
+    EXPECT_EQ(loaded.get_n(), 10000u);
+    EXPECT_EQ(loaded.get_max_item(), 9999.0f);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, SavesDistinctCountSketch) {
+    const std::string dir = "/tmp/saver_hll_test/";
+    fs::create_directories(dir);
+    HllSketch sketch;
+    std::unique_ptr<Serializable> object = make_serializable(&sketch);
+    uint64_t before = 0, after = 0;
+    for (uint64_t id = 0; id < 500; ++id) {
+        sketch.update(id);
+    }
+    ASSERT_TRUE(object->get_version(before));
+    // Tracks seen again do not make the sketch dirty
+    for (uint64_t id = 0; id < 500; ++id) {
+        sketch.update(id);
+    }
+    ASSERT_TRUE(object->get_version(after));
+    EXPECT_EQ(before, after);
+    {
+        Saver saver(1, "SaverTest");
+        saver.AddObjectToSave(&sketch, dir + "distinct_tracks.bin");
+        saver.StartSaving();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        saver.StopSaving();
+    }
+
+    std::ifstream is(dir + "distinct_tracks.bin");
+    HllSketch loaded = HllSketch::deserialize(is);
+    EXPECT_NEAR(loaded.get_estimate(), 500, 25);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, SavesClassPairSketch) {
+    const std::string dir = "/tmp/saver_cms_test/";
+    fs::create_directories(dir);
+    CountMinSketch sketch(256, 4);
+    for (int i = 0; i < 100; ++i) {
+        sketch.update(CountMinSketch::pair_key(i % 3, 7));
+    }
+    {
+        Saver saver(1, "SaverTest");
+        saver.AddObjectToSave(&sketch, dir + "confusion_pairs.bin");
+        saver.StartSaving();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+        saver.StopSaving();
+    }
+
+    std::ifstream is(dir + "confusion_pairs.bin");
+    CountMinSketch loaded = CountMinSketch::deserialize(is);
+    EXPECT_EQ(loaded.get_total_weight(), 100u);
+    EXPECT_EQ(loaded.get_heavy_hitters().size(), 3u);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, ReplacesFilesOnlyOnCommit) {
+    const std::string dir = "/tmp/saver_atomic_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        std::ofstream os(dir + "noise.bin");
+        os << "previous cycle";
+    }
+    distributionBox sketch;
+    sketch.update(1.0f);
+    data_object_t object;
+    object.filename = dir + "noise.bin";
+    object.obj = make_serializable(&sketch);
+    object.max_size = 0;
+    object.saved_version = 0;
+    object.saved = false;
+    Saver saver(1, "SaverTest");
+
+    // A write refused by the quota leaves the previous file untouched
+    EXPECT_FALSE(saver.SaveObjectToFile(&object, 1));
+    EXPECT_FALSE(fs::exists(dir + "noise.bin.tmp"));
+    EXPECT_EQ(fs::file_size(dir + "noise.bin"), 14u);
+
+    object.max_size = 1024;
+    ASSERT_TRUE(saver.SaveObjectToFile(&object, 1));
+    EXPECT_TRUE(fs::exists(dir + "noise.bin.tmp"));
+    EXPECT_EQ(fs::file_size(dir + "noise.bin"), 14u);
+    EXPECT_FALSE(object.saved);
+
+    uint64_t written = 0, failed = 0;
+    saver.CommitPendingWrites(written, failed);
+    EXPECT_EQ(written, 1u);
+    EXPECT_EQ(failed, 0u);
+    EXPECT_TRUE(object.saved);
+    EXPECT_EQ(object.saved_version, 1u);
+    EXPECT_TRUE(saver.cycle_locks_.empty());
+    EXPECT_FALSE(fs::exists(dir + "noise.bin.tmp"));
+
+    std::ifstream is(dir + "noise.bin");
+    EXPECT_EQ(distributionBox::deserialize(is).get_n(), 1u);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, CommitsDriftReportWithTheCycle) {
+    const std::string dir = "/tmp/saver_drift_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir + "baseline/");
+    ShardedSketch brightness;
+    {
+        distributionBox baseline;
+        for (int i = 0; i < 100; ++i) baseline.update(static_cast<float>(i));
+        std::ofstream os(dir + "baseline/brightness.bin", std::ios::binary);
+        baseline.serialize(os);
+    }
+    brightness.update(1.0f);
+    Saver saver(1, "SaverTest");
+    saver.EnableDriftMonitor(dir + "baseline/", dir + "drift_report.csv");
+    saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+    saver.RunSaveCycle();
+
+    EXPECT_EQ(saver.GetSaveStats().written, 1u);
+    EXPECT_FALSE(fs::exists(dir + "drift_report.csv.tmp"));
+    EXPECT_TRUE(saver.cycle_locks_.empty());
+    std::ifstream is(dir + "drift_report.csv");
+    std::string header, line;
+    std::getline(is, header);
+    std::getline(is, line);
+    EXPECT_EQ(header, "metric,n,ks,psi,wasserstein");
+    EXPECT_EQ(line.rfind("brightness,1,", 0), 0u);
+    // The report counts against the quota of the directory like the sketches
+    EXPECT_EQ(StorageAccounting::instance().usage(dir),
+              fs::file_size(dir + "brightness.bin") + fs::file_size(dir + "drift_report.csv") +
+              fs::file_size(dir + "baseline/brightness.bin"));
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, WritesObjectsIntoOneBundle) {
+    const std::string dir = "/tmp/saver_bundle_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    ShardedSketch brightness;
+    HllSketch ids;
+    brightness.update(1.0f);
+    ids.update(uint64_t(1));
+    Saver saver(1, "SaverTest");
+    saver.EnableBundle(dir + "stats.bundle");
+    saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+    saver.AddObjectToSave(&ids, dir + "ids.bin");
+
+    saver.RunSaveCycle();
+    EXPECT_EQ(saver.GetSaveStats().written, 2u);
+    EXPECT_FALSE(fs::exists(dir + "brightness.bin"));
+    EXPECT_FALSE(fs::exists(dir + "stats.bundle.tmp"));
+
+    // Only the KLL sketch changed, the HLL sketch is bundled from its last buffer;
+    // a flush writes it before its interval passed
+    brightness.update(2.0f);
+    saver.RunSaveCycle(true);
+    EXPECT_EQ(saver.GetSaveStats().written, 3u);
+    EXPECT_EQ(saver.GetSaveStats().skipped, 1u);
+
+    SketchBundle bundle(dir + "stats.bundle");
+    ASSERT_TRUE(bundle.valid());
+    ASSERT_EQ(bundle.entries().size(), 2u);
+    const SketchBundle::Entry* entry = bundle.find("brightness");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->type, BUNDLE_KLL);
+    EXPECT_TRUE(bundle.verify(*entry));
+    EXPECT_EQ(distributionBox::deserialize(bundle.data(*entry), entry->length).get_n(), 2u);
+    entry = bundle.find("ids");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->type, BUNDLE_HLL);
+    std::stringstream ss(std::string(bundle.data(*entry), entry->length));
+    EXPECT_NEAR(HllSketch::deserialize(ss).get_estimate(), 1, 0.5);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, CompressesFilesAndBundles) {
+    const std::string dir = "/tmp/saver_compression_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir + "bundle/");
+    ShardedSketch brightness;
+    for (int i = 0; i < 10000; ++i) brightness.update(static_cast<float>(i % 100));
+    Saver saver(1, "SaverTest");
+    EXPECT_THROW(saver.EnableCompression(0), std::invalid_argument);
+    saver.EnableCompression(6);
+    saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+    saver.RunSaveCycle();
+
+    EXPECT_FALSE(fs::exists(dir + "brightness.bin"));
+    ASSERT_TRUE(fs::exists(dir + "brightness.bin.gz"));
+    EXPECT_LT(fs::file_size(dir + "brightness.bin.gz"), brightness.get_merged().get_serialized_size_bytes());
+    std::vector<char> data;
+    ASSERT_TRUE(readGzipFile(dir + "brightness.bin.gz", data));
+    EXPECT_EQ(distributionBox::deserialize(data.data(), data.size()).get_n(), 10000u);
+
+    Saver bundled(1, "SaverTest");
+    bundled.EnableCompression(9);
+    bundled.EnableBundle(dir + "bundle/stats.bundle");
+    bundled.AddObjectToSave(&brightness, dir + "bundle/brightness.bin");
+    bundled.RunSaveCycle();
+    ASSERT_TRUE(readGzipFile(dir + "bundle/stats.bundle.gz", data));
+    std::vector<SketchBundle::Entry> entries;
+    ASSERT_TRUE(SketchBundle::parse(data.data(), data.size(), entries));
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].name, "brightness");
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, RestoresObjectsFromLastRun) {
+    const std::string dir = "/tmp/saver_restore_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        ShardedSketch brightness;
+        HllSketch ids;
+        ShardedSketch sharded;
+        for (int i = 0; i < 100; ++i) {
+            brightness.update(static_cast<float>(i));
+            ids.update(static_cast<uint64_t>(i));
+            sharded.update(static_cast<float>(i));
+        }
+        Saver saver(1, "SaverTest");
+        saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+        saver.AddObjectToSave(&ids, dir + "ids.bin");
+        saver.AddObjectToSave(&sharded, dir + "sharded.bin");
+        saver.RunSaveCycle();
+    }
+    // A snapshot with trailing bytes is rejected like a foreign file
+    {
+        std::ofstream os(dir + "ids.bin", std::ios::binary | std::ios::app);
+        os << "garbage";
+    }
+
+    ShardedSketch brightness;
+    HllSketch ids;
+    ShardedSketch sharded;
+    brightness.update(1000.0f);
+    Saver saver(1, "SaverTest");
+    saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+    saver.AddObjectToSave(&ids, dir + "ids.bin");
+    saver.EnableRestore();
+    EXPECT_EQ(brightness.get_merged().get_n(), 101u);
+    EXPECT_EQ(brightness.get_merged().get_max_item(), 1000.0f);
+    EXPECT_EQ(ids.get_estimate(), 0);
+
+    // Objects created after the start are restored when they are added
+    saver.AddObjectToSave(&sharded, dir + "sharded.bin");
+    EXPECT_EQ(sharded.get_merged().get_n(), 100u);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, RestoresCompressedBundle) {
+    const std::string dir = "/tmp/saver_restore_bundle_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    {
+        ShardedSketch brightness, noise;
+        brightness.update(1.0f);
+        noise.update(2.0f);
+        noise.update(3.0f);
+        Saver saver(1, "SaverTest");
+        saver.EnableBundle(dir + "stats.bundle");
+        saver.EnableCompression(1);
+        saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+        saver.AddObjectToSave(&noise, dir + "noise.bin");
+        saver.RunSaveCycle();
+    }
+
+    ShardedSketch brightness, noise;
+    Saver saver(1, "SaverTest");
+    saver.EnableBundle(dir + "stats.bundle");
+    saver.EnableCompression(1);
+    saver.AddObjectToSave(&brightness, dir + "brightness.bin");
+    saver.EnableRestore();
+    EXPECT_EQ(brightness.get_merged().get_n(), 1u);
+    EXPECT_EQ(saver.restore_pending_.count("noise"), 1u);
+
+    // The entry of the object not created yet stays in the new bundle
+    brightness.update(4.0f);
+    saver.RunSaveCycle();
+    SketchBundle bundle(dir + "stats.bundle.gz");
+    ASSERT_TRUE(bundle.valid());
+    ASSERT_NE(bundle.find("noise"), nullptr);
+    EXPECT_TRUE(bundle.verify(*bundle.find("noise")));
+
+    saver.AddObjectToSave(&noise, dir + "noise.bin");
+    EXPECT_EQ(noise.get_merged().get_n(), 2u);
+    EXPECT_TRUE(saver.restore_pending_.empty());
+    EXPECT_EQ(saver.restore_bundle_, nullptr);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, ConfiguresFromProfileSection) {
+    std::map<std::string, std::vector<std::string>> config = {
+        {"bundle", {"stats.bundle"}}, {"compression", {"6"}},
+        {"save_intervals", {"hot:50"}}, {"fresh_start", {"true"}}, {"BRIGHTNESS", {"0", "1"}}};
+    Saver saver(60, "SaverTest");
+    saver.Configure(config, "/tmp/saver_configure_test/");
+    EXPECT_EQ(saver.bundle_path_, "/tmp/saver_configure_test/stats.bundle");
+    EXPECT_EQ(saver.compression_level_, 6);
+    EXPECT_EQ(saver.metric_intervals_.at("hot"), std::chrono::milliseconds(50));
+    EXPECT_FALSE(saver.restore_on_start_);
+    // Only the keys of the profile itself are left
+    ASSERT_EQ(config.size(), 1u);
+    EXPECT_EQ(config.begin()->first, "BRIGHTNESS");
+
+    std::map<std::string, std::vector<std::string>> restoring;
+    Saver restored(60, "SaverTest");
+    restored.Configure(restoring, "/tmp/saver_configure_test/");
+    EXPECT_TRUE(restored.restore_on_start_);
+    EXPECT_TRUE(restoring.empty());
+}
+
+TEST_F(SaverTest, IgnoresMalformedProfileSettings) {
+    std::map<std::string, std::vector<std::string>> config = {
+        {"compression", {"fast"}}, {"save_intervals", {"hot:fast", "cold:60000"}}};
+    Saver saver(60, "SaverTest");
+    EXPECT_NO_THROW(saver.Configure(config, "/tmp/saver_configure_test/"));
+    EXPECT_EQ(saver.compression_level_, 0);
+    EXPECT_EQ(saver.metric_intervals_.count("hot"), 0u);
+    EXPECT_EQ(saver.metric_intervals_.at("cold"), std::chrono::milliseconds(60000));
+
+    std::map<std::string, std::vector<std::string>> out_of_range = {{"compression", {"12"}}};
+    EXPECT_NO_THROW(saver.Configure(out_of_range, "/tmp/saver_configure_test/"));
+    EXPECT_EQ(saver.compression_level_, 0);
+}
+
+TEST_F(SaverTest, WritesObjectsAtTheirOwnInterval) {
+    const std::string dir = "/tmp/saver_interval_test/";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    HllSketch hot, cold;
+    Saver saver(60, "SaverTest");
+    EXPECT_THROW(saver.SetSaveIntervals({"hot"}), std::invalid_argument);
+    EXPECT_THROW(saver.SetSaveIntervals({"hot:fast"}), std::invalid_argument);
+    EXPECT_THROW(saver.SetSaveInterval("hot", std::chrono::milliseconds(0)), std::invalid_argument);
+    EXPECT_THROW(saver.SetSaveIntervals({"hot:0"}), std::invalid_argument);
+    EXPECT_THROW(saver.SetSaveIntervals({"hot:-50"}), std::invalid_argument);
+    EXPECT_TRUE(saver.metric_intervals_.empty());
+    EXPECT_THROW(Saver(0, "SaverTest"), std::invalid_argument);
+    EXPECT_THROW(Saver(-1, "SaverTest"), std::invalid_argument);
+    saver.SetSaveIntervals({"hot:50"});
+    saver.AddObjectToSave(&hot, dir + "hot.bin");
+    saver.AddObjectToSave(&cold, dir + "cold.bin");
+    EXPECT_EQ(saver.CycleInterval(), std::chrono::milliseconds(50));
+
+    saver.RunSaveCycle();
+    EXPECT_EQ(saver.GetSaveStats().written, 2u);
+    hot.update(uint64_t(1));
+    cold.update(uint64_t(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    saver.RunSaveCycle();
+    EXPECT_EQ(saver.GetSaveStats().written, 3u);
+
+    // The cold object is not due for a minute, stopping writes it anyway
+    saver.StartSaving();
+    const auto start = std::chrono::steady_clock::now();
+    saver.StopSaving();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+    EXPECT_FALSE(SaverService::instance().isRegistered(&saver));
+    std::ifstream is(dir + "cold.bin", std::ios::binary);
+    EXPECT_NEAR(HllSketch::deserialize(is).get_estimate(), 1, 0.5);
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, ServiceRunsRegisteredSavers) {
+    const std::string dir = "/tmp/saver_service_test/";
+    fs::create_directories(dir);
+    HllSketch first_sketch, second_sketch;
+    Saver first(1, "SaverTest"), second(1, "SaverTest");
+    first.AddObjectToSave(&first_sketch, dir + "first.bin");
+    second.AddObjectToSave(&second_sketch, dir + "second.bin");
+    first.StartSaving();
+    second.StartSaving();
+    EXPECT_TRUE(SaverService::instance().isRegistered(&first));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    EXPECT_GE(first.GetSaveStats().cycles, 2u);
+    EXPECT_GE(second.GetSaveStats().cycles, 2u);
+
+    // A stopped saver is out of the schedule, the other one keeps saving
+    first.StopSaving();
+    EXPECT_FALSE(SaverService::instance().isRegistered(&first));
+    const uint64_t first_cycles = first.GetSaveStats().cycles;
+    const uint64_t second_cycles = second.GetSaveStats().cycles;
+    second.TriggerSave();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(first.GetSaveStats().cycles, first_cycles);
+    EXPECT_GT(second.GetSaveStats().cycles, second_cycles);
+    second.StopSaving();
+    EXPECT_TRUE(fs::exists(dir + "first.bin"));
+    EXPECT_TRUE(fs::exists(dir + "second.bin"));
+    fs::remove_all(dir);
+}
+
+TEST_F(SaverTest, ReusesSerializationBuffer) {
+    distributionBox kll;
+    for (int i = 0; i < 1000; ++i) kll.update(static_cast<float>(i));
+    std::unique_ptr<Serializable> object = make_serializable(&kll);
+    std::vector<char> buffer(object->get_serialized_size_bytes());
+    const char *data = buffer.data();
+    EXPECT_EQ(object->serialize(buffer, nullptr, "kll"), kll.get_serialized_size_bytes());
+    EXPECT_EQ(buffer.data(), data);
+
+    // Without a size query the buffer grows once, then fits every later save
+    HllSketch hll;
+    for (uint64_t id = 0; id < 100; ++id) hll.update(id);
+    std::unique_ptr<Serializable> counter = make_serializable(&hll);
+    EXPECT_EQ(counter->get_serialized_size_bytes(), 0u);
+    std::vector<char> counter_buffer;
+    const size_t size = counter->serialize(counter_buffer, nullptr, "hll");
+    EXPECT_EQ(counter->get_serialized_size_bytes(), size);
+    data = counter_buffer.data();
+    hll.update(uint64_t(1000));
+    EXPECT_EQ(counter->serialize(counter_buffer, nullptr, "hll"), size);
+    EXPECT_EQ(counter_buffer.data(), data);
+
+    std::stringstream ss(std::string(counter_buffer.data(), size));
+    EXPECT_NEAR(HllSketch::deserialize(ss).get_estimate(), 101, 5);
+}
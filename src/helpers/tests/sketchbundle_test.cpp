@@ -0,0 +1,98 @@
+#include "sketchbundle.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+class SketchBundleTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        fs::remove_all(root);
+        fs::create_directories(root);
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    std::string writeBundle(const SketchBundleWriter& writer) {
+        const std::string path = root + "stats.bundle";
+        std::ofstream file(path, std::ios::binary);
+        writer.write(file);
+        return path;
+    }
+
+    static std::string read(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    }
+
+    const std::string root = "/tmp/sketchbundle_test/";
+};
+
+TEST_F(SketchBundleTest, RoundTripsEntries) {
+    const std::string brightness(100, 'b');
+    const std::string classes = "frequent items";
+    SketchBundleWriter writer;
+    writer.add("brightness", BUNDLE_KLL, brightness.data(), brightness.size());
+    writer.add("classes", BUNDLE_FREQUENT_ITEMS, classes.data(), classes.size());
+    writer.add("empty", BUNDLE_HLL, nullptr, 0);
+    EXPECT_EQ(writer.get_num_entries(), 3u);
+
+    const std::string path = writeBundle(writer);
+    EXPECT_EQ(fs::file_size(path), writer.get_size_bytes());
+
+    SketchBundle bundle(path);
+    ASSERT_TRUE(bundle.valid());
+    ASSERT_EQ(bundle.entries().size(), 3u);
+    const SketchBundle::Entry* entry = bundle.find("classes");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->type, BUNDLE_FREQUENT_ITEMS);
+    EXPECT_EQ(std::string(bundle.data(*entry), entry->length), classes);
+    EXPECT_TRUE(bundle.verify(*entry));
+    entry = bundle.find("brightness");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(std::string(bundle.data(*entry), entry->length), brightness);
+    EXPECT_EQ(bundle.find("empty")->length, 0u);
+    EXPECT_EQ(bundle.find("missing"), nullptr);
+
+    writer.clear();
+    EXPECT_EQ(writer.get_num_entries(), 0u);
+    EXPECT_EQ(writer.get_size_bytes(), SketchBundle::HEADER_SIZE);
+}
+
+TEST_F(SketchBundleTest, DetectsCorruptedPayload) {
+    const std::string payload(64, 'x');
+    SketchBundleWriter writer;
+    writer.add("latency", BUNDLE_LATENCY_HISTOGRAM, payload.data(), payload.size());
+    std::string bytes = read(writeBundle(writer));
+    bytes[bytes.size() - 1] = 'y';
+    std::ofstream(root + "stats.bundle", std::ios::binary) << bytes;
+
+    SketchBundle bundle(root + "stats.bundle");
+    ASSERT_TRUE(bundle.valid());
+    EXPECT_FALSE(bundle.verify(bundle.entries()[0]));
+}
+
+TEST_F(SketchBundleTest, RejectsTruncatedAndForeignFiles) {
+    const std::string payload(64, 'x');
+    SketchBundleWriter writer;
+    writer.add("latency", BUNDLE_LATENCY_HISTOGRAM, payload.data(), payload.size());
+    const std::string bytes = read(writeBundle(writer));
+
+    std::vector<SketchBundle::Entry> entries;
+    EXPECT_TRUE(SketchBundle::parse(bytes.data(), bytes.size(), entries));
+    for (size_t size : {size_t(0), size_t(8), SketchBundle::HEADER_SIZE + 4, bytes.size() - 1}) {
+        EXPECT_FALSE(SketchBundle::parse(bytes.data(), size, entries)) << size;
+        EXPECT_TRUE(entries.empty());
+    }
+    std::string foreign = bytes;
+    foreign[1] = 0x0F;
+    EXPECT_FALSE(SketchBundle::parse(foreign.data(), foreign.size(), entries));
+
+    EXPECT_FALSE(SketchBundle(root + "missing.bundle").valid());
+}
@@ -0,0 +1,133 @@
+#include "sketchquery.h"
+#include "sketchbundle.h"
+#include "gzipstream.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+class SketchQueryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        fs::remove_all(root);
+        // Two devices uploading the same metrics
+        for (int device = 0; device < 2; ++device) {
+            const std::string dir = root + "device" + std::to_string(device) + "/";
+            fs::create_directories(dir);
+            SketchQuery::sketch_type brightness;
+            for (int i = 0; i < 1000; ++i) {
+                brightness.update(static_cast<float>(device * 1000 + i));
+            }
+            std::ofstream(dir + "brightness.bin", std::ios::binary) << serialized(brightness);
+            std::ofstream(dir + "noise.bin", std::ios::binary) << serialized(SketchQuery::sketch_type());
+        }
+        std::ofstream(root + "device0/latency.bin", std::ios::binary) << "not a sketch";
+        std::ofstream(root + "device0/notes.txt") << "ignored";
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    static std::string serialized(const SketchQuery::sketch_type& sketch) {
+        std::stringstream ss;
+        sketch.serialize(ss);
+        return ss.str();
+    }
+
+    const std::string root = "/tmp/sketchquery_test/";
+};
+
+TEST_F(SketchQueryTest, MergesFilesByMetric) {
+    SketchQuery query(3);
+    EXPECT_EQ(query.addPath(root), 5u);
+    query.run();
+
+    const auto& metrics = query.getMetrics();
+    ASSERT_EQ(metrics.size(), 2u);
+    const auto& brightness = metrics.at("brightness");
+    EXPECT_EQ(brightness.files, 2u);
+    EXPECT_EQ(brightness.sketch.get_n(), 2000u);
+    EXPECT_EQ(brightness.sketch.get_min_item(), 0.0f);
+    EXPECT_EQ(brightness.sketch.get_max_item(), 1999.0f);
+    EXPECT_NEAR(brightness.sketch.get_quantile(0.5), 1000.0f, 40.0f);
+    EXPECT_EQ(metrics.at("noise").files, 2u);
+    EXPECT_TRUE(metrics.at("noise").sketch.is_empty());
+    EXPECT_EQ(query.getSkipped(), 1u);
+}
+
+TEST_F(SketchQueryTest, WritesCsvAndJson) {
+    SketchQuery query(1);
+    query.addPath(root + "device1");
+    query.run();
+
+    std::stringstream csv;
+    query.writeCsv(csv, {0.5}, {500.0f});
+    std::string header, brightness, noise;
+    std::getline(csv, header);
+    std::getline(csv, brightness);
+    std::getline(csv, noise);
+    EXPECT_EQ(header, "metric,files,n,min,max,q0.5,cdf500");
+    EXPECT_EQ(brightness.rfind("brightness,1,1000,1000,1999,", 0), 0u);
+    EXPECT_EQ(noise, "noise,1,0,,,,");
+
+    std::stringstream json;
+    query.writeJson(json, {0.5}, {});
+    EXPECT_NE(json.str().find("\"brightness\": {\"files\": 1, \"n\": 1000, \"min\": 1000, \"max\": 1999"), std::string::npos);
+    EXPECT_NE(json.str().find("\"noise\": {\"files\": 1, \"n\": 0}"), std::string::npos);
+}
+
+TEST_F(SketchQueryTest, MergesBundleEntries) {
+    SketchQuery::sketch_type brightness;
+    for (int i = 0; i < 1000; ++i) {
+        brightness.update(static_cast<float>(2000 + i));
+    }
+    const std::string kll = serialized(brightness);
+    const std::string other = "frequent items";
+    SketchBundleWriter writer;
+    writer.add("brightness", BUNDLE_KLL, kll.data(), kll.size());
+    writer.add("classes", BUNDLE_FREQUENT_ITEMS, other.data(), other.size());
+    {
+        std::ofstream file(root + "device2.bundle", std::ios::binary);
+        writer.write(file);
+    }
+
+    SketchQuery query(2);
+    EXPECT_EQ(query.addPath(root), 6u);
+    query.run();
+    const auto& metrics = query.getMetrics();
+    ASSERT_EQ(metrics.size(), 2u);
+    EXPECT_EQ(metrics.at("brightness").files, 3u);
+    EXPECT_EQ(metrics.at("brightness").sketch.get_n(), 3000u);
+    EXPECT_EQ(metrics.at("brightness").sketch.get_max_item(), 2999.0f);
+    EXPECT_EQ(query.getSkipped(), 1u);
+}
+
+TEST_F(SketchQueryTest, MergesCompressedFiles) {
+    SketchQuery::sketch_type brightness;
+    for (int i = 0; i < 1000; ++i) {
+        brightness.update(static_cast<float>(2000 + i));
+    }
+    fs::create_directories(root + "device2");
+    {
+        std::ofstream file(root + "device2/brightness.bin.gz", std::ios::binary);
+        GzipStreambuf gzip(file, 1);
+        std::ostream os(&gzip);
+        os << serialized(brightness);
+        ASSERT_TRUE(gzip.finish());
+    }
+    std::ofstream(root + "device2/noise.bin.gz", std::ios::binary) << "not gzip";
+
+    EXPECT_EQ(SketchQuery::metricName(root + "device2/brightness.bin.gz"), "brightness");
+    SketchQuery query(2);
+    EXPECT_EQ(query.addPath(root), 7u);
+    query.run();
+    const auto& metrics = query.getMetrics();
+    EXPECT_EQ(metrics.at("brightness").files, 3u);
+    EXPECT_EQ(metrics.at("brightness").sketch.get_n(), 3000u);
+    EXPECT_EQ(metrics.at("brightness").sketch.get_max_item(), 2999.0f);
+    // The not a sketch file and the broken gzip file
+    EXPECT_EQ(query.getSkipped(), 2u);
+}
@@ -0,0 +1,83 @@
+#include "storageaccounting.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+class StorageAccountingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root = "/tmp/storage_accounting_test_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name());
+        fs::remove_all(root);
+        fs::create_directories(root + "/stats");
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    void writeFile(const std::string& path, size_t bytes) {
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        os << std::string(bytes, 'x');
+    }
+
+    std::string root;
+};
+
+TEST_F(StorageAccountingTest, ScansOnceThenTracksWrites) {
+    StorageAccounting& storage = StorageAccounting::instance();
+    writeFile(root + "/stats/a.bin", 100);
+    writeFile(root + "/stats/b.bin", 50);
+
+    const uint64_t scans = storage.get_scans();
+    EXPECT_EQ(storage.usage(root + "/stats/"), 150u);
+    EXPECT_EQ(storage.get_scans(), scans + 1);
+
+    // a rewrite only adds the difference, a new file its size
+    writeFile(root + "/stats/a.bin", 40);
+    storage.fileWritten(root + "/stats/a.bin");
+    writeFile(root + "/stats/c.bin", 10);
+    storage.fileWritten(root + "/stats/c.bin");
+    EXPECT_EQ(storage.usage(root + "/stats"), 100u);
+
+    fs::remove(root + "/stats/b.bin");
+    storage.fileRemoved(root + "/stats/b.bin");
+    EXPECT_EQ(storage.usage(root + "/stats"), 50u);
+    EXPECT_EQ(storage.get_scans(), scans + 1);
+}
+
+TEST_F(StorageAccountingTest, NestedDirectoriesShareFiles) {
+    StorageAccounting& storage = StorageAccounting::instance();
+    writeFile(root + "/top.bin", 7);
+    writeFile(root + "/stats/a.bin", 20);
+    EXPECT_EQ(storage.usage(root + "/stats"), 20u);
+    EXPECT_EQ(storage.usage(root), 27u);
+
+    writeFile(root + "/stats/a.bin", 30);
+    storage.fileWritten(root + "/stats/a.bin");
+    EXPECT_EQ(storage.usage(root + "/stats"), 30u);
+    EXPECT_EQ(storage.usage(root), 37u);
+
+    // files outside every tracked directory are not counted
+    fs::create_directories(root + "_other");
+    writeFile(root + "_other/x.bin", 5);
+    storage.fileWritten(root + "_other/x.bin");
+    EXPECT_EQ(storage.usage(root), 37u);
+    fs::remove_all(root + "_other");
+}
+
+TEST_F(StorageAccountingTest, RescanPicksUpForeignChanges) {
+    StorageAccounting& storage = StorageAccounting::instance();
+    EXPECT_EQ(storage.usage(root + "/missing"), 0u);
+    writeFile(root + "/stats/a.bin", 10);
+    EXPECT_EQ(storage.usage(root + "/stats"), 10u);
+
+    // changed behind the back of the accounting
+    fs::remove(root + "/stats/a.bin");
+    writeFile(root + "/stats/b.bin", 25);
+    EXPECT_EQ(storage.usage(root + "/stats"), 10u);
+    EXPECT_EQ(storage.rescan(root + "/stats"), 25u);
+    EXPECT_EQ(storage.usage(root + "/stats"), 25u);
+}
@@ -0,0 +1,84 @@
+#include "topk.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+static const size_t TOPK_CHUNK = 16;
+// Above this k the sorted insertion costs more than a partition of the candidates
+static const size_t TOPK_INSERTION_MAX = 32;
+
+// Every non-NaN score in class id order, one pass
+static size_t selectAll(const float* scores, size_t n, std::pair<float, int>* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (scores[i] == scores[i]) out[count++] = std::make_pair(scores[i], static_cast<int>(i));
+    }
+    return count;
+}
+
+// Partition of the non-NaN scores around the k-th, then a sort of the k best
+static size_t selectPartition(const float* scores, size_t n, size_t k, std::pair<float, int>* out) {
+    thread_local std::vector<std::pair<float, int>> candidates;
+    candidates.clear();
+    for (size_t i = 0; i < n; ++i) {
+        if (scores[i] == scores[i]) candidates.emplace_back(scores[i], static_cast<int>(i));
+    }
+    // Descending score, the lower class id first on a tie like the insertion path
+    auto better = [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    };
+    const size_t count = std::min(k, candidates.size());
+    if (count < candidates.size()) {
+        std::nth_element(candidates.begin(), candidates.begin() + count, candidates.end(), better);
+    }
+    std::sort(candidates.begin(), candidates.begin() + count, better);
+    std::copy(candidates.begin(), candidates.begin() + count, out);
+    return count;
+}
+
+size_t selectTopK(const float* scores, size_t n, size_t k, std::pair<float, int>* out) {
+    if (k == 0) return 0;
+    if (k >= n) return selectAll(scores, n, out);
+    if (k > TOPK_INSERTION_MAX) return selectPartition(scores, n, k, out);
+
+    size_t count = 0;
+    float threshold = -std::numeric_limits<float>::infinity();
+
+    // Insertion into the descending output, dropping the smallest entry when full
+    auto insert = [&](float score, int cls) {
+        size_t pos = count < k ? count++ : k - 1;
+        while (pos > 0 && out[pos - 1].first < score) {
+            out[pos] = out[pos - 1];
+            --pos;
+        }
+        out[pos] = std::make_pair(score, cls);
+        if (count == k) threshold = out[k - 1].first;
+    };
+    // Until the output is full any non-NaN score is a candidate, -inf included
+    auto candidate = [&](float score) {
+        return count < k ? score >= threshold : score > threshold;
+    };
+
+    size_t i = 0;
+    for (; i + TOPK_CHUNK <= n; i += TOPK_CHUNK) {
+        const float* chunk = scores + i;
+        int hit = 0;
+        if (count < k) {
+            for (size_t j = 0; j < TOPK_CHUNK; ++j) {
+                hit |= chunk[j] >= threshold;
+            }
+        } else {
+            for (size_t j = 0; j < TOPK_CHUNK; ++j) {
+                hit |= chunk[j] > threshold;
+            }
+        }
+        if (!hit) continue;
+        for (size_t j = 0; j < TOPK_CHUNK; ++j) {
+            if (candidate(chunk[j])) insert(chunk[j], static_cast<int>(i + j));
+        }
+    }
+    for (; i < n; ++i) {
+        if (candidate(scores[i])) insert(scores[i], static_cast<int>(i));
+    }
+    return count;
+}
@@ -8,6 +8,7 @@
 #include "customprofile.h"
 #include <iniparser.h>
 
+std::atomic<uint64_t> CustomProfile::next_profile_id_(0);
 
 /**
  * @class CustomProfile
@@ -17,7 +18,10 @@
  * @param save_interval Interval for saving statistics
  */
 CustomProfile::CustomProfile(const std::string& conf_path, int save_interval)
-    : saver(new Saver(save_interval, "CustomProfile")) {
+    : saver(new Saver(save_interval, "CustomProfile")),
+      arena_(arenaAllocator("CustomProfile")),
+      profile_id_(next_profile_id_.fetch_add(1, std::memory_order_relaxed)) {
+    SketchArena::instance().configure(conf_path);
     try {
         // Read configuration settings
         IniParser parser;
@@ -26,9 +30,16 @@ CustomProfile::CustomProfile(const std::string& conf_path, int save_interval)
 	dataSavepath = 	customConfig["filepath"][1];
         createFolderIfNotExists(statSavepath, dataSavepath);
         customConfig.erase("filepath");
+        window_ = SketchWindow::fromConfig(customConfig["window"]);
+        customConfig.erase("window");
+        saver->Configure(customConfig, statSavepath);
+        for (const auto& metric : customConfig["relative_error"]) {
+            relative_metrics_.insert(metric);
+        }
+        customConfig.erase("relative_error");
 
         saver->StartSaving();
-    } catch (const std::runtime_error& e) {
+    } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
 }
@@ -40,11 +51,15 @@ CustomProfile::CustomProfile(const std::string& conf_path, int save_interval)
 **/
 CustomProfile::~CustomProfile() {
     delete saver;
-    // Clean up all the distributionBox objects
+    // Clean up all the ShardedSketch objects
     for (auto& entry : custom_stat_) {
         delete entry.second;
     }
     custom_stat_.clear(); // Clear the map after deleting the objects
+    for (auto& entry : relative_stat_) {
+        delete entry.second;
+    }
+    relative_stat_.clear();
 }
 
 
@@ -55,10 +70,15 @@ CustomProfile::~CustomProfile() {
  * @return 1 on success, error code on failure
  */
 int CustomProfile::profile(const std::string& name, float value) {
-    // Get the distributionBox for the given statistic name
-    distributionBox* custom_dBox = getBox(name);    
+    if (!relative_metrics_.empty() && relative_metrics_.count(name) > 0) {
+        getBox(name, relative_stat_)->update(value);
+        return 1;
+    }
+
+    // Get the sketch for the given statistic name
+    ShardedSketch* custom_dBox = getBox(name, custom_stat_);
 
-    // Update the distributionBox with the given value
+    // Update the shard of this thread with the given value
     custom_dBox->update(value);
 
     return 1; // Indicate success
@@ -66,25 +86,39 @@ int CustomProfile::profile(const std::string& name, float value) {
 
 
 /**
- * @brief Gets the distributionBox (KLL sketch) for the given statistic name.
+ * @brief Gets the sharded sketch for the given statistic name.
  * If it doesn't exist, a new one is created and added to the map.
  * @param name Statistic name
- * @return Pointer to the distributionBox object
+ * @param stats Map of the sketches of this type
+ * @return Pointer to the sketch
+ *
+ * Every thread keeps its own cache of the sketches it already used, so the
+ * shared map is only locked the first time a thread profiles a statistic.
  */
-distributionBox* CustomProfile::getBox(const std::string& name) {
+template <typename Box>
+Box* CustomProfile::getBox(const std::string& name, std::unordered_map<int, Box*>& stats) {
     // Convert the name to a unique integer ID, for example, by hashing
     int stat_id = std::hash<std::string>{}(name);
 
-    // Check if the distributionBox exists in the map
-    if (custom_stat_.find(stat_id) == custom_stat_.end()) {
-        // If not, create a new distributionBox and add it to the map
-        custom_stat_[stat_id] = new distributionBox();
-        
+    thread_local std::unordered_map<uint64_t, std::unordered_map<int, Box*>> thread_boxes;
+    auto& boxes = thread_boxes[profile_id_];
+    auto it = boxes.find(stat_id);
+    if (it != boxes.end()) {
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(stat_mutex_);
+    // Check if the sketch exists in the map
+    if (stats.find(stat_id) == stats.end()) {
+        // If not, create a new sketch and add it to the map
+        stats[stat_id] = new Box(SketchTraits<typename Box::sketch_type>::DEFAULT_K, arena_, window_);
+
         // Also register the new box for saving
-        saver->AddObjectToSave((void*)(custom_stat_[stat_id]), KLL_TYPE, statSavepath + name + ".bin");
+        saver->AddObjectToSave(stats[stat_id], statSavepath + name + ".bin");
     }
 
-    // Return the distributionBox
-    return custom_stat_[stat_id];
+    // Cache and return the sketch
+    boxes[stat_id] = stats[stat_id];
+    return stats[stat_id];
 }
 
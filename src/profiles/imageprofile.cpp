@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include "imageprofile.h"
 #include <iniparser.h>
 
@@ -14,6 +15,8 @@ ImageProfile::~ImageProfile() {
         delete obj;
     for (const auto& obj : pixelBox)
 	delete obj;    
+    for (const auto& entry : relativeBoxes)
+        delete entry.second;
 }
 
 
@@ -29,7 +32,11 @@ ImageProfile::~ImageProfile() {
  * @param channels Number of image channels (default: 1)
  */
 ImageProfile::ImageProfile(const std::string& conf_path, int save_interval, int channels)
-    : saver(new Saver(save_interval, "ImageProfile")), channels(channels) {
+    : saver(new Saver(save_interval, "ImageProfile")), channels(channels),
+      arena(arenaAllocator("ImageProfile")),
+      contrastBox(200, arena), brightnessBox(200, arena), sharpnessBox(200, arena),
+      noiseBox(200, arena) {
+    SketchArena::instance().configure(conf_path);
     try {
         // Read configuration settings
         IniParser parser;
@@ -38,6 +45,19 @@ ImageProfile::ImageProfile(const std::string& conf_path, int save_interval, int
 	dataSavepath = 	imageConfig["filepath"][1];
         createFolderIfNotExists(statSavepath, dataSavepath);
         imageConfig.erase("filepath");
+        sketchWindow = SketchWindow::fromConfig(imageConfig["window"]);
+        imageConfig.erase("window");
+        saver->Configure(imageConfig, statSavepath);
+        for (ShardedSketch* box : {&contrastBox, &brightnessBox, &sharpnessBox, &noiseBox}) {
+            box->set_window(sketchWindow);
+        }
+        // Tail-heavy scalar metrics can use a relative-error sketch instead of KLL
+        for (const auto& metric : imageConfig["relative_error"]) {
+            if (imageConfig.count(metric) && relativeBoxes.count(metric) == 0) {
+                relativeBoxes[metric] = new ShardedReqSketch(ReqSketch::DEFAULT_K, arena, sketchWindow);
+            }
+        }
+        imageConfig.erase("relative_error");
 
         // Register statistics for saving based on configuration
         for (const auto& config : imageConfig) {
@@ -45,7 +65,7 @@ ImageProfile::ImageProfile(const std::string& conf_path, int save_interval, int
         }
 
         saver->StartSaving();
-    } catch (const std::runtime_error& e) {
+    } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
 }
@@ -73,23 +93,47 @@ int ImageProfile::profile(cv::Mat& img, bool save_sample) {
  */
 void ImageProfile::registerStatistics(const std::string& name) {
     if (name == "NOISE") {
-        saver->AddObjectToSave((void*)(&noiseBox), KLL_TYPE, statSavepath + "noise.bin");
+        registerBox(name, noiseBox, "noise.bin");
     } else if (name == "BRIGHTNESS") {
-        saver->AddObjectToSave((void*)(&brightnessBox), KLL_TYPE, statSavepath + "brightness.bin");
+        registerBox(name, brightnessBox, "brightness.bin");
     } else if (name == "SHARPNESS") {
-        saver->AddObjectToSave((void*)(&sharpnessBox), KLL_TYPE, statSavepath + "sharpness.bin");
+        registerBox(name, sharpnessBox, "sharpness.bin");
     } else if (name == "MEAN") {
         for (int i = 0; i < channels; ++i) {
-            auto* dbox = new distributionBox(200);
+            auto* dbox = new ShardedSketch(200, arena, sketchWindow);
             meanBox.push_back(dbox);
-            saver->AddObjectToSave((void*)(dbox), KLL_TYPE, statSavepath + "mean_" + std::to_string(i) + ".bin");
+            saver->AddObjectToSave(dbox, statSavepath + "mean_" + std::to_string(i) + ".bin");
         }
     } else if (name == "HISTOGRAM") {
         for (int i = 0; i < channels; ++i) {
-            auto* dbox_hist = new distributionBox(200);
+            auto* dbox_hist = new ShardedSketch(200, arena, sketchWindow);
             pixelBox.push_back(dbox_hist);
-            saver->AddObjectToSave((void*)(dbox_hist), KLL_TYPE, statSavepath + "pixel_" + std::to_string(i) + ".bin");
+            saver->AddObjectToSave(dbox_hist, statSavepath + "pixel_" + std::to_string(i) + ".bin");
         }
+    } else if (name == "DISTINCT_SCENES") {
+        saver->AddObjectToSave(&sceneHashes, statSavepath + "distinct_scenes.bin");
+    }
+}
+
+/**
+ * @brief Registers the sketch of a scalar metric under the same file name,
+ * whichever sketch type the metric uses
+ */
+void ImageProfile::registerBox(const std::string& name, ShardedSketch& box, const std::string& filename) {
+    auto it = relativeBoxes.find(name);
+    if (it != relativeBoxes.end()) {
+        saver->AddObjectToSave(it->second, statSavepath + filename);
+    } else {
+        saver->AddObjectToSave(&box, statSavepath + filename);
+    }
+}
+
+void ImageProfile::updateBox(const std::string& name, ShardedSketch& box, float score) {
+    auto it = relativeBoxes.find(name);
+    if (it != relativeBoxes.end()) {
+        it->second->update(score);
+    } else {
+        box.update(score);
     }
 }
 
@@ -103,15 +147,15 @@ float ImageProfile::computeStatistic(const std::string& name, cv::Mat& img) {
     float stat_score;
     if (name == "NOISE") {
 	stat_score = calculateSNR(img);  
-        noiseBox.update(stat_score);
+        updateBox(name, noiseBox, stat_score);
         return -1.0;
     } else if (name == "BRIGHTNESS") {
         stat_score = calculateBrightness(img);
-	brightnessBox.update(stat_score);
+	updateBox(name, brightnessBox, stat_score);
         return -1.0;		
     } else if (name == "SHARPNESS") {
 	stat_score =calculateSharpnessLaplacian(img);     
-        sharpnessBox.update(stat_score);
+        updateBox(name, sharpnessBox, stat_score);
 	return -1.0;
     } else if (name == "MEAN") {
         cv::Scalar mean_values = cv::mean(img);
@@ -121,13 +165,14 @@ float ImageProfile::computeStatistic(const std::string& name, cv::Mat& img) {
         return -1.0f; // MEAN doesn't have a single return value
     } else if (name == "CONTRAST") {
 	stat_score = calculateContrast(img);    
-        contrastBox.update(stat_score);
+        updateBox(name, contrastBox, stat_score);
 	return -1.0;
     } else if (name == "HISTOGRAM") {
-        iterateImage(img, [this](const std::vector<int>& pixelValues) {
-            this->updatePixelValues(pixelValues);
-        });
+        updatePixelHistograms(img);
         return -1.0f; // HISTOGRAM doesn't have a single return value
+    } else if (name == "DISTINCT_SCENES") {
+        sceneHashes.update(calculateAverageHash(img));
+        return -1.0f; // DISTINCT_SCENES doesn't have a single return value
     }
     return -1.0f; // Default case
 }
@@ -183,3 +228,45 @@ void ImageProfile::updatePixelValues(const std::vector<int>& pixelValues) {
             pixelBox[i]->update(pixelValues[i]);
     }
 }
+
+/**
+ * @brief Updates the per-channel pixel histograms
+ * @param img OpenCV image matrix
+ *
+ * The pixels are de-interleaved into one buffer per channel and every sketch
+ * gets a single bulk update, instead of one callback and sketch update per pixel.
+ * The buffers are thread local, every inference thread reuses its own.
+ */
+void ImageProfile::updatePixelHistograms(const cv::Mat& img) {
+    if (img.empty()) {
+        throw std::runtime_error("Image is empty.");
+    }
+
+    cv::Mat img8u = img;
+    if (img.depth() != CV_8U) {
+        img.convertTo(img8u, CV_8U);
+    }
+
+    const int img_channels = img8u.channels();
+    const int hist_channels = std::min(img_channels, static_cast<int>(pixelBox.size()));
+    const size_t num_pixels = static_cast<size_t>(img8u.rows) * img8u.cols;
+    thread_local std::vector<std::vector<float>> pixelBuffer;
+    pixelBuffer.resize(hist_channels);
+    for (auto& buffer : pixelBuffer) {
+        buffer.resize(num_pixels);
+    }
+
+    size_t index = 0;
+    for (int row = 0; row < img8u.rows; ++row) {
+        const uchar* pixel = img8u.ptr<uchar>(row);
+        for (int col = 0; col < img8u.cols; ++col, ++index, pixel += img_channels) {
+            for (int ch = 0; ch < hist_channels; ++ch) {
+                pixelBuffer[ch][index] = pixel[ch];
+            }
+        }
+    }
+
+    for (int ch = 0; ch < hist_channels; ++ch) {
+        pixelBox[ch]->update(pixelBuffer[ch].data(), num_pixels);
+    }
+}
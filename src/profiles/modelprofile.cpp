@@ -1,14 +1,49 @@
 #include "modelprofile.h"
 #include "iniparser.h"
 #include "parser_factory.h"
+#include "datatracer_log.h"
+#include "topk.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
 
 ModelProfile::~ModelProfile() {
+    cleanup();
+}
+
+// Releases the Saver first, no save cycle reads the sketches afterwards
+void ModelProfile::cleanup() {
     delete saver;
+    saver = nullptr;
     for (const auto& pair : model_classes_stat_) {
         delete pair.second;
     }
+    model_classes_stat_.clear();
     delete sketch1;
+    sketch1 = nullptr;
     delete model_embeddings;
+    model_embeddings = nullptr;
+    delete embedding_stats_;
+    embedding_stats_ = nullptr;
+    delete projection_sketch_;
+    projection_sketch_ = nullptr;
+    delete confusion_pairs_;
+    confusion_pairs_ = nullptr;
+    delete cooccurring_pairs_;
+    cooccurring_pairs_ = nullptr;
+}
+
+// Parses a config value made of decimal digits only, false for anything else
+static bool parseUnsigned(const std::string& value, unsigned long& result) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    try {
+        result = std::stoul(value);
+    } catch (const std::out_of_range& e) {
+        return false;
+    }
+    return true;
 }
 
 /**
@@ -23,23 +58,77 @@ ModelProfile::~ModelProfile() {
  * @param saver Reference to a Saver object used for saving model statistics
  */
 ModelProfile::ModelProfile(std::string model_id, std::string conf_path,
-	       	int save_interval, int top_classes): saver(new Saver(save_interval, "ModelProfile")){
+	       	int save_interval, int top_classes): sketch1(nullptr), saver(new Saver(save_interval, "ModelProfile")),
+                arena_(arenaAllocator("ModelProfile")),
+                confusion_pairs_(nullptr), cooccurring_pairs_(nullptr), model_embeddings(nullptr),
+                per_dimension_embeddings_(false), embedding_rank_(0), embedding_stats_(nullptr),
+                embedding_projections_(0), projection_seed_(ProjectionSketch::DEFAULT_SEED),
+                projection_sketch_(nullptr){
     std::string endpointUrl="";
     std::string token="";
 
-  // Set member variables
-  model_id_ = model_id;
-  IniParser parser;
-  modelConfig = parser.parseIniFile(conf_path,
-                          "model", "");
-  statSavepath = modelConfig["filepath"][0];
-  dataSavepath = modelConfig["filepath"][1];
-  createFolderIfNotExists(statSavepath, dataSavepath);
-  top_classes_ = top_classes;
-  sketch1 = new frequent_class_sketch(64);
-  model_embeddings = new distributionBox(200);
-  registerStatistics();
-  saver->StartSaving();
+  SketchArena::instance().configure(conf_path);
+
+  try {
+    // Set member variables
+    model_id_ = model_id;
+    IniParser parser;
+    modelConfig = parser.parseIniFile(conf_path,
+                            "model", "");
+    statSavepath = modelConfig["filepath"][0];
+    dataSavepath = modelConfig["filepath"][1];
+    createFolderIfNotExists(statSavepath, dataSavepath);
+    top_classes_ = top_classes;
+    window_ = SketchWindow::fromConfig(modelConfig["window"]);
+    saver->Configure(modelConfig, statSavepath);
+
+    // Optional per-dimension embedding statistics
+    if (!modelConfig["EMBEDDING_STATS"].empty()) {
+        per_dimension_embeddings_ = (modelConfig["EMBEDDING_STATS"][0] == "per_dimension");
+    }
+    for (const auto& dim : modelConfig["EMBEDDING_SKETCH_DIMS"]) {
+        embedding_sketch_dims_.push_back(std::stoul(dim));
+    }
+    if (!modelConfig["EMBEDDING_RANK"].empty()) {
+        embedding_rank_ = std::stoul(modelConfig["EMBEDDING_RANK"][0]);
+    }
+
+    // Optional random projection drift sketch
+    if (!modelConfig["EMBEDDING_PROJECTIONS"].empty()) {
+        embedding_projections_ = std::stoul(modelConfig["EMBEDDING_PROJECTIONS"][0]);
+    }
+    if (!modelConfig["EMBEDDING_PROJECTION_SEED"].empty()) {
+        projection_seed_ = std::stoull(modelConfig["EMBEDDING_PROJECTION_SEED"][0]);
+    }
+    if (!modelConfig["EMBEDDING_BASELINE"].empty()) {
+        embedding_baseline_ = modelConfig["EMBEDDING_BASELINE"][0];
+    }
+    // Optional count-min sketches of class pairs instead of a classes x classes matrix
+    if (!modelConfig["CLASS_PAIRS"].empty()) {
+        const auto& pairs = modelConfig["CLASS_PAIRS"];
+        unsigned long width = 0;
+        unsigned long depth = CountMinSketch::DEFAULT_DEPTH;
+        if (!parseUnsigned(pairs[0], width) || (pairs.size() > 1 && !parseUnsigned(pairs[1], depth)) ||
+            width < 1 || width > CountMinSketch::MAX_WIDTH || depth < 1 || depth > CountMinSketch::MAX_DEPTH) {
+            log_err << "ModelProfile: CLASS_PAIRS must be <width>,<depth> with width in [1, "
+                    << CountMinSketch::MAX_WIDTH << "] and depth in [1, " << +CountMinSketch::MAX_DEPTH
+                    << "], class pair sketches disabled" << std::endl;
+        } else {
+            confusion_pairs_ = new CountMinSketch(static_cast<uint32_t>(width), static_cast<uint8_t>(depth),
+                                                  CountMinSketch::DEFAULT_MAX_CANDIDATES, arena_);
+            cooccurring_pairs_ = new CountMinSketch(static_cast<uint32_t>(width), static_cast<uint8_t>(depth),
+                                                    CountMinSketch::DEFAULT_MAX_CANDIDATES, arena_);
+        }
+    }
+    sketch1 = new frequent_class_sketch(64);
+    model_embeddings = new ShardedSketch(200, arena_, window_);
+    registerStatistics();
+    saver->StartSaving();
+  } catch (const std::exception& e) {
+      log_err << "ModelProfile: initialization failed: " << e.what() << std::endl;
+      cleanup();
+      throw;
+  }
 #ifndef TEST
     /*int uploadtype=0;
     s3_client_config_t s3_client_config; 
@@ -58,7 +147,16 @@ int ModelProfile::getNumDistributionBoxes() const {
 
 // Register Model embeddings saver
 void ModelProfile::registerStatistics(){
-   saver->AddObjectToSave((void*)(model_embeddings), KLL_TYPE, statSavepath + "embeddings.bin");
+   saver->AddObjectToSave(&inference_latency_, statSavepath + model_id_ + "_latency.bin");
+   saver->AddObjectToSave(&predicted_classes_, statSavepath + model_id_ + "_distinct_classes.bin");
+   if (confusion_pairs_ != nullptr) {
+       saver->AddObjectToSave(confusion_pairs_, statSavepath + model_id_ + "_confusion_pairs.bin");
+       saver->AddObjectToSave(cooccurring_pairs_, statSavepath + model_id_ + "_cooccurring_pairs.bin");
+   }
+   // In per-dimension mode the embedding statistics are registered on the first embedding
+   if (!per_dimension_embeddings_) {
+       saver->AddObjectToSave(model_embeddings, statSavepath + "embeddings.bin");
+   }
 }
 
 /**
@@ -67,38 +165,174 @@ void ModelProfile::registerStatistics(){
  * @param results Reference to the classification results
  * @return 0 on success, negative value on error
  *
- * This function iterates through the provided results and logs statistics for the most frequent classes.
- * It updates the `model_classes_stat` map with scores for each class.
+ * Only the top_classes_ highest scoring results are logged (all of them if
+ * top_classes_ is not positive), so memory grows with the classes actually
+ * seen among the top-k and not with the model vocabulary.
  */
-int ModelProfile::log_classification_model_stats(float inference_latency __attribute__((unused)),
+int ModelProfile::log_classification_model_stats(float inference_latency,
 	       	const ClassificationResults& results) {
-    for (const auto& result : results) {
-        int cls = result.second;
-        float score = result.first;
+    log_inference_latency(inference_latency);
+    if (top_classes_ > 0 && results.size() > static_cast<size_t>(top_classes_)) {
+        top_results_.resize(top_classes_);
+        std::partial_sort_copy(results.begin(), results.end(), top_results_.begin(), top_results_.end(),
+                               std::greater<std::pair<float, int>>());
+        updateClassStats(top_results_.data(), top_results_.size());
+    } else {
+        updateClassStats(results.data(), results.size());
+    }
+  return 0; // Assuming successful logging, replace with error handling if needed
+}
+
+/**
+ * @brief Logs classification model statistics from the raw score buffer
+ * @param inference_latency Time taken for model inference
+ * @param scores Pointer to the model output scores, indexed by class id
+ * @param num_classes Number of scores in the buffer
+ * @return 0 on success, negative value on error
+ *
+ * The top_classes_ entries are picked with a vectorized partial selection in
+ * one pass over the buffer, no result vector is built for all classes.
+ */
+int ModelProfile::log_classification_model_stats(float inference_latency,
+                const float* scores, size_t num_classes) {
+    log_inference_latency(inference_latency);
+    if (scores == nullptr) {
+        return -1;
+    }
+    const size_t k = top_classes_ > 0 ? static_cast<size_t>(top_classes_) : num_classes;
+    top_results_.resize(k);
+    const size_t count = selectTopK(scores, num_classes, k, top_results_.data());
+    updateClassStats(top_results_.data(), count);
+    return 0;
+}
+
+/**
+ * @brief Updates the per-class sketches and the frequent class sketch
+ * @param results Pointer to (score, class id) pairs
+ * @param count Number of pairs
+ *
+ * It updates the `model_classes_stat` map with scores for each class and
+ * counts the class in the distinct classes sketch. The two best classes
+ * form the confusion pair, the results are not sorted on every path so they
+ * are picked in the same pass.
+ */
+void ModelProfile::updateClassStats(const std::pair<float, int>* results, size_t count) {
+    const std::pair<float, int>* first = nullptr;
+    const std::pair<float, int>* second = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        int cls = results[i].second;
+        float score = results[i].first;
         auto it = model_classes_stat_.find(cls);
         if (it != model_classes_stat_.end()) {
             // Key exists, update the value
             it->second->update(score);
         } else {
             // Key does not exist, add the key-value pair
-            dBox = new distributionBox(200);
+            dBox = new ShardedSketch(200, arena_, window_);
             model_classes_stat_[cls] = dBox;
             model_classes_stat_[cls]->update(score);
-            saver->AddObjectToSave((void *)(dBox), KLL_TYPE,
-                                   statSavepath + model_id_ + std::to_string(cls) + ".bin");  // Register with Saver for saving
+            saver->AddObjectToSave(dBox, statSavepath + model_id_ + std::to_string(cls) + ".bin");  // Register with Saver for saving
         }
         sketch1->update(std::to_string(cls));  // Placeholder for storing frequent class IDs
+        predicted_classes_.update(static_cast<uint64_t>(cls));
+        if (first == nullptr || results[i].first > first->first) {
+            second = first;
+            first = &results[i];
+        } else if (second == nullptr || results[i].first > second->first) {
+            second = &results[i];
+        }
+    }
+    if (confusion_pairs_ != nullptr && second != nullptr) {
+        confusion_pairs_->update(CountMinSketch::pair_key(first->second, second->second));
     }
-  return 0; // Assuming successful logging, replace with error handling if needed
+}
+
+/**
+ * @brief Logs the classes detected in one frame into the co-occurrence pair sketch
+ * @param classes Pointer to the class ids of the detections
+ * @param count Number of detections
+ * @return 0 on success, negative value on error
+ *
+ * The classes are deduplicated in a thread local buffer, so a frame with many
+ * detections of a few classes only updates the sketch once per class pair.
+ */
+int ModelProfile::log_detected_classes(const int* classes, size_t count) {
+    if (classes == nullptr && count > 0) {
+        return -1;
+    }
+    if (cooccurring_pairs_ == nullptr) {
+        return 0;
+    }
+    thread_local std::vector<int> frame_classes;
+    frame_classes.assign(classes, classes + count);
+    std::sort(frame_classes.begin(), frame_classes.end());
+    frame_classes.erase(std::unique(frame_classes.begin(), frame_classes.end()), frame_classes.end());
+    for (size_t i = 0; i < frame_classes.size(); ++i) {
+        for (size_t j = i + 1; j < frame_classes.size(); ++j) {
+            cooccurring_pairs_->update(CountMinSketch::pair_key(frame_classes[i], frame_classes[j]));
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Logs an inference latency
+ * @param inference_latency Time taken for model inference in milliseconds
+ *
+ * A single relaxed atomic increment, no lock and no sketch update.
+ */
+void ModelProfile::log_inference_latency(float inference_latency) {
+    inference_latency_.record(inference_latency);
 }
 
 /**
  * @brief Logs embeddings 
  */
 int ModelProfile::log_embeddings(const std::vector<float>& embeddings) {
-    for (const auto& value : embeddings) {
-        model_embeddings->update(value);
+    return log_embeddings(embeddings.data(), embeddings.size());
+}
+
+/**
+ * @brief Logs embeddings from a raw buffer
+ * @param embeddings pointer to the embedding values
+ * @param dims number of values in the embedding
+ * @return 1 on success, -1 if the dimension differs from the first embedding
+ *
+ * In per-dimension mode every embedding is folded into EmbeddingStats in one
+ * vectorized pass, otherwise all values go into a single KLL sketch.
+ */
+int ModelProfile::log_embeddings(const float* embeddings, size_t dims) {
+    return log_embeddings_batch(embeddings, 1, dims);
+}
+
+/**
+ * @brief Logs a batch of embeddings
+ * @param embeddings count x dims row major embedding values
+ * @param count number of embeddings in the batch
+ * @param dims number of values in every embedding
+ * @return 1 on success, -1 if the dimension differs from the first embedding
+ *
+ * The projection sketch projects the whole batch with one blocked matrix product.
+ */
+int ModelProfile::log_embeddings_batch(const float* embeddings, size_t count, size_t dims) {
+    if (embedding_projections_ > 0) {
+        ProjectionSketch* projection = getProjectionSketch(dims);
+        if (projection == nullptr) {
+            return -1;
+        }
+        projection->update(embeddings, count);
     }
+    if (per_dimension_embeddings_) {
+        EmbeddingStats* stats = getEmbeddingStats(dims);
+        if (stats == nullptr) {
+            return -1;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            stats->update(embeddings + i * dims);
+        }
+        return 1;
+    }
+    model_embeddings->update(embeddings, count * dims);
     return 1;
 }
 
@@ -109,34 +343,87 @@ int ModelProfile::log_embeddings(const std::vector<float>& embeddings) {
  * @return 1 on success, error code on failure
  */
 int ModelProfile::log_embeddings(const std::vector<float>& embeddings, int cls) {
-    // Get the distributionBox for the given statistic name
-    distributionBox* cls_dBox = getBox(cls);    
+    // Get the sketch for the given statistic name
+    ShardedSketch* cls_dBox = getBox(cls);
 
-    // Update the distributionBox with the given value
-    for (const auto& value : embeddings) {
-        cls_dBox->update(value);
-    }
+    // Update the sketch with all values in one bulk update
+    cls_dBox->update(embeddings.data(), embeddings.size());
     return 1; // Indicate success
 }
 
 
 /**
- * @brief Gets the distributionBox (KLL sketch) for the given statistic name.
+ * @brief Gets the KLL sketch for the given statistic name.
  * If it doesn't exist, a new one is created and added to the map.
  * @param name Statistic name
- * @return Pointer to the distributionBox object
+ * @return Pointer to the ShardedSketch object
  */
-distributionBox* ModelProfile::getBox(const int cls) {
+ShardedSketch* ModelProfile::getBox(const int cls) {
 
-    // Check if the distributionBox exists in the map
+    // Check if the sketch exists in the map
     if (embeddings_stat_.find(cls) == embeddings_stat_.end()) {
-        // If not, create a new distributionBox and add it to the map
-        embeddings_stat_[cls] = new distributionBox();
-        
+        // If not, create a new sketch and add it to the map
+        embeddings_stat_[cls] = new ShardedSketch(datasketches::kll_constants::DEFAULT_K, arena_, window_);
+
         // Also register the new box for saving
-        saver->AddObjectToSave((void*)(embeddings_stat_[cls]), KLL_TYPE, statSavepath + std::to_string(cls) + "_embedding.bin");
+        saver->AddObjectToSave(embeddings_stat_[cls], statSavepath + std::to_string(cls) + "_embedding.bin");
     }
 
-    // Return the distributionBox
+    // Return the sketch
     return embeddings_stat_[cls];
 }
+
+/**
+ * @brief Gets the per-dimension embedding statistics.
+ * They are created on the first embedding, when the dimension is known, and
+ * registered with the Saver together with the configured per-dimension sketches.
+ * @param dims Number of embedding dimensions
+ * @return Pointer to the EmbeddingStats object, nullptr on dimension mismatch
+ */
+EmbeddingStats* ModelProfile::getEmbeddingStats(size_t dims) {
+    if (embedding_stats_ == nullptr) {
+        try {
+            embedding_stats_ = new EmbeddingStats(dims, embedding_sketch_dims_, embedding_rank_);
+        } catch (const std::exception& e) {
+            log_err << "ModelProfile: " << e.what() << std::endl;
+            return nullptr;
+        }
+        saver->AddObjectToSave(embedding_stats_, statSavepath + "embedding_stats.bin");
+        for (const auto& pair : embedding_stats_->get_sketches()) {
+            saver->AddObjectToSave(pair.second, statSavepath + "embedding_dim_" + std::to_string(pair.first) + ".bin");
+        }
+    } else if (embedding_stats_->get_dims() != dims) {
+        log_err << "ModelProfile: embedding dimension " << dims << " does not match "
+                << embedding_stats_->get_dims() << std::endl;
+        return nullptr;
+    }
+    return embedding_stats_;
+}
+
+/**
+ * @brief Gets the random projection sketch.
+ * It is created on the first embedding, the baseline is loaded once and the
+ * sketch is registered with the Saver, which refreshes the drift score every
+ * save interval.
+ * @param dims Number of embedding dimensions
+ * @return Pointer to the ProjectionSketch object, nullptr on dimension mismatch
+ */
+ProjectionSketch* ModelProfile::getProjectionSketch(size_t dims) {
+    if (projection_sketch_ == nullptr) {
+        try {
+            projection_sketch_ = new ProjectionSketch(dims, embedding_projections_, projection_seed_);
+        } catch (const std::exception& e) {
+            log_err << "ModelProfile: " << e.what() << std::endl;
+            return nullptr;
+        }
+        if (!embedding_baseline_.empty()) {
+            projection_sketch_->load_baseline(embedding_baseline_);
+        }
+        saver->AddObjectToSave(projection_sketch_, statSavepath + "embedding_projection.bin");
+    } else if (projection_sketch_->get_dims() != dims) {
+        log_err << "ModelProfile: embedding dimension " << dims << " does not match "
+                << projection_sketch_->get_dims() << std::endl;
+        return nullptr;
+    }
+    return projection_sketch_;
+}
@@ -1,5 +1,6 @@
 #include "imageprofile.h"  // Include your class header
 #include "saver.h"  // Include the Saver class
+#include "saverservice.h"
 #include <gtest/gtest.h>
 #include <opencv2/opencv.hpp>
 #include <fstream>
@@ -27,6 +28,7 @@ protected:
         std::ofstream ini_file(filename, std::ios::trunc);
         ini_file << "[image]\n";
         ini_file << "filepath = ./\n";  // Sample file path
+        ini_file << "fresh_start = true\n";  // Independent of the files of earlier tests
         ini_file << "NOISE = 0.5\n";  // Thresholds
         ini_file << "BRIGHTNESS = 0.4\n";
         ini_file << "SHARPNESS = 0.6\n";
@@ -85,18 +87,18 @@ TEST_F(ImageProfileTest, IterateImageInvalidImage) {
 
 //Test the StartSaving and TriggerSave methods for threading behavior
 TEST_F(ImageProfileTest, ThreadingBehavior) {
-    // Check if the save thread is still running
-    EXPECT_TRUE(image_profile->saver->save_thread_.joinable());
+    // Check if the saver is scheduled on the saver service thread
+    EXPECT_TRUE(SaverService::instance().isRegistered(image_profile->saver));
     // Further checks can include more detailed validation of queue processing
 }
 
 // Test SaveObjectToFile to ensure correct data is written to files
 TEST_F(ImageProfileTest, SaveObjectToFile) {
     // Simulate adding objects to the saver
-    distributionBox testBox;  // Example distribution box
+    ShardedSketch testBox;  // Example distribution box
     empty_q();
-    image_profile->saver->AddObjectToSave((void*)(&testBox), KLL_TYPE, "test_savefile.bin");
-    // Allow some time for the SaveLoop to process
+    image_profile->saver->AddObjectToSave(&testBox, "test_savefile.bin");
+    // Allow some time for the save cycle to process
     std::this_thread::sleep_for(std::chrono::seconds(2));
     
     // Check if the file was created and contains data
@@ -2,6 +2,8 @@
 #include "saver.h"
 #include <gtest/gtest.h>
 #include <fstream>
+#include <limits>
+#include "topk.h"
 
 // Test Fixture for ModelProfile
 class ModelProfileTest : public ::testing::Test {
@@ -21,7 +23,8 @@ protected:
     void createSampleIniFile(const std::string& filename) {
         std::ofstream ini_file(filename, std::ios::trunc);
         ini_file << "[model]\n";
-        ini_file << "files = ./\n";
+        ini_file << "filepath = ./,./\n";
+        ini_file << "fresh_start = true\n";  // Independent of the files of earlier tests
         ini_file.close();
     }
 
@@ -55,6 +58,72 @@ TEST_F(ModelProfileTest, LogClassificationModelStats) {
 */
 }
 
+// Test that inference latencies are recorded in the histogram
+TEST_F(ModelProfileTest, InferenceLatencyHistogram) {
+    ClassificationResults results = {{0.9f, 1}};
+    for (int i = 1; i <= 100; ++i) {
+        model_profile->log_classification_model_stats(static_cast<float>(i), results);
+    }
+    EXPECT_EQ(model_profile->inference_latency_.get_n(), 100u);
+    EXPECT_NEAR(model_profile->inference_latency_.get_quantile(0.99), 99.0, 99.0 * 0.04);
+}
+
+// Test that only the top_classes highest scores are tracked
+TEST_F(ModelProfileTest, TopKClassesFromRawScores) {
+    std::vector<float> scores(20000, 0.0f);
+    scores[17] = 0.5f;
+    scores[4242] = 0.9f;
+    scores[19999] = 0.7f;
+    scores[100] = 0.6f;
+    int result = model_profile->log_classification_model_stats(1.0f, scores.data(), scores.size());
+    EXPECT_EQ(result, 0);
+    // top_classes is 3, only the three highest scores get a sketch
+    EXPECT_EQ(model_profile->model_classes_stat_.size(), 3u);
+    EXPECT_EQ(model_profile->model_classes_stat_.count(4242), 1u);
+    EXPECT_EQ(model_profile->model_classes_stat_.count(19999), 1u);
+    EXPECT_EQ(model_profile->model_classes_stat_.count(100), 1u);
+    EXPECT_EQ(model_profile->model_classes_stat_[4242]->get_merged().get_max_item(), 0.9f);
+    EXPECT_EQ(model_profile->log_classification_model_stats(1.0f, nullptr, 10), -1);
+
+    // The vector interface applies the same selection
+    ClassificationResults results = {{0.1f, 1}, {0.4f, 2}, {0.3f, 3}, {0.2f, 4}};
+    model_profile->log_classification_model_stats(1.0f, results);
+    EXPECT_EQ(model_profile->model_classes_stat_.count(1), 0u);
+    EXPECT_EQ(model_profile->model_classes_stat_.count(2), 1u);
+    // 4242, 19999, 100, 2, 3 and 4 were among the top classes
+    EXPECT_NEAR(model_profile->predicted_classes_.get_estimate(), 6.0, 0.5);
+}
+
+// The selection paths agree for every k, NaN is skipped and -inf is a score
+TEST(TopKTest, SelectsTheHighestScores) {
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<float> scores(1000);
+    for (size_t i = 0; i < scores.size(); ++i) {
+        scores[i] = static_cast<float>((i * 7919) % 1000);
+    }
+    scores[0] = std::numeric_limits<float>::quiet_NaN();  // the score 0
+    for (size_t k : {1, 5, 32, 33, 500, 999}) {
+        std::vector<std::pair<float, int>> out(k);
+        ASSERT_EQ(selectTopK(scores.data(), scores.size(), k, out.data()), k);
+        for (size_t i = 0; i < k; ++i) {
+            EXPECT_EQ(out[i].first, 999.0f - i) << "k=" << k;
+            EXPECT_EQ(scores[out[i].second], out[i].first);
+        }
+    }
+
+    // All selected: every non-NaN score in class id order
+    std::vector<std::pair<float, int>> all(scores.size());
+    ASSERT_EQ(selectTopK(scores.data(), scores.size(), scores.size(), all.data()), scores.size() - 1);
+    EXPECT_EQ(all[0].second, 1);
+
+    std::vector<float> low = {-inf, std::numeric_limits<float>::quiet_NaN(), -inf, 1.0f};
+    std::vector<std::pair<float, int>> out(3);
+    ASSERT_EQ(selectTopK(low.data(), low.size(), 3, out.data()), 3u);
+    EXPECT_EQ(out[0], std::make_pair(1.0f, 3));
+    EXPECT_EQ(out[1], std::make_pair(-inf, 0));
+    EXPECT_EQ(out[2], std::make_pair(-inf, 2));
+}
+
 // Test Invalid Configuration
 TEST_F(ModelProfileTest, InvalidConfiguration) {
     createSampleIniFile("invalid_config.ini");
@@ -87,6 +156,122 @@ TEST_F(ModelProfileTest, ObjectsRegisteredWithSaver) {
     };
     float latency = 1.5f;
     int result = model_profile->log_classification_model_stats(latency, results);
-    EXPECT_EQ(model_profile->saver->objects_to_save_.size(), 3); // Should have 3 objects to save
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(model_profile->saver->objects_to_save_.size(), 6); // latency, distinct classes, embeddings and 3 class sketches to save
+}
+
+
+// Test per-dimension embedding statistics
+TEST_F(ModelProfileTest, PerDimensionEmbeddings) {
+    std::ofstream ini_file("embedding_config.ini", std::ios::trunc);
+    ini_file << "[model]\n";
+    ini_file << "filepath = ./,./\n";
+    ini_file << "fresh_start = true\n";  // Independent of the files of earlier tests
+    ini_file << "EMBEDDING_STATS = per_dimension\n";
+    ini_file << "EMBEDDING_SKETCH_DIMS = 0,2\n";
+    ini_file << "EMBEDDING_RANK = 2\n";
+    ini_file.close();
+
+    ModelProfile profile("embedding_model", "embedding_config.ini", 1, 3);
+    std::vector<float> embedding = {1.0f, 2.0f, 3.0f, 4.0f};
+    EXPECT_EQ(profile.log_embeddings(embedding), 1);
+    embedding = {3.0f, 2.0f, 1.0f, 0.0f};
+    EXPECT_EQ(profile.log_embeddings(embedding), 1);
+
+    ASSERT_NE(profile.embedding_stats_, nullptr);
+    EXPECT_EQ(profile.embedding_stats_->get_n(), 2u);
+    EXPECT_DOUBLE_EQ(profile.embedding_stats_->get_mean()[0], 2.0);
+    EXPECT_DOUBLE_EQ(profile.embedding_stats_->get_variance()[3], 4.0);
+    EXPECT_EQ(profile.embedding_stats_->get_sketches().size(), 2u);
+    // Latency histogram, distinct classes, stats file and two per-dimension sketches are registered with the Saver
+    EXPECT_EQ(profile.saver->objects_to_save_.size(), 5);
+
+    // Embeddings of a different dimension are rejected
+    std::vector<float> wrong = {1.0f, 2.0f};
+    EXPECT_EQ(profile.log_embeddings(wrong), -1);
+    std::remove("embedding_config.ini");
+}
+
+// Test random projection drift sketch with batched embeddings
+TEST_F(ModelProfileTest, ProjectionSketchEmbeddings) {
+    std::ofstream ini_file("projection_config.ini", std::ios::trunc);
+    ini_file << "[model]\n";
+    ini_file << "filepath = ./,./\n";
+    ini_file << "fresh_start = true\n";  // Independent of the files of earlier tests
+    ini_file << "EMBEDDING_PROJECTIONS = 4\n";
+    ini_file << "EMBEDDING_PROJECTION_SEED = 11\n";
+    ini_file.close();
+
+    ModelProfile profile("projection_model", "projection_config.ini", 1, 3);
+    std::vector<float> batch = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+    EXPECT_EQ(profile.log_embeddings_batch(batch.data(), 2, 3), 1);
+    ASSERT_NE(profile.projection_sketch_, nullptr);
+    EXPECT_EQ(profile.projection_sketch_->get_n(), 2u);
+    EXPECT_EQ(profile.projection_sketch_->get_seed(), 11u);
+    EXPECT_FALSE(profile.projection_sketch_->has_baseline());
+    EXPECT_EQ(profile.log_embeddings(batch.data(), 2), -1);
+    std::remove("projection_config.ini");
+}
+
+// Test confusion and co-occurrence class pair sketches
+TEST_F(ModelProfileTest, ClassPairSketches) {
+    std::ofstream ini_file("pairs_config.ini", std::ios::trunc);
+    ini_file << "[model]\n";
+    ini_file << "filepath = ./,./\n";
+    ini_file << "fresh_start = true\n";  // Independent of the files of earlier tests
+    ini_file << "CLASS_PAIRS = 1024,4\n";
+    ini_file.close();
+
+    ModelProfile profile("pairs_model", "pairs_config.ini", 1, 3);
+    ASSERT_NE(profile.confusion_pairs_, nullptr);
+    EXPECT_EQ(profile.confusion_pairs_->get_width(), 1024u);
+    // Unsorted results, the confusion pair is (best, second best)
+    ClassificationResults results = {{0.2f, 9}, {0.7f, 4}, {0.5f, 6}};
+    for (int i = 0; i < 10; ++i) {
+        profile.log_classification_model_stats(1.0f, results);
+    }
+    const auto confused = profile.confusion_pairs_->get_heavy_hitters();
+    ASSERT_EQ(confused.size(), 1u);
+    EXPECT_EQ(CountMinSketch::pair_classes(confused[0].first), std::make_pair(4, 6));
+    EXPECT_EQ(confused[0].second, 10u);
+
+    // Duplicate detections of a class count once per frame
+    std::vector<int> frame = {3, 1, 3, 2, 1};
+    EXPECT_EQ(profile.log_detected_classes(frame.data(), frame.size()), 0);
+    EXPECT_EQ(profile.cooccurring_pairs_->get_total_weight(), 3u);
+    EXPECT_EQ(profile.cooccurring_pairs_->get_estimate(CountMinSketch::pair_key(1, 3)), 1u);
+    EXPECT_EQ(profile.log_detected_classes(nullptr, 2), -1);
+    // latency, distinct classes, embeddings, the two pair sketches and 3 class sketches
+    EXPECT_EQ(profile.saver->objects_to_save_.size(), 8);
+    std::remove("pairs_config.ini");
+}
+
+// A malformed value fails the constructor without leaking the Saver
+TEST(ModelProfileConfigTest, MalformedValueThrows) {
+    {
+        std::ofstream ini_file("malformed_config.ini", std::ios::trunc);
+        ini_file << "[model]\n";
+        ini_file << "filepath = ./,./\n";
+        ini_file << "fresh_start = true\n";
+        ini_file << "EMBEDDING_RANK = many\n";
+    }
+    EXPECT_THROW(ModelProfile("test_model", "malformed_config.ini", 1, 3), std::invalid_argument);
+    std::remove("malformed_config.ini");
 }
 
+// An out of range CLASS_PAIRS value disables the pair sketches instead of wrapping
+TEST(ModelProfileConfigTest, InvalidClassPairsDisableTheSketches) {
+    for (const char* value : {"1024,300", "1024,0", "-1,4", "wide,4", "0,4"}) {
+        {
+            std::ofstream ini_file("pairs_range_config.ini", std::ios::trunc);
+            ini_file << "[model]\n";
+            ini_file << "filepath = ./,./\n";
+            ini_file << "fresh_start = true\n";
+            ini_file << "CLASS_PAIRS = " << value << "\n";
+        }
+        ModelProfile profile("pairs_model", "pairs_range_config.ini", 1, 3);
+        EXPECT_EQ(profile.confusion_pairs_, nullptr) << value;
+        EXPECT_EQ(profile.cooccurring_pairs_, nullptr) << value;
+    }
+    std::remove("pairs_range_config.ini");
+}
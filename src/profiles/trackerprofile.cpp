@@ -48,9 +48,9 @@ void TrackerProfile::cleanup() {
 // Register Model embeddings saver
 void TrackerProfile::registerStatistics() {
     try {
-        saver->AddObjectToSave((void*)(&confidence_sketch_), KLL_TYPE, statSavepath + "track_confidence.bin");
-        saver->AddObjectToSave((void*)(&track_length_sketch_), KLL_TYPE, statSavepath + "track_length.bin");
-        saver->AddObjectToSave((void*)(&iou_sketch_), KLL_TYPE, statSavepath + "track_iou.bin");
+        saver->AddObjectToSave(&confidence_sketch_, statSavepath + "track_confidence.bin");
+        saver->AddObjectToSave(&track_length_sketch_, statSavepath + "track_length.bin");
+        saver->AddObjectToSave(&iou_sketch_, statSavepath + "track_iou.bin");
     } catch (const std::exception& e) {
         std::cerr << "Failed to register statistics: " << e.what() << std::endl;
         throw;  // Re-throw exception to signal failure in initialization
@@ -67,7 +67,7 @@ void TrackerProfile::log_detection_confidence(float confidence) {
 
 void TrackerProfile::log_track_length(int length) {
     try {
-        track_length_sketch_.update(length);
+        track_length_sketch_.update(static_cast<float>(length));
     } catch (const std::exception& e) {
         std::cerr << "Error logging track length: " << e.what() << std::endl;
     }
@@ -9,7 +9,18 @@
 
 // Initialize the logger and sketches
 TrackingProfile::TrackingProfile(std::string conf_path, int save_interval) 
-    : saver(nullptr){  // Initialize saver to nullptr for safety
+    : saver(nullptr),  // Initialize saver to nullptr for safety
+      confidence_sketch_(200, arenaAllocator("TrackingProfile")),
+      track_length_sketch_(200, arenaAllocator("TrackingProfile")),
+      iou_sketch_(200, arenaAllocator("TrackingProfile")),
+      positionError_sketch(200, arenaAllocator("TrackingProfile")),
+      orientationError_sketch(200, arenaAllocator("TrackingProfile")),
+      angularVelocityLatency_sketch(200, arenaAllocator("TrackingProfile")),
+      covarianceSpread_sketch(200, arenaAllocator("TrackingProfile")),
+      angularDivergence_sketch(200, arenaAllocator("TrackingProfile")),
+      anomalousRotation_sketch(200, arenaAllocator("TrackingProfile")),
+      quaternionDrift_sketch(200, arenaAllocator("TrackingProfile")) {
+    SketchArena::instance().configure(conf_path);
     try {
         // Initialize saver
         saver = new Saver(save_interval, "TrackingProfile");
@@ -25,6 +36,18 @@ TrackingProfile::TrackingProfile(std::string conf_path, int save_interval)
         statSavepath = trackerConfig["filepath"][0];
         createFolder(statSavepath);
 
+        saver->Configure(trackerConfig, statSavepath);
+
+        // Optional sliding window of all sketches
+        const SketchWindow window = SketchWindow::fromConfig(trackerConfig["window"]);
+        for (ShardedSketch* sketch : {&confidence_sketch_, &track_length_sketch_, &iou_sketch_,
+                                      &positionError_sketch, &orientationError_sketch,
+                                      &angularVelocityLatency_sketch, &covarianceSpread_sketch,
+                                      &angularDivergence_sketch, &anomalousRotation_sketch,
+                                      &quaternionDrift_sketch}) {
+            sketch->set_window(window);
+        }
+
         // Register statistics for saving
         registerStatistics(trackerConfig);
 
@@ -53,34 +76,37 @@ void TrackingProfile::cleanup() {
 void TrackingProfile::registerStatistics(std::map<std::string, std::vector<std::string>> trackerConfig){
     try {
 	if (trackerConfig["DETECTION_CONFIDENCE"][0] == "true"){ 
-	    saver->AddObjectToSave((void*)(&confidence_sketch_), KLL_TYPE, statSavepath + "track_confidence.bin");
+	    saver->AddObjectToSave(&confidence_sketch_, statSavepath + "track_confidence.bin");
 	}
         if (trackerConfig["TRACK_LENGTH"][0] == "true"){ 
-	    saver->AddObjectToSave((void*)(&track_length_sketch_), KLL_TYPE, statSavepath + "track_length.bin");
+	    saver->AddObjectToSave(&track_length_sketch_, statSavepath + "track_length.bin");
 	}
 	if (trackerConfig["TRACK_IOU"][0] == "true"){
-	   saver->AddObjectToSave((void*)(&iou_sketch_), KLL_TYPE, statSavepath + "track_iou.bin");
+	   saver->AddObjectToSave(&iou_sketch_, statSavepath + "track_iou.bin");
 	}
 	if (trackerConfig["POSITION_ERROR"][0] == "true"){ 
-	    saver->AddObjectToSave((void*)(&positionError_sketch), KLL_TYPE, statSavepath + "position_error.bin");
+	    saver->AddObjectToSave(&positionError_sketch, statSavepath + "position_error.bin");
 	}
         if (trackerConfig["ORIENTATION_ERROR"][0] == "true"){
-	    saver->AddObjectToSave((void*)(&orientationError_sketch), KLL_TYPE, statSavepath + "orientation_error.bin");
+	    saver->AddObjectToSave(&orientationError_sketch, statSavepath + "orientation_error.bin");
 	}
 	if (trackerConfig["ANGULAR_VELOCITY_LATENCY"][0] == "true"){
-	   saver->AddObjectToSave((void*)(&angularVelocityLatency_sketch), KLL_TYPE, statSavepath + "angular_velocity_latency.bin");
+	   saver->AddObjectToSave(&angularVelocityLatency_sketch, statSavepath + "angular_velocity_latency.bin");
 	}
 	if (trackerConfig["COVARIANCE_SPREAD"][0] == "true"){ 
-	   saver->AddObjectToSave((void*)(&covarianceSpread_sketch), KLL_TYPE, statSavepath + "covariance_spread.bin");
+	   saver->AddObjectToSave(&covarianceSpread_sketch, statSavepath + "covariance_spread.bin");
 	}
         if (trackerConfig["ANGULAR_DIVERGENCE"][0] == "true"){
-	   saver->AddObjectToSave((void*)(&angularDivergence_sketch), KLL_TYPE, statSavepath + "angular_divergence.bin");
+	   saver->AddObjectToSave(&angularDivergence_sketch, statSavepath + "angular_divergence.bin");
 	}
 	if (trackerConfig["ANOMALOUS_ROTATION"][0] == "true"){ 
-	   saver->AddObjectToSave((void*)(&anomalousRotation_sketch), KLL_TYPE, statSavepath + "anomalous_rotation.bin");
+	   saver->AddObjectToSave(&anomalousRotation_sketch, statSavepath + "anomalous_rotation.bin");
 	}
         if (trackerConfig["QUATERNION_DRIFT"][0] == "true"){
-	   saver->AddObjectToSave((void*)(&quaternionDrift_sketch), KLL_TYPE, statSavepath + "quaternion_drift.bin");
+	   saver->AddObjectToSave(&quaternionDrift_sketch, statSavepath + "quaternion_drift.bin");
+        }
+        if (!trackerConfig["DISTINCT_TRACKS"].empty() && trackerConfig["DISTINCT_TRACKS"][0] == "true"){
+	   saver->AddObjectToSave(&trackIds_sketch, statSavepath + "distinct_tracks.bin");
         }
     } catch (const std::exception& e) {
         std::cerr << "Failed to register statistics: " << e.what() << std::endl;
@@ -112,6 +138,10 @@ void TrackingProfile::log_iou(float iou) {
     }
 }
 
+void TrackingProfile::log_track_id(uint64_t track_id) {
+    trackIds_sketch.update(track_id);
+}
+
 // Update Position Sketches (2D and 3D)
 void TrackingProfile::log_position_error(float position_error){ 
     try {	
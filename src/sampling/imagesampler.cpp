@@ -23,7 +23,12 @@ ImageSampler::~ImageSampler() {
    * @param saver Saver object for saving sampling statistics
    */
 ImageSampler::ImageSampler(const std::string& conf_path, int save_interval, const std::string& model_type)
-    : saver(new Saver(save_interval, "ImageSampler")) {
+    : marginConfidenceBox(200, arenaAllocator("ImageSampler")),
+      leastConfidenceBox(200, arenaAllocator("ImageSampler")),
+      ratioConfidenceBox(200, arenaAllocator("ImageSampler")),
+      entropyConfidenceBox(200, arenaAllocator("ImageSampler")),
+      saver(new Saver(save_interval, "ImageSampler")) {
+    SketchArena::instance().configure(conf_path);
     try {
         // Read configuration settings
         IniParser parser;
@@ -32,6 +37,12 @@ ImageSampler::ImageSampler(const std::string& conf_path, int save_interval, cons
         dataSavepath = samplingConfig["filepath"][1];
         createFolderIfNotExists(statSavepath, dataSavepath);
         samplingConfig.erase("filepath");
+        const SketchWindow window = SketchWindow::fromConfig(samplingConfig["window"]);
+        samplingConfig.erase("window");
+        saver->Configure(samplingConfig, statSavepath);
+        for (ShardedSketch* box : {&marginConfidenceBox, &leastConfidenceBox, &ratioConfidenceBox, &entropyConfidenceBox}) {
+            box->set_window(window);
+        }
 	this->model_type = model_type;
 
         // Register sampling statistics for saving based on configuration
@@ -40,7 +51,7 @@ ImageSampler::ImageSampler(const std::string& conf_path, int save_interval, cons
         }
 
         saver->StartSaving();
-    } catch (const std::runtime_error& e) {
+    } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
 }
@@ -169,13 +180,13 @@ int ImageSampler::sample(const void* raw_output, cv::Mat& img, bool save_sample)
    */
    void ImageSampler::registerStatistics(const std::string& name) {
     if (name == "MARGINCONFIDENCE") {
-        saver->AddObjectToSave((void*)(&marginConfidenceBox), KLL_TYPE, statSavepath + "marginconfidence.bin");
+        saver->AddObjectToSave(&marginConfidenceBox, statSavepath + "marginconfidence.bin");
     } else if (name == "LEASTCONFIDENCE") {
-        saver->AddObjectToSave((void*)(&leastConfidenceBox), KLL_TYPE, statSavepath + "leastconfidence.bin");
+        saver->AddObjectToSave(&leastConfidenceBox, statSavepath + "leastconfidence.bin");
     } else if (name == "RATIOCONFIDENCE") {
-        saver->AddObjectToSave((void*)(&ratioConfidenceBox), KLL_TYPE, statSavepath + "ratioconfidence.bin");
+        saver->AddObjectToSave(&ratioConfidenceBox, statSavepath + "ratioconfidence.bin");
     } else if (name == "ENTROPYCONFIDENCE") {
-        saver->AddObjectToSave((void*)(&entropyConfidenceBox), KLL_TYPE, statSavepath + "entropyconfidence.bin");
+        saver->AddObjectToSave(&entropyConfidenceBox, statSavepath + "entropyconfidence.bin");
     }
 }
 
@@ -23,6 +23,7 @@ protected:
         std::ofstream ini_file(filename, std::ios::trunc);
         ini_file << "[sampling]\n";
         ini_file << "filepath = ./state/,./data/\n";
+        ini_file << "fresh_start = true\n";  // Independent of the files of earlier tests
         ini_file << "MARGINCONFIDENCE = 0.1\n";  // Sample threshold for margin confidence
         ini_file << "LEASTCONFIDENCE = 0.2\n";
         ini_file << "RATIOCONFIDENCE = 0.3\n";
@@ -0,0 +1,246 @@
+/**
+ * @file countminsketch.cpp
+ * @brief Implements the CountMinSketch class
+ */
+
+#include "countminsketch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <common_defs.hpp>
+#include <MurmurHash3.h>
+
+static constexpr uint32_t MIN_WIDTH = 16;
+
+static uint32_t saturating_add(uint32_t a, uint64_t b) {
+    const uint64_t sum = a + b;
+    return sum > std::numeric_limits<uint32_t>::max() ? std::numeric_limits<uint32_t>::max()
+                                                      : static_cast<uint32_t>(sum);
+}
+
+CountMinSketch::CountMinSketch(uint32_t width, uint8_t depth, uint32_t max_candidates,
+                               const ArenaAllocator<uint32_t>& allocator)
+    : width_(MIN_WIDTH), depth_(depth), max_candidates_(max_candidates), total_weight_(0),
+      counters_(allocator), candidate_floor_(0) {
+    if (depth < 1 || depth > MAX_DEPTH) {
+        throw std::invalid_argument("CountMinSketch: depth must be in [1, " + std::to_string(MAX_DEPTH) + "]");
+    }
+    if (width > MAX_WIDTH) {
+        throw std::invalid_argument("CountMinSketch: width must be at most " + std::to_string(MAX_WIDTH));
+    }
+    while (width_ < width) width_ <<= 1;
+    counters_.assign(static_cast<size_t>(depth_) * width_, 0);
+}
+
+CountMinSketch::CountMinSketch(const CountMinSketch& other)
+    : width_(other.width_), depth_(other.depth_), max_candidates_(other.max_candidates_),
+      counters_(other.counters_.get_allocator()) {
+    std::lock_guard<std::mutex> lock(other.mutex_);
+    total_weight_ = other.total_weight_;
+    counters_ = other.counters_;
+    candidates_ = other.candidates_;
+    candidate_floor_ = other.candidate_floor_;
+}
+
+void CountMinSketch::locate(uint64_t key, uint32_t* indices) const {
+    HashState hash;
+    MurmurHash3_x64_128(&key, sizeof(key), datasketches::DEFAULT_SEED, hash);
+    // An odd step visits every column of a power of two row
+    const uint64_t step = hash.h2 | 1;
+    const uint64_t mask = width_ - 1;
+    for (uint8_t row = 0; row < depth_; ++row) {
+        indices[row] = row * width_ + static_cast<uint32_t>((hash.h1 + row * step) & mask);
+    }
+}
+
+uint32_t CountMinSketch::estimate_locked(const uint32_t* indices) const {
+    uint32_t estimate = std::numeric_limits<uint32_t>::max();
+    for (uint8_t row = 0; row < depth_; ++row) {
+        estimate = std::min(estimate, counters_[indices[row]]);
+    }
+    return estimate;
+}
+
+/**
+ * @brief Adds weight occurrences of a key
+ *
+ * The hash is computed before taking the lock. Conservative update: the new
+ * estimate is the current minimum plus the weight, and no counter is raised
+ * above it, so counters already holding more from collisions stay unchanged.
+ */
+void CountMinSketch::update(uint64_t key, uint32_t weight) {
+    if (weight == 0) return;
+    uint32_t indices[MAX_DEPTH];
+    locate(key, indices);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint32_t estimate = saturating_add(estimate_locked(indices), weight);
+    for (uint8_t row = 0; row < depth_; ++row) {
+        uint32_t& counter = counters_[indices[row]];
+        counter = std::max(counter, estimate);
+    }
+    total_weight_ += weight;
+    offer_candidate(key, estimate);
+}
+
+void CountMinSketch::offer_candidate(uint64_t key, uint32_t estimate) {
+    if (max_candidates_ == 0) return;
+    auto it = candidates_.find(key);
+    if (it != candidates_.end()) {
+        // Estimates only grow, the floor stays a lower bound
+        it->second = std::max(it->second, estimate);
+        return;
+    }
+    if (candidates_.size() < max_candidates_) {
+        candidates_.emplace(key, estimate);
+    } else {
+        if (estimate <= candidate_floor_) return;
+        auto smallest = std::min_element(candidates_.begin(), candidates_.end(),
+            [](const std::pair<const uint64_t, uint32_t>& a, const std::pair<const uint64_t, uint32_t>& b) {
+                return a.second < b.second;
+            });
+        if (estimate <= smallest->second) {
+            candidate_floor_ = smallest->second;
+            return;
+        }
+        candidates_.erase(smallest);
+        candidates_.emplace(key, estimate);
+    }
+    if (candidates_.size() == max_candidates_) {
+        candidate_floor_ = std::numeric_limits<uint32_t>::max();
+        for (const auto& candidate : candidates_) {
+            candidate_floor_ = std::min(candidate_floor_, candidate.second);
+        }
+    }
+}
+
+/**
+ * @brief Merges a sketch with the same width and depth
+ *
+ * The counters add up, which keeps the estimates upper bounds of the merged
+ * counts. The candidates of both sketches compete for the slots with their
+ * estimates in the merged table.
+ */
+void CountMinSketch::merge(const CountMinSketch& other) {
+    if (other.width_ != width_ || other.depth_ != depth_) {
+        throw std::invalid_argument("CountMinSketch: cannot merge sketches with a different width or depth");
+    }
+    // Copy the other sketch first, the two locks are never held together
+    std::vector<uint32_t> other_counters;
+    std::vector<uint64_t> other_keys;
+    uint64_t other_weight;
+    {
+        std::lock_guard<std::mutex> lock(other.mutex_);
+        other_counters.assign(other.counters_.begin(), other.counters_.end());
+        other_weight = other.total_weight_;
+        other_keys.reserve(other.candidates_.size());
+        for (const auto& candidate : other.candidates_) {
+            other_keys.push_back(candidate.first);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < counters_.size(); ++i) {
+        counters_[i] = saturating_add(counters_[i], other_counters[i]);
+    }
+    total_weight_ += other_weight;
+
+    uint32_t indices[MAX_DEPTH];
+    candidate_floor_ = 0;
+    for (auto& candidate : candidates_) {
+        locate(candidate.first, indices);
+        candidate.second = estimate_locked(indices);
+    }
+    for (uint64_t key : other_keys) {
+        locate(key, indices);
+        offer_candidate(key, estimate_locked(indices));
+    }
+}
+
+uint64_t CountMinSketch::get_estimate(uint64_t key) const {
+    uint32_t indices[MAX_DEPTH];
+    locate(key, indices);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return estimate_locked(indices);
+}
+
+std::vector<CountMinSketch::heavy_hitter> CountMinSketch::get_heavy_hitters(uint64_t min_count) const {
+    std::vector<heavy_hitter> result;
+    uint32_t indices[MAX_DEPTH];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& candidate : candidates_) {
+            locate(candidate.first, indices);
+            const uint64_t estimate = estimate_locked(indices);
+            if (estimate >= min_count) {
+                result.emplace_back(candidate.first, estimate);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const heavy_hitter& a, const heavy_hitter& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return result;
+}
+
+uint64_t CountMinSketch::get_total_weight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_weight_;
+}
+
+double CountMinSketch::get_relative_error() const {
+    return std::exp(1.0) / width_;
+}
+
+/*
+ * Serialized layout:
+ *   u8 serial version, u8 family, u8 depth, u8 unused, u32 width,
+ *   u32 max candidates, u64 total weight, u32 counters (depth x width),
+ *   u32 number of candidates, then u64 key per candidate
+ */
+void CountMinSketch::serialize(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    datasketches::write(os, SERIAL_VERSION);
+    datasketches::write(os, FAMILY);
+    datasketches::write(os, depth_);
+    datasketches::write(os, static_cast<uint8_t>(0));
+    datasketches::write(os, width_);
+    datasketches::write(os, max_candidates_);
+    datasketches::write(os, total_weight_);
+    datasketches::write(os, counters_.data(), counters_.size() * sizeof(uint32_t));
+    datasketches::write(os, static_cast<uint32_t>(candidates_.size()));
+    for (const auto& candidate : candidates_) {
+        datasketches::write(os, candidate.first);
+    }
+}
+
+CountMinSketch CountMinSketch::deserialize(std::istream& is, const ArenaAllocator<uint32_t>& allocator) {
+    const auto serial_version = datasketches::read<uint8_t>(is);
+    const auto family = datasketches::read<uint8_t>(is);
+    const auto depth = datasketches::read<uint8_t>(is);
+    datasketches::read<uint8_t>(is);
+    const auto width = datasketches::read<uint32_t>(is);
+    if (serial_version != SERIAL_VERSION || family != FAMILY || depth < 1 || depth > MAX_DEPTH ||
+        width < MIN_WIDTH || width > MAX_WIDTH || (width & (width - 1)) != 0) {
+        throw std::invalid_argument("CountMinSketch: invalid serial version, family or layout");
+    }
+    const auto max_candidates = datasketches::read<uint32_t>(is);
+    CountMinSketch sketch(width, depth, max_candidates, allocator);
+    sketch.total_weight_ = datasketches::read<uint64_t>(is);
+    datasketches::read(is, sketch.counters_.data(), sketch.counters_.size() * sizeof(uint32_t));
+    const auto num_candidates = datasketches::read<uint32_t>(is);
+    if (!is.good() || num_candidates > max_candidates) {
+        throw std::runtime_error("CountMinSketch: error reading counters");
+    }
+    uint32_t indices[MAX_DEPTH];
+    for (uint32_t i = 0; i < num_candidates; ++i) {
+        const auto key = datasketches::read<uint64_t>(is);
+        sketch.locate(key, indices);
+        sketch.offer_candidate(key, sketch.estimate_locked(indices));
+    }
+    if (!is.good()) {
+        throw std::runtime_error("CountMinSketch: error reading candidates");
+    }
+    return sketch;
+}
@@ -0,0 +1,302 @@
+/**
+ * @file embeddingstats.cpp
+ * @brief Implements the EmbeddingStats class for per-dimension embedding statistics
+ */
+
+#include "embeddingstats.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <Eigen/Dense>
+
+using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/**
+ * @brief Constructor to initialize EmbeddingStats object
+ * @param dims Number of dimensions of every embedding
+ * @param sketch_dims Dimensions which additionally get a KLL sketch
+ * @param rank Number of rows kept by the covariance summary (0 disables it)
+ * @param k KLL sketch parameter for the per-dimension sketches
+ */
+EmbeddingStats::EmbeddingStats(uint32_t dims, const std::vector<uint32_t>& sketch_dims,
+                               uint32_t rank, uint16_t k)
+    : dims_(dims), rank_(rank), k_(k), n_(0), mean_(dims, 0.0), m2_(dims, 0.0),
+      fd_buffer_(static_cast<size_t>(2) * rank * dims, 0.0f), rows_(0) {
+    if (dims == 0) {
+        throw std::invalid_argument("EmbeddingStats: number of dimensions must be positive");
+    }
+    for (const auto dim : sketch_dims) {
+        if (dim >= dims) {
+            throw std::out_of_range("EmbeddingStats: sketch dimension " + std::to_string(dim) +
+                                    " out of range for " + std::to_string(dims) + " dimensions");
+        }
+        if (sketches_.find(dim) == sketches_.end()) {
+            sketches_[dim] = new ShardedSketch(k);
+        }
+    }
+}
+
+EmbeddingStats::EmbeddingStats(const EmbeddingStats& other)
+    : dims_(other.dims_), rank_(other.rank_), k_(other.k_) {
+    std::lock_guard<std::mutex> lock(other.mutex_);
+    n_ = other.n_;
+    mean_ = other.mean_;
+    m2_ = other.m2_;
+    fd_buffer_ = other.fd_buffer_;
+    rows_ = other.rows_;
+    for (const auto& pair : other.sketches_) {
+        sketches_[pair.first] = new ShardedSketch(k_);
+        sketches_[pair.first]->restore(pair.second->get_merged());
+    }
+}
+
+EmbeddingStats::~EmbeddingStats() {
+    for (const auto& pair : sketches_) {
+        delete pair.second;
+    }
+}
+
+/**
+ * @brief Updates all statistics with one embedding
+ *
+ * The Welford update is written as two Eigen array expressions so it runs on
+ * SIMD packets on every target Eigen supports (SSE/AVX, NEON):
+ *   m2   += (x - mean)^2 * (n - 1) / n
+ *   mean += (x - mean) / n
+ */
+void EmbeddingStats::update(const float* embedding) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++n_;
+    const double inv_n = 1.0 / static_cast<double>(n_);
+
+    Eigen::Map<const Eigen::ArrayXf> x(embedding, dims_);
+    Eigen::Map<Eigen::ArrayXd> mean(mean_.data(), dims_);
+    Eigen::Map<Eigen::ArrayXd> m2(m2_.data(), dims_);
+    m2 += (x.cast<double>() - mean).square() * (1.0 - inv_n);
+    mean += (x.cast<double>() - mean) * inv_n;
+
+    for (const auto& pair : sketches_) {
+        pair.second->update(embedding[pair.first]);
+    }
+
+    if (rank_ > 0) {
+        append_row(embedding);
+    }
+}
+
+/**
+ * @brief Merges another summary of the same dimensionality into this one
+ *
+ * Mean and variance are combined with the parallel algorithm of Chan et al.,
+ * the covariance rows are streamed into this Frequent Directions buffer.
+ * The other summary is copied first, the two locks are never held together.
+ */
+void EmbeddingStats::merge(const EmbeddingStats& other) {
+    if (other.dims_ != dims_) {
+        throw std::invalid_argument("EmbeddingStats: cannot merge " + std::to_string(other.dims_) +
+                                    " dimensions into " + std::to_string(dims_));
+    }
+    const EmbeddingStats snapshot(other);
+    if (snapshot.n_ == 0) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (n_ == 0) {
+        mean_ = snapshot.mean_;
+        m2_ = snapshot.m2_;
+    } else {
+        const double na = static_cast<double>(n_);
+        const double nb = static_cast<double>(snapshot.n_);
+        const double n = na + nb;
+        Eigen::Map<Eigen::ArrayXd> mean(mean_.data(), dims_);
+        Eigen::Map<Eigen::ArrayXd> m2(m2_.data(), dims_);
+        Eigen::Map<const Eigen::ArrayXd> other_mean(snapshot.mean_.data(), dims_);
+        Eigen::Map<const Eigen::ArrayXd> other_m2(snapshot.m2_.data(), dims_);
+        m2 += other_m2 + (other_mean - mean).square() * (na * nb / n);
+        mean += (other_mean - mean) * (nb / n);
+    }
+    n_ += snapshot.n_;
+
+    // The merged sketch of the other summary is added as a shard of this one
+    for (const auto& pair : snapshot.sketches_) {
+        auto it = sketches_.find(pair.first);
+        if (it == sketches_.end()) {
+            it = sketches_.emplace(pair.first, new ShardedSketch(k_)).first;
+        }
+        it->second->restore(pair.second->get_merged());
+    }
+
+    if (rank_ > 0) {
+        for (uint32_t i = 0; i < snapshot.rows_; ++i) {
+            append_row(&snapshot.fd_buffer_[static_cast<size_t>(i) * dims_]);
+        }
+    }
+}
+
+uint32_t EmbeddingStats::get_dims() const {
+    return dims_;
+}
+
+uint32_t EmbeddingStats::get_rank() const {
+    return rank_;
+}
+
+uint64_t EmbeddingStats::get_n() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return n_;
+}
+
+std::vector<double> EmbeddingStats::get_mean() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mean_;
+}
+
+std::vector<double> EmbeddingStats::get_variance() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<double> variance(dims_, 0.0);
+    if (n_ == 0) return variance;
+    Eigen::Map<Eigen::ArrayXd>(variance.data(), dims_) =
+        Eigen::Map<const Eigen::ArrayXd>(m2_.data(), dims_) / static_cast<double>(n_);
+    return variance;
+}
+
+std::vector<float> EmbeddingStats::get_covariance_sketch() const {
+    EmbeddingStats tmp(dims_, {}, rank_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tmp.fd_buffer_ = fd_buffer_;
+        tmp.rows_ = rows_;
+    }
+    if (tmp.rows_ > rank_) tmp.shrink();
+    return std::vector<float>(tmp.fd_buffer_.begin(),
+                              tmp.fd_buffer_.begin() + static_cast<size_t>(rank_) * dims_);
+}
+
+const std::map<uint32_t, ShardedSketch*>& EmbeddingStats::get_sketches() const {
+    return sketches_;
+}
+
+/**
+ * @brief Appends a row to the Frequent Directions buffer, shrinking it first when full
+ */
+void EmbeddingStats::append_row(const float* row) {
+    if (rows_ == 2 * rank_) {
+        shrink();
+    }
+    std::copy(row, row + dims_, fd_buffer_.begin() + static_cast<size_t>(rows_) * dims_);
+    ++rows_;
+}
+
+/**
+ * @brief Frequent Directions shrink step, reduces the buffer to rank_ rows.
+ *
+ * Works on the small rows_ x rows_ Gram matrix B B^T instead of a full SVD of
+ * B: with B B^T = U diag(s) U^T, the new rows are sqrt(1 - delta / s_i) u_i^T B
+ * where delta is the (rank_ + 1)-th largest eigenvalue.
+ */
+void EmbeddingStats::shrink() {
+    Eigen::Map<RowMatrixXf> buffer(fd_buffer_.data(), 2 * rank_, dims_);
+    const RowMatrixXf b = buffer.topRows(rows_);
+    const Eigen::MatrixXd gram = (b * b.transpose()).cast<double>();
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(gram);
+
+    // eigenvalues are sorted ascending
+    const Eigen::VectorXd& s = solver.eigenvalues();
+    const Eigen::MatrixXd& u = solver.eigenvectors();
+    const uint32_t keep = std::min(rank_, rows_);
+    const double delta = rows_ > rank_ ? std::max(s(rows_ - rank_ - 1), 0.0) : 0.0;
+
+    Eigen::MatrixXf scaled(rows_, keep);
+    for (uint32_t i = 0; i < keep; ++i) {
+        const uint32_t idx = rows_ - 1 - i;
+        const double scale = s(idx) > delta ? std::sqrt(1.0 - delta / s(idx)) : 0.0;
+        scaled.col(i) = (u.col(idx) * scale).cast<float>();
+    }
+    buffer.setZero();
+    buffer.topRows(keep) = scaled.transpose() * b;
+    rows_ = keep;
+}
+
+void EmbeddingStats::serialize(std::ostream& os) const {
+    uint64_t n;
+    std::vector<double> mean, m2;
+    std::vector<float> rows;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        n = n_;
+        mean = mean_;
+        m2 = m2_;
+        rows.assign(fd_buffer_.begin(), fd_buffer_.begin() + static_cast<size_t>(rows_) * dims_);
+    }
+    const uint32_t num_rows = static_cast<uint32_t>(rows.size() / dims_);
+    datasketches::write(os, SERIAL_VERSION);
+    datasketches::write(os, FAMILY);
+    const uint16_t unused = 0;
+    datasketches::write(os, unused);
+    datasketches::write(os, dims_);
+    datasketches::write(os, rank_);
+    datasketches::write(os, n);
+    datasketches::write(os, mean.data(), sizeof(double) * dims_);
+    datasketches::write(os, m2.data(), sizeof(double) * dims_);
+    datasketches::write(os, num_rows);
+    datasketches::write(os, rows.data(), sizeof(float) * rows.size());
+}
+
+// Bytes left in a seekable stream, the maximum when the stream can not seek
+static uint64_t bytes_left(std::istream& is) {
+    const std::streampos pos = is.tellg();
+    if (pos < 0) return std::numeric_limits<uint64_t>::max();
+    is.seekg(0, std::ios::end);
+    const std::streampos end = is.tellg();
+    is.seekg(pos);
+    if (end < pos) return std::numeric_limits<uint64_t>::max();
+    return static_cast<uint64_t>(end - pos);
+}
+
+EmbeddingStats EmbeddingStats::deserialize(std::istream& is) {
+    return deserialize(is, std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max());
+}
+
+EmbeddingStats EmbeddingStats::deserialize(std::istream& is, const EmbeddingStats& configured) {
+    return deserialize(is, configured.dims_, configured.rank_);
+}
+
+/*
+ * dims and rank size the buffers of the summary, so both are checked before
+ * anything is allocated: dims against the configured dimensions and the
+ * bytes of the means and variances still in the stream, rank against the
+ * configured rank.
+ */
+EmbeddingStats EmbeddingStats::deserialize(std::istream& is, uint32_t max_dims, uint32_t max_rank) {
+    const auto serial_version = datasketches::read<uint8_t>(is);
+    const auto family = datasketches::read<uint8_t>(is);
+    datasketches::read<uint16_t>(is); // skip unused bytes
+    if (serial_version != SERIAL_VERSION || family != FAMILY) {
+        throw std::invalid_argument("EmbeddingStats: invalid serial version or family");
+    }
+    const auto dims = datasketches::read<uint32_t>(is);
+    const auto rank = datasketches::read<uint32_t>(is);
+    if (!is.good()) throw std::runtime_error("error reading from std::istream");
+    if (dims > max_dims || rank > max_rank) {
+        throw std::invalid_argument("EmbeddingStats: " + std::to_string(dims) + " dimensions of rank " +
+                                    std::to_string(rank) + " exceed the configured " + std::to_string(max_dims) +
+                                    " dimensions of rank " + std::to_string(max_rank));
+    }
+    const uint64_t available = bytes_left(is);
+    const uint64_t fixed = sizeof(uint64_t) + 2 * sizeof(double) * static_cast<uint64_t>(dims) + sizeof(uint32_t);
+    if (fixed > available) {
+        throw std::invalid_argument("EmbeddingStats: " + std::to_string(dims) + " dimensions exceed the snapshot size");
+    }
+
+    EmbeddingStats stats(dims, {}, rank);
+    stats.n_ = datasketches::read<uint64_t>(is);
+    datasketches::read(is, stats.mean_.data(), sizeof(double) * dims);
+    datasketches::read(is, stats.m2_.data(), sizeof(double) * dims);
+    stats.rows_ = datasketches::read<uint32_t>(is);
+    if (stats.rows_ > 2 * static_cast<uint64_t>(rank) ||
+        sizeof(float) * static_cast<uint64_t>(stats.rows_) * dims > available - fixed) {
+        throw std::invalid_argument("EmbeddingStats: too many covariance rows");
+    }
+    datasketches::read(is, stats.fd_buffer_.data(), sizeof(float) * stats.rows_ * dims);
+    if (!is.good()) throw std::runtime_error("error reading from std::istream");
+    return stats;
+}
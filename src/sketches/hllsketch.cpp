@@ -0,0 +1,184 @@
+/**
+ * @file hllsketch.cpp
+ * @brief Implements the HllSketch class
+ */
+
+#include "hllsketch.h"
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <common_defs.hpp>
+#include <MurmurHash3.h>
+
+HllSketch::HllSketch(uint8_t lg_k) : lg_k_(lg_k), version_(0) {
+    if (lg_k < MIN_LG_K || lg_k > MAX_LG_K) {
+        throw std::invalid_argument("HllSketch: lg_k must be in [" + std::to_string(MIN_LG_K) + ", " +
+                                    std::to_string(MAX_LG_K) + "]");
+    }
+    const uint32_t m = 1u << lg_k_;
+    registers_.reset(new std::atomic<uint8_t>[m]);
+    for (uint32_t i = 0; i < m; ++i) {
+        registers_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+HllSketch::HllSketch(const HllSketch& other) : HllSketch(other.lg_k_) {
+    merge(other);
+    version_.store(other.get_version(), std::memory_order_relaxed);
+}
+
+void HllSketch::update(const void* data, size_t size) {
+    HashState hash;
+    MurmurHash3_x64_128(data, size, datasketches::DEFAULT_SEED, hash);
+    const uint32_t index = static_cast<uint32_t>(hash.h1 & ((1u << lg_k_) - 1));
+    const uint8_t rank = hash.h2 == 0 ? MAX_RANK : static_cast<uint8_t>(__builtin_clzll(hash.h2) + 1);
+    update_register(index, rank);
+}
+
+void HllSketch::update(uint64_t item) {
+    update(&item, sizeof(item));
+}
+
+void HllSketch::update(const std::string& item) {
+    update(item.data(), item.size());
+}
+
+void HllSketch::update_register(uint32_t index, uint8_t rank) {
+    std::atomic<uint8_t>& reg = registers_[index];
+    uint8_t current = reg.load(std::memory_order_relaxed);
+    // Duplicates end here without a write
+    while (rank > current) {
+        if (reg.compare_exchange_weak(current, rank, std::memory_order_relaxed)) {
+            version_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void HllSketch::merge(const HllSketch& other) {
+    if (other.lg_k_ != lg_k_) {
+        throw std::invalid_argument("HllSketch: cannot merge sketches with a different lg_k");
+    }
+    const uint32_t m = 1u << lg_k_;
+    for (uint32_t i = 0; i < m; ++i) {
+        update_register(i, other.registers_[i].load(std::memory_order_relaxed));
+    }
+}
+
+bool HllSketch::is_empty() const {
+    const uint32_t m = 1u << lg_k_;
+    for (uint32_t i = 0; i < m; ++i) {
+        if (registers_[i].load(std::memory_order_relaxed) != 0) return false;
+    }
+    return true;
+}
+
+// sigma and tau of Ertl, "New cardinality estimation algorithms for HyperLogLog sketches"
+static double sigma(double x) {
+    if (x == 1.0) return std::numeric_limits<double>::infinity();
+    double y = 1.0;
+    double z = x;
+    double previous;
+    do {
+        x *= x;
+        previous = z;
+        z += x * y;
+        y += y;
+    } while (z != previous);
+    return z;
+}
+
+static double tau(double x) {
+    if (x == 0.0 || x == 1.0) return 0.0;
+    double y = 1.0;
+    double z = 1.0 - x;
+    double previous;
+    do {
+        x = std::sqrt(x);
+        previous = z;
+        y *= 0.5;
+        z -= (1.0 - x) * (1.0 - x) * y;
+    } while (z != previous);
+    return z / 3.0;
+}
+
+/**
+ * @brief Returns the estimated number of distinct items
+ *
+ * Uses the improved estimator of Ertl on the histogram of the register
+ * values. It corrects both the small range, where many registers are still
+ * zero, and the saturated ones, so there is no switch to linear counting and
+ * no empirical bias table.
+ */
+double HllSketch::get_estimate() const {
+    const uint32_t m = 1u << lg_k_;
+    std::array<uint32_t, MAX_RANK + 1> histogram{};
+    for (uint32_t i = 0; i < m; ++i) {
+        ++histogram[registers_[i].load(std::memory_order_relaxed)];
+    }
+    if (histogram[0] == m) return 0.0;
+
+    const double q = MAX_RANK - 1;
+    double z = m * tau(1.0 - histogram[MAX_RANK] / static_cast<double>(m));
+    for (int rank = static_cast<int>(q); rank >= 1; --rank) {
+        z = 0.5 * (z + histogram[rank]);
+    }
+    z += m * sigma(histogram[0] / static_cast<double>(m));
+    return m / (2.0 * std::log(2.0)) * m / z;
+}
+
+double HllSketch::get_lower_bound(uint8_t num_std_dev) const {
+    const double relative_error = 1.04 / std::sqrt(static_cast<double>(1u << lg_k_));
+    return std::max(0.0, get_estimate() * (1.0 - num_std_dev * relative_error));
+}
+
+double HllSketch::get_upper_bound(uint8_t num_std_dev) const {
+    const double relative_error = 1.04 / std::sqrt(static_cast<double>(1u << lg_k_));
+    return get_estimate() * (1.0 + num_std_dev * relative_error);
+}
+
+/*
+ * Serialized layout:
+ *   u8 serial version, u8 family, u8 lg_k, u8 unused,
+ *   u64 version, then one u8 per register
+ */
+void HllSketch::serialize(std::ostream& os) const {
+    const uint32_t m = 1u << lg_k_;
+    std::unique_ptr<uint8_t[]> snapshot(new uint8_t[m]);
+    for (uint32_t i = 0; i < m; ++i) {
+        snapshot[i] = registers_[i].load(std::memory_order_relaxed);
+    }
+    datasketches::write(os, SERIAL_VERSION);
+    datasketches::write(os, FAMILY);
+    datasketches::write(os, lg_k_);
+    datasketches::write(os, static_cast<uint8_t>(0));
+    datasketches::write(os, get_version());
+    datasketches::write(os, snapshot.get(), m);
+}
+
+HllSketch HllSketch::deserialize(std::istream& is) {
+    const auto serial_version = datasketches::read<uint8_t>(is);
+    const auto family = datasketches::read<uint8_t>(is);
+    const auto lg_k = datasketches::read<uint8_t>(is);
+    datasketches::read<uint8_t>(is);
+    if (serial_version != SERIAL_VERSION || family != FAMILY || lg_k < MIN_LG_K || lg_k > MAX_LG_K) {
+        throw std::invalid_argument("HllSketch: invalid serial version, family or lg_k");
+    }
+    const auto version = datasketches::read<uint64_t>(is);
+    const uint32_t m = 1u << lg_k;
+    std::unique_ptr<uint8_t[]> registers(new uint8_t[m]);
+    datasketches::read(is, registers.get(), m);
+    if (!is.good()) {
+        throw std::runtime_error("HllSketch: error reading registers");
+    }
+    HllSketch sketch(lg_k);
+    for (uint32_t i = 0; i < m; ++i) {
+        if (registers[i] > MAX_RANK) {
+            throw std::runtime_error("HllSketch: register out of range");
+        }
+        sketch.registers_[i].store(registers[i], std::memory_order_relaxed);
+    }
+    sketch.version_.store(version, std::memory_order_relaxed);
+    return sketch;
+}
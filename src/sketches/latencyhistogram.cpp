@@ -0,0 +1,117 @@
+/**
+ * @file latencyhistogram.cpp
+ * @brief Implements the LatencyHistogram class
+ */
+
+#include "latencyhistogram.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <common_defs.hpp>
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+LatencyHistogram::LatencyHistogram(const LatencyHistogram& other) {
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        counts_[i].store(other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        counts_[i].fetch_add(other.counts_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyHistogram::get_n() const {
+    uint64_t n = 0;
+    for (const auto& count : counts_) {
+        n += count.load(std::memory_order_relaxed);
+    }
+    return n;
+}
+
+uint64_t LatencyHistogram::bucket_lower_bound(uint32_t index) {
+    if (index < SUB_BUCKETS) return index;
+    const uint32_t shift = index / SUB_BUCKETS - 1;
+    return static_cast<uint64_t>(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::bucket_width(uint32_t index) {
+    if (index < SUB_BUCKETS) return 1;
+    return static_cast<uint64_t>(1) << (index / SUB_BUCKETS - 1);
+}
+
+double LatencyHistogram::get_quantile(double rank) const {
+    if (rank < 0.0 || rank > 1.0) {
+        throw std::invalid_argument("LatencyHistogram: rank must be in [0, 1]");
+    }
+    // Work on a snapshot so concurrent records cannot move the target
+    std::array<uint64_t, NUM_BUCKETS> snapshot;
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        snapshot[i] = counts_[i].load(std::memory_order_relaxed);
+        n += snapshot[i];
+    }
+    if (n == 0) return 0.0;
+
+    const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(rank * n)));
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        cumulative += snapshot[i];
+        if (cumulative >= target) {
+            return (bucket_lower_bound(i) + (bucket_width(i) - 1) / 2.0) / 1000.0;
+        }
+    }
+    return bucket_lower_bound(NUM_BUCKETS - 1) / 1000.0;
+}
+
+/*
+ * Serialized layout:
+ *   u8 serial version, u8 family, u8 sub bucket bits, u8 max value bits,
+ *   u32 number of non-empty buckets, then (u32 index, u64 count) per bucket
+ */
+void LatencyHistogram::serialize(std::ostream& os) const {
+    std::array<uint64_t, NUM_BUCKETS> snapshot;
+    uint32_t non_empty = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        snapshot[i] = counts_[i].load(std::memory_order_relaxed);
+        if (snapshot[i] > 0) ++non_empty;
+    }
+    datasketches::write(os, SERIAL_VERSION);
+    datasketches::write(os, FAMILY);
+    datasketches::write(os, static_cast<uint8_t>(SUB_BUCKET_BITS));
+    datasketches::write(os, static_cast<uint8_t>(MAX_VALUE_BITS));
+    datasketches::write(os, non_empty);
+    for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+        if (snapshot[i] == 0) continue;
+        datasketches::write(os, i);
+        datasketches::write(os, snapshot[i]);
+    }
+}
+
+LatencyHistogram LatencyHistogram::deserialize(std::istream& is) {
+    const auto serial_version = datasketches::read<uint8_t>(is);
+    const auto family = datasketches::read<uint8_t>(is);
+    const auto sub_bucket_bits = datasketches::read<uint8_t>(is);
+    const auto max_value_bits = datasketches::read<uint8_t>(is);
+    if (serial_version != SERIAL_VERSION || family != FAMILY ||
+        sub_bucket_bits != SUB_BUCKET_BITS || max_value_bits != MAX_VALUE_BITS) {
+        throw std::invalid_argument("LatencyHistogram: invalid serial version, family or layout");
+    }
+    const auto non_empty = datasketches::read<uint32_t>(is);
+    LatencyHistogram histogram;
+    for (uint32_t i = 0; i < non_empty; ++i) {
+        const auto index = datasketches::read<uint32_t>(is);
+        const auto count = datasketches::read<uint64_t>(is);
+        if (!is.good() || index >= NUM_BUCKETS) {
+            throw std::runtime_error("LatencyHistogram: error reading buckets");
+        }
+        histogram.counts_[index].store(count, std::memory_order_relaxed);
+    }
+    return histogram;
+}
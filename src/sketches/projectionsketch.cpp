@@ -0,0 +1,213 @@
+/**
+ * @file projectionsketch.cpp
+ * @brief Implements the ProjectionSketch class for on-device embedding drift
+ */
+
+#include "projectionsketch.h"
+#include "driftmetrics.h"
+#include "datatracer_log.h"
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <Eigen/Dense>
+
+using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/**
+ * @brief Constructor to initialize ProjectionSketch object
+ *
+ * The projection matrix has +-1/sqrt(dims) entries (Achlioptas). The signs are
+ * taken from the bits of std::mt19937_64, whose output is fully specified by
+ * the standard, so the same seed gives the same matrix on every device and in
+ * the baseline tooling.
+ */
+ProjectionSketch::ProjectionSketch(uint32_t dims, uint16_t projections, uint64_t seed, uint16_t k)
+    : dims_(dims), projections_(projections), seed_(seed), n_(0),
+      matrix_(static_cast<size_t>(projections) * dims),
+      sketches_(projections, distributionBox(k)),
+      drift_score_(std::numeric_limits<double>::quiet_NaN()) {
+    if (dims == 0 || projections == 0) {
+        throw std::invalid_argument("ProjectionSketch: dimensions and projections must be positive");
+    }
+    std::mt19937_64 gen(seed);
+    const float scale = 1.0f / std::sqrt(static_cast<float>(dims));
+    uint64_t bits = 0;
+    for (size_t i = 0; i < matrix_.size(); ++i) {
+        if (i % 64 == 0) bits = gen();
+        matrix_[i] = (bits & 1) ? scale : -scale;
+        bits >>= 1;
+    }
+}
+
+ProjectionSketch::ProjectionSketch(const ProjectionSketch& other)
+    : dims_(other.dims_), projections_(other.projections_), seed_(other.seed_),
+      matrix_(other.matrix_), drift_score_(other.drift_score_.load()) {
+    std::lock_guard<std::mutex> lock(other.mutex_);
+    n_ = other.n_;
+    sketches_ = other.sketches_;
+    baseline_ = other.baseline_;
+}
+
+/**
+ * @brief Blocked projection of a batch of embeddings, out = X * R^T.
+ *
+ * Eigen's GEMM kernel tiles the product into cache blocks and uses SIMD
+ * packets on every target it supports, batching several embeddings amortizes
+ * the reads of the projection matrix.
+ */
+void ProjectionSketch::project(const float* embeddings, size_t count, float* out) const {
+    Eigen::Map<const RowMatrixXf> x(embeddings, count, dims_);
+    Eigen::Map<const RowMatrixXf> r(matrix_.data(), projections_, dims_);
+    Eigen::Map<RowMatrixXf> y(out, count, projections_);
+    y.noalias() = x * r.transpose();
+}
+
+// The batch is projected into a thread local buffer before the lock is taken
+void ProjectionSketch::update(const float* embeddings, size_t count) {
+    thread_local std::vector<float> scratch;
+    scratch.resize(count * projections_);
+    project(embeddings, count, scratch.data());
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t row = 0; row < count; ++row) {
+        const float* projected = &scratch[row * projections_];
+        for (uint16_t p = 0; p < projections_; ++p) {
+            sketches_[p].update(projected[p]);
+        }
+    }
+    n_ += count;
+}
+
+void ProjectionSketch::merge(const ProjectionSketch& other) {
+    if (other.dims_ != dims_ || other.projections_ != projections_ || other.seed_ != seed_) {
+        throw std::invalid_argument("ProjectionSketch: cannot merge sketches with different projections");
+    }
+    // Copy the other sketch first, the two locks are never held together
+    std::vector<distributionBox> sketches;
+    const uint64_t n = other.snapshot(sketches);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint16_t p = 0; p < projections_; ++p) {
+        sketches_[p].merge(sketches[p]);
+    }
+    n_ += n;
+}
+
+bool ProjectionSketch::load_baseline(const std::string& path) {
+    std::ifstream is(path, std::ios::binary);
+    if (!is.is_open()) {
+        log_err << "ProjectionSketch: cannot open baseline " << path << std::endl;
+        return false;
+    }
+    try {
+        ProjectionSketch baseline = deserialize(is);
+        if (baseline.dims_ != dims_ || baseline.projections_ != projections_ || baseline.seed_ != seed_) {
+            log_err << "ProjectionSketch: baseline " << path << " uses different projections" << std::endl;
+            return false;
+        }
+        auto sketches = std::make_shared<const std::vector<distributionBox>>(std::move(baseline.sketches_));
+        std::lock_guard<std::mutex> lock(mutex_);
+        baseline_ = std::move(sketches);
+    } catch (const std::exception& e) {
+        log_err << "ProjectionSketch: invalid baseline " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t ProjectionSketch::snapshot(std::vector<distributionBox>& sketches) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sketches = sketches_;
+    return n_;
+}
+
+double ProjectionSketch::drift_score(const std::vector<distributionBox>& sketches, uint64_t n) const {
+    std::shared_ptr<const std::vector<distributionBox>> baseline;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        baseline = baseline_;
+    }
+    if (baseline == nullptr || n == 0) return std::numeric_limits<double>::quiet_NaN();
+    double sum = 0.0;
+    for (uint16_t p = 0; p < projections_; ++p) {
+        sum += DriftMetrics::computeEnergyDistance(sketches[p], (*baseline)[p]);
+    }
+    return sum / projections_;
+}
+
+double ProjectionSketch::compute_drift_score() const {
+    std::vector<distributionBox> sketches;
+    const uint64_t n = snapshot(sketches);
+    const double score = drift_score(sketches, n);
+    drift_score_.store(score);
+    return score;
+}
+
+double ProjectionSketch::get_drift_score() const {
+    return drift_score_.load();
+}
+
+uint32_t ProjectionSketch::get_dims() const {
+    return dims_;
+}
+
+uint16_t ProjectionSketch::get_projections() const {
+    return projections_;
+}
+
+uint64_t ProjectionSketch::get_seed() const {
+    return seed_;
+}
+
+uint64_t ProjectionSketch::get_n() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return n_;
+}
+
+std::vector<distributionBox> ProjectionSketch::get_sketches() const {
+    std::vector<distributionBox> sketches;
+    snapshot(sketches);
+    return sketches;
+}
+
+bool ProjectionSketch::has_baseline() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return baseline_ != nullptr;
+}
+
+void ProjectionSketch::serialize(std::ostream& os) const {
+    std::vector<distributionBox> sketches;
+    const uint64_t n = snapshot(sketches);
+    const double score = drift_score(sketches, n);
+    drift_score_.store(score);
+    datasketches::write(os, SERIAL_VERSION);
+    datasketches::write(os, FAMILY);
+    datasketches::write(os, projections_);
+    datasketches::write(os, dims_);
+    datasketches::write(os, seed_);
+    datasketches::write(os, n);
+    datasketches::write(os, score);
+    for (const auto& sketch : sketches) {
+        sketch.serialize(os);
+    }
+}
+
+ProjectionSketch ProjectionSketch::deserialize(std::istream& is) {
+    const auto serial_version = datasketches::read<uint8_t>(is);
+    const auto family = datasketches::read<uint8_t>(is);
+    if (serial_version != SERIAL_VERSION || family != FAMILY) {
+        throw std::invalid_argument("ProjectionSketch: invalid serial version or family");
+    }
+    const auto projections = datasketches::read<uint16_t>(is);
+    const auto dims = datasketches::read<uint32_t>(is);
+    const auto seed = datasketches::read<uint64_t>(is);
+    if (!is.good()) throw std::runtime_error("error reading from std::istream");
+
+    ProjectionSketch sketch(dims, projections, seed);
+    sketch.n_ = datasketches::read<uint64_t>(is);
+    sketch.drift_score_.store(datasketches::read<double>(is));
+    for (uint16_t p = 0; p < projections; ++p) {
+        sketch.sketches_[p] = distributionBox::deserialize(is);
+    }
+    return sketch;
+}
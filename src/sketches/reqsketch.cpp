@@ -0,0 +1,315 @@
+/**
+ * @file reqsketch.cpp
+ * @brief Implements the ReqSketch class, a relative-error quantile sketch
+ */
+
+#include "reqsketch.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <common_defs.hpp>
+#include <count_zeros.hpp>
+
+static uint32_t nearestEven(float value) {
+    return static_cast<uint32_t>(std::round(value / 2.0f)) * 2;
+}
+
+ReqSketch::Compactor::Compactor(uint8_t lg_weight, uint16_t k, const ArenaAllocator<float>& allocator)
+    : lg_weight(lg_weight), coin(false), num_sorted(0), num_sections(INIT_NUM_SECTIONS), section_size(k),
+      section_size_raw(static_cast<float>(k)), state(0), items(allocator) {}
+
+void ReqSketch::Compactor::sort() {
+    if (is_sorted()) return;
+    // the unsorted tail is only what arrived since the last compaction
+    std::sort(items.begin() + num_sorted, items.end());
+    std::inplace_merge(items.begin(), items.begin() + num_sorted, items.end());
+    num_sorted = static_cast<uint32_t>(items.size());
+}
+
+void ReqSketch::Compactor::reserve(size_t n) {
+    if (n > items.capacity()) {
+        items.reserve(std::max<size_t>(n + section_size, nom_capacity()));
+    }
+}
+
+/**
+ * @brief Doubles the sections once the compaction counter needs more of them
+ *
+ * The counter selects up to all sections, so after 2^(num_sections - 1)
+ * compactions the level gets twice the sections, each 1/sqrt(2) the size.
+ * Sections never get smaller than MIN_K.
+ */
+bool ReqSketch::Compactor::ensure_enough_sections() {
+    const float raw = section_size_raw / static_cast<float>(M_SQRT2);
+    const uint32_t size = nearestEven(raw);
+    if (num_sections <= 64 && state >= (1ULL << (num_sections - 1)) && size >= MIN_K) {
+        section_size_raw = raw;
+        section_size = size;
+        num_sections *= 2;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Halves the lower sections into next
+ *
+ * The first half of the nominal capacity is never compacted, of the other
+ * half the compaction takes 1 + (trailing ones of the counter) sections. In
+ * high rank accuracy mode these are the smallest items, so the largest ones
+ * keep their weight. Every other item of the compacted range goes to the next
+ * level, starting at a random offset on every other compaction and at the
+ * opposite offset of the previous compaction in between.
+ */
+int64_t ReqSketch::Compactor::compact(Compactor& next, bool hra) {
+    sort();
+    const uint32_t starting_capacity = nom_capacity();
+    const uint32_t trailing_ones = datasketches::count_trailing_zeros_in_u64(~state);
+    const uint32_t sections = std::min<uint32_t>(trailing_ones + 1, num_sections);
+    const uint32_t size = static_cast<uint32_t>(items.size());
+    uint32_t non_compact = nom_capacity() / 2 + (num_sections - sections) * section_size;
+    // the compacted range has an even length
+    if (((size - non_compact) & 1) == 1) ++non_compact;
+    const uint32_t first = hra ? 0 : non_compact;
+    const uint32_t last = hra ? size - non_compact : size;
+
+    if ((state & 1) == 1) {
+        coin = !coin;
+    } else {
+        coin = datasketches::random_utils::random_bit() != 0;
+    }
+
+    // merge every other item of the range into next from the back, next grows in place
+    const uint32_t offset = coin ? 1 : 0;
+    uint32_t remaining = (last - first) / 2;
+    size_t kept = next.items.size();
+    size_t out = kept + remaining;
+    next.reserve(out);
+    next.items.resize(out);
+    while (remaining > 0) {
+        const float promoted = items[first + offset + 2 * (remaining - 1)];
+        if (kept > 0 && promoted < next.items[kept - 1]) {
+            next.items[--out] = next.items[--kept];
+        } else {
+            next.items[--out] = promoted;
+            --remaining;
+        }
+    }
+    next.num_sorted = static_cast<uint32_t>(next.items.size());
+    items.erase(items.begin() + first, items.begin() + last);
+    num_sorted = static_cast<uint32_t>(items.size());
+
+    ++state;
+    ensure_enough_sections();
+    return static_cast<int64_t>(nom_capacity()) - starting_capacity;
+}
+
+ReqSketch::ReqSketch(uint16_t k, const ArenaAllocator<float>& allocator, bool hra)
+    : k_(std::max<uint16_t>(MIN_K, k & ~1)), hra_(hra), allocator_(allocator), n_(0), num_retained_(0),
+      max_nom_size_(0), min_item_(0), max_item_(0), compactors_(allocator) {
+    grow();
+}
+
+void ReqSketch::grow() {
+    compactors_.emplace_back(static_cast<uint8_t>(compactors_.size()), k_, allocator_);
+    max_nom_size_ += compactors_.back().nom_capacity();
+}
+
+/**
+ * @brief Compacts every level that reached its nominal capacity, bottom up
+ *
+ * Compression is lazy: it stops as soon as the sketch holds less than the sum
+ * of the nominal capacities, a level may stay above its own capacity as long
+ * as other levels have room.
+ */
+void ReqSketch::compress() {
+    for (size_t h = 0; h < compactors_.size(); ++h) {
+        if (compactors_[h].items.size() < compactors_[h].nom_capacity()) continue;
+        if (h + 1 >= compactors_.size()) grow();
+        Compactor& current = compactors_[h];
+        Compactor& next = compactors_[h + 1];
+        const size_t before = current.items.size() + next.items.size();
+        max_nom_size_ += current.compact(next, hra_);
+        num_retained_ -= static_cast<uint32_t>(before - current.items.size() - next.items.size());
+        if (num_retained_ < max_nom_size_) break;
+    }
+}
+
+void ReqSketch::update(float item) {
+    if (std::isnan(item)) return;
+    if (n_ == 0) {
+        min_item_ = item;
+        max_item_ = item;
+    } else {
+        min_item_ = std::min(min_item_, item);
+        max_item_ = std::max(max_item_, item);
+    }
+    Compactor& level0 = compactors_[0];
+    level0.reserve(level0.items.size() + 1);
+    level0.items.push_back(item);
+    ++num_retained_;
+    ++n_;
+    if (num_retained_ >= max_nom_size_) compress();
+}
+
+void ReqSketch::update(const float* first, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        update(first[i]);
+    }
+}
+
+/**
+ * @brief Merges another sketch into this one
+ *
+ * Levels are merged pairwise. The compaction counters are or-ed, so a level
+ * keeps at least as many sections as either input had, then the sketch is
+ * compressed back into its nominal size.
+ */
+void ReqSketch::merge(const ReqSketch& other) {
+    if (other.is_empty()) return;
+    if (other.hra_ != hra_) {
+        throw std::invalid_argument("ReqSketch: cannot merge sketches of different accuracy modes");
+    }
+    if (is_empty()) {
+        min_item_ = other.min_item_;
+        max_item_ = other.max_item_;
+    } else {
+        min_item_ = std::min(min_item_, other.min_item_);
+        max_item_ = std::max(max_item_, other.max_item_);
+    }
+    n_ += other.n_;
+
+    while (compactors_.size() < other.compactors_.size()) grow();
+    for (size_t h = 0; h < other.compactors_.size(); ++h) {
+        Compactor& current = compactors_[h];
+        const Compactor& incoming = other.compactors_[h];
+        current.state |= incoming.state;
+        while (current.ensure_enough_sections()) {}
+        const bool sorted = current.is_sorted() && incoming.is_sorted();
+        current.reserve(current.items.size() + incoming.items.size());
+        current.items.insert(current.items.end(), incoming.items.begin(), incoming.items.end());
+        if (sorted) {
+            std::inplace_merge(current.items.begin(), current.items.begin() + current.num_sorted, current.items.end());
+            current.num_sorted = static_cast<uint32_t>(current.items.size());
+        }
+    }
+
+    num_retained_ = 0;
+    max_nom_size_ = 0;
+    for (const auto& compactor : compactors_) {
+        num_retained_ += static_cast<uint32_t>(compactor.items.size());
+        max_nom_size_ += compactor.nom_capacity();
+    }
+    while (num_retained_ >= max_nom_size_) compress();
+}
+
+float ReqSketch::get_min_item() const {
+    if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+    return min_item_;
+}
+
+float ReqSketch::get_max_item() const {
+    if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+    return max_item_;
+}
+
+ReqSketch::sorted_view ReqSketch::get_sorted_view() const {
+    // like kll_sketch, sorting level 0 is an allowed side effect
+    const_cast<ReqSketch*>(this)->compactors_[0].sort();
+    sorted_view view(num_retained_, std::less<float>(), allocator_);
+    for (const auto& compactor : compactors_) {
+        view.add(compactor.items.begin(), compactor.items.end(), 1ULL << compactor.lg_weight);
+    }
+    view.convert_to_cummulative();
+    return view;
+}
+
+double ReqSketch::get_rank(float item, bool inclusive) const {
+    if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+    return get_sorted_view().get_rank(item, inclusive);
+}
+
+float ReqSketch::get_quantile(double rank, bool inclusive) const {
+    if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+    if ((rank < 0.0) || (rank > 1.0)) {
+        throw std::invalid_argument("normalized rank cannot be less than zero or greater than 1.0");
+    }
+    // the exact extremes are known, the view only holds retained items
+    if (rank == 0.0) return min_item_;
+    if (rank == 1.0) return max_item_;
+    return get_sorted_view().get_quantile(rank, inclusive);
+}
+
+/*
+ * Serialized layout:
+ *   u8 serial version, u8 family, u8 hra, u8 number of levels, u16 k,
+ *   u64 n, f32 min, f32 max, then per level:
+ *   u64 state, f32 raw section size, u32 section size, u32 sections,
+ *   u8 coin, u8 sorted, u32 number of items, f32 items
+ */
+void ReqSketch::serialize(std::ostream& os) const {
+    datasketches::write(os, SERIAL_VERSION);
+    datasketches::write(os, FAMILY);
+    datasketches::write(os, static_cast<uint8_t>(hra_));
+    datasketches::write(os, static_cast<uint8_t>(compactors_.size()));
+    datasketches::write(os, k_);
+    datasketches::write(os, n_);
+    datasketches::write(os, min_item_);
+    datasketches::write(os, max_item_);
+    for (const auto& compactor : compactors_) {
+        datasketches::write(os, compactor.state);
+        datasketches::write(os, compactor.section_size_raw);
+        datasketches::write(os, compactor.section_size);
+        datasketches::write(os, static_cast<uint32_t>(compactor.num_sections));
+        datasketches::write(os, static_cast<uint8_t>(compactor.coin));
+        datasketches::write(os, static_cast<uint8_t>(compactor.is_sorted()));
+        datasketches::write(os, static_cast<uint32_t>(compactor.items.size()));
+        datasketches::write(os, compactor.items.data(), compactor.items.size() * sizeof(float));
+    }
+}
+
+ReqSketch ReqSketch::deserialize(std::istream& is, const ArenaAllocator<float>& allocator) {
+    const auto serial_version = datasketches::read<uint8_t>(is);
+    const auto family = datasketches::read<uint8_t>(is);
+    if (serial_version != SERIAL_VERSION || family != FAMILY) {
+        throw std::invalid_argument("ReqSketch: invalid serial version or family");
+    }
+    const auto hra = datasketches::read<uint8_t>(is);
+    const auto num_levels = datasketches::read<uint8_t>(is);
+    const auto k = datasketches::read<uint16_t>(is);
+    if (num_levels == 0 || k < MIN_K || (k & 1) == 1) {
+        throw std::invalid_argument("ReqSketch: invalid k or number of levels");
+    }
+    ReqSketch sketch(k, allocator, hra != 0);
+    sketch.n_ = datasketches::read<uint64_t>(is);
+    sketch.min_item_ = datasketches::read<float>(is);
+    sketch.max_item_ = datasketches::read<float>(is);
+    sketch.compactors_.clear();
+    sketch.max_nom_size_ = 0;
+
+    uint64_t total_weight = 0;
+    for (uint8_t level = 0; level < num_levels; ++level) {
+        Compactor compactor(level, k, allocator);
+        compactor.state = datasketches::read<uint64_t>(is);
+        compactor.section_size_raw = datasketches::read<float>(is);
+        compactor.section_size = datasketches::read<uint32_t>(is);
+        compactor.num_sections = datasketches::read<uint32_t>(is);
+        compactor.coin = datasketches::read<uint8_t>(is) != 0;
+        const bool sorted = datasketches::read<uint8_t>(is) != 0;
+        const auto num_items = datasketches::read<uint32_t>(is);
+        if (!is.good() || compactor.section_size < MIN_K || compactor.num_sections == 0 || num_items > sketch.n_) {
+            throw std::runtime_error("ReqSketch: error reading level " + std::to_string(level));
+        }
+        compactor.items.resize(num_items);
+        datasketches::read(is, compactor.items.data(), num_items * sizeof(float));
+        compactor.num_sorted = sorted ? num_items : 0;
+        total_weight += static_cast<uint64_t>(num_items) << level;
+        sketch.num_retained_ += num_items;
+        sketch.max_nom_size_ += compactor.nom_capacity();
+        sketch.compactors_.push_back(std::move(compactor));
+    }
+    if (!is.good() || total_weight != sketch.n_) {
+        throw std::runtime_error("ReqSketch: corrupted levels");
+    }
+    return sketch;
+}
@@ -0,0 +1,286 @@
+/**
+ * @file shardedsketch.cpp
+ * @brief Implements the BasicShardedSketch class, a sketch with per-thread shards
+ */
+
+#include "shardedsketch.h"
+#include <chrono>
+#include <iterator>
+
+template <typename Sketch>
+std::atomic<uint64_t> BasicShardedSketch<Sketch>::next_id_(0);
+
+SketchWindow SketchWindow::fromConfig(const std::vector<std::string>& value) {
+    SketchWindow window;
+    if (value.size() < 2) {
+        return window;
+    }
+    try {
+        window.intervals = static_cast<uint32_t>(std::stoul(value[0]));
+        window.interval_seconds = static_cast<uint32_t>(std::stoul(value[1]));
+    } catch (const std::exception& e) {
+        return SketchWindow();
+    }
+    return window;
+}
+
+template <typename Sketch>
+BasicShardedSketch<Sketch>::BasicShardedSketch(uint16_t k, const ArenaAllocator<float>& allocator, const SketchWindow& window)
+    : k_(k), allocator_(allocator), window_(window.enabled() ? window : SketchWindow()),
+      clock_(&BasicShardedSketch::steady_seconds), id_(next_id_.fetch_add(1, std::memory_order_relaxed)),
+      retired_updates_(0), anchor_(std::make_shared<Anchor>()),
+      cached_(SketchTraits<Sketch>::make(k, allocator)), cached_epoch_(0), cache_valid_(false) {
+    anchor_->owner = this;
+}
+
+// Threads exiting from now on skip the shards of this sketch
+template <typename Sketch>
+BasicShardedSketch<Sketch>::~BasicShardedSketch() {
+    std::lock_guard<std::mutex> lock(anchor_->mutex);
+    anchor_->owner = nullptr;
+}
+
+template <typename Sketch>
+bool BasicShardedSketch<Sketch>::set_window(const SketchWindow& window) {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    if (!shards_.empty() || !retired_.empty()) {
+        return false;
+    }
+    window_ = window.enabled() ? window : SketchWindow();
+    cache_valid_ = false;
+    return true;
+}
+
+template <typename Sketch>
+uint64_t BasicShardedSketch<Sketch>::steady_seconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename Sketch>
+uint64_t BasicShardedSketch<Sketch>::current_epoch() const {
+    if (!window_.enabled()) return 0;
+    return clock_() / window_.interval_seconds;
+}
+
+template <typename Sketch>
+Sketch BasicShardedSketch<Sketch>::empty_sketch() const {
+    return SketchTraits<Sketch>::make(k_, allocator_);
+}
+
+template <typename Sketch>
+typename BasicShardedSketch<Sketch>::Ring BasicShardedSketch<Sketch>::make_ring() const {
+    return Ring(window_.enabled() ? window_.intervals : 1, Bucket{current_epoch(), std::nullopt});
+}
+
+/**
+ * @brief Returns the bucket of the current interval in the ring
+ *
+ * A bucket still holding an interval that left the window is reset in place,
+ * its memory goes back to the arena and is reused by the new interval.
+ */
+template <typename Sketch>
+typename BasicShardedSketch<Sketch>::Bucket& BasicShardedSketch<Sketch>::current_bucket(Ring& ring) const {
+    const uint64_t epoch = current_epoch();
+    Bucket& bucket = ring[epoch % ring.size()];
+    if (bucket.epoch != epoch) {
+        bucket.sketch.reset();
+        bucket.epoch = epoch;
+    }
+    return bucket;
+}
+
+template <typename Sketch>
+Sketch& BasicShardedSketch<Sketch>::current_sketch(Ring& ring) const {
+    Bucket& bucket = current_bucket(ring);
+    if (!bucket.sketch) {
+        bucket.sketch.emplace(empty_sketch());
+    }
+    return *bucket.sketch;
+}
+
+/**
+ * @brief Returns the shard of the calling thread, creating it on first use
+ *
+ * Every thread caches its shards in a thread local map keyed by the sketch id,
+ * the shared shard list is only locked when a thread updates a sketch for the
+ * first time. The entries of destroyed sketches are dropped then too.
+ */
+template <typename Sketch>
+typename BasicShardedSketch<Sketch>::Shard* BasicShardedSketch<Sketch>::local_shard() {
+    thread_local ThreadShards thread_shards;
+    auto it = thread_shards.entries.find(id_);
+    if (it != thread_shards.entries.end()) {
+        return it->second.shard;
+    }
+
+    for (auto entry = thread_shards.entries.begin(); entry != thread_shards.entries.end();) {
+        entry = entry->second.anchor.expired() ? thread_shards.entries.erase(entry) : std::next(entry);
+    }
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    shards_.emplace_back(new Shard(make_ring()));
+    Shard* shard = shards_.back().get();
+    thread_shards.entries.emplace(id_, typename ThreadShards::Entry{anchor_, shard});
+    return shard;
+}
+
+template <typename Sketch>
+BasicShardedSketch<Sketch>::ThreadShards::~ThreadShards() {
+    for (auto& entry : entries) {
+        std::shared_ptr<Anchor> anchor = entry.second.anchor.lock();
+        if (!anchor) continue;
+        std::lock_guard<std::mutex> lock(anchor->mutex);
+        if (anchor->owner != nullptr) {
+            anchor->owner->retire(entry.second.shard);
+        }
+    }
+}
+
+/**
+ * @brief Folds a bucket into the bucket of the same slot of another ring
+ *
+ * A newer interval replaces an older one, the same interval is merged and an
+ * older one has left the window. The first fold into an empty bucket moves
+ * the sketch instead of merging it, so a sketch only updated by one thread
+ * serializes to exactly the bytes of a plain sketch fed with the same values.
+ */
+template <typename Sketch>
+bool BasicShardedSketch<Sketch>::fold(Bucket& into, Bucket& from) const {
+    if (from.empty()) return false;
+    if (into.empty() || from.epoch > into.epoch) {
+        std::swap(into, from);
+    } else if (from.epoch == into.epoch) {
+        into.sketch->merge(*from.sketch);
+    }
+    from.sketch.reset();
+    return true;
+}
+
+template <typename Sketch>
+bool BasicShardedSketch<Sketch>::drain(Shard& shard) const {
+    bool changed = false;
+    shard.live.drain([this, &shard, &changed](Ring& retired) {
+        for (size_t i = 0; i < retired.size(); ++i) {
+            changed |= fold(shard.total[i], retired[i]);
+        }
+    });
+    return changed;
+}
+
+template <typename Sketch>
+void BasicShardedSketch<Sketch>::retire(Shard* shard) {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    drain(*shard);
+    if (retired_.empty()) {
+        retired_ = make_ring();
+    }
+    for (size_t i = 0; i < retired_.size(); ++i) {
+        fold(retired_[i], shard->total[i]);
+    }
+    retired_updates_ += shard->updates.load(std::memory_order_acquire);
+    for (auto it = shards_.begin(); it != shards_.end(); ++it) {
+        if (it->get() == shard) {
+            shards_.erase(it);
+            break;
+        }
+    }
+    cache_valid_ = false;
+}
+
+template <typename Sketch>
+void BasicShardedSketch<Sketch>::update(float item) {
+    Shard* shard = local_shard();
+    shard->live.write([this, item](Ring& ring) { current_sketch(ring).update(item); });
+    shard->updates.store(shard->updates.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template <typename Sketch>
+void BasicShardedSketch<Sketch>::update(const float* first, size_t n) {
+    Shard* shard = local_shard();
+    shard->live.write([this, first, n](Ring& ring) { current_sketch(ring).update(first, n); });
+    shard->updates.store(shard->updates.load(std::memory_order_relaxed) + n, std::memory_order_release);
+}
+
+/**
+ * @brief Merges all shards into a single sketch
+ *
+ * The live ring of every shard is drained bucket by bucket into its
+ * accumulated ring first, then the accumulated rings and the retired ring
+ * are merged.
+ *
+ * The buckets of the window are only merged again when a drain brought new
+ * updates or the window moved to the next interval, otherwise the cached
+ * result is returned.
+ */
+template <typename Sketch>
+Sketch BasicShardedSketch<Sketch>::get_merged() const {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    bool changed = false;
+    for (const auto& shard : shards_) {
+        changed |= drain(*shard);
+    }
+
+    const uint64_t epoch = current_epoch();
+    if (cache_valid_ && !changed && cached_epoch_ == epoch) {
+        return cached_;
+    }
+
+    // Buckets of the last `intervals` intervals, all of them for a cumulative sketch
+    const uint64_t window_size = window_.enabled() ? window_.intervals : 1;
+    bool first = true;
+    cached_ = empty_sketch();
+    auto add = [this, &first, epoch, window_size](const Ring& ring) {
+        for (const Bucket& bucket : ring) {
+            if (bucket.empty() || bucket.epoch + window_size <= epoch) continue;
+            if (first) {
+                cached_ = *bucket.sketch;
+                first = false;
+            } else {
+                cached_.merge(*bucket.sketch);
+            }
+        }
+    };
+    add(retired_);
+    for (const auto& shard : shards_) {
+        add(shard->total);
+    }
+    cached_epoch_ = epoch;
+    cache_valid_ = true;
+    return cached_;
+}
+
+template <typename Sketch>
+uint64_t BasicShardedSketch<Sketch>::get_version() const {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    uint64_t version = current_epoch() + retired_updates_;
+    for (const auto& shard : shards_) {
+        version += shard->updates.load(std::memory_order_acquire);
+    }
+    return version;
+}
+
+template <typename Sketch>
+size_t BasicShardedSketch<Sketch>::get_num_shards() const {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    return shards_.size();
+}
+
+template <typename Sketch>
+void BasicShardedSketch<Sketch>::serialize(std::ostream& os) const {
+    get_merged().serialize(os);
+}
+
+// The snapshot belongs to no thread, it goes to the retired ring
+template <typename Sketch>
+void BasicShardedSketch<Sketch>::restore(const Sketch& snapshot) {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+    if (retired_.empty()) {
+        retired_ = make_ring();
+    }
+    current_sketch(retired_).merge(snapshot);
+    retired_updates_ += snapshot.get_n();
+    cache_valid_ = false;
+}
+
+template class BasicShardedSketch<distributionBox>;
+template class BasicShardedSketch<ReqSketch>;
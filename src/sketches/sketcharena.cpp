@@ -0,0 +1,211 @@
+/**
+ * @file sketcharena.cpp
+ * @brief Implements the SketchArena block pool used by distributionBox
+ */
+
+#include "sketcharena.h"
+#include "datatracer_log.h"
+#include "iniparser.h"
+#include <algorithm>
+#include <limits>
+#include <new>
+
+SketchArena::Account::Account(const Account& other)
+    : name(other.name), bytes_in_use(other.bytes_in_use.load()), peak_bytes(other.peak_bytes.load()),
+      allocations(other.allocations.load()), heap_allocations(other.heap_allocations.load()) {}
+
+SketchArena::SketchArena()
+    : region_(nullptr), capacity_(0), offset_(0) {
+    free_lists_.fill(nullptr);
+    accounts_.emplace_back(new Account());
+    accounts_.back()->name = "default";
+    default_account_ = accounts_.back().get();
+}
+
+/**
+ * @brief Returns the process-wide arena
+ *
+ * The arena is never destroyed, so sketches with static storage duration can
+ * still free their memory during process exit.
+ */
+SketchArena& SketchArena::instance() {
+    static SketchArena* arena = new SketchArena();
+    return *arena;
+}
+
+bool SketchArena::reserve(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (region_.load() != nullptr || bytes == 0) {
+        return false;
+    }
+    char* region = static_cast<char*>(::operator new(bytes, std::nothrow));
+    if (region == nullptr) {
+        log_err << "SketchArena: cannot reserve " << bytes << " bytes" << std::endl;
+        return false;
+    }
+    capacity_.store(bytes);
+    region_.store(region, std::memory_order_release);
+    return true;
+}
+
+bool SketchArena::configure(const std::string& conf_path) {
+    auto config = IniParser::parseIniFile(conf_path, "generic", "sketch_arena_kb");
+    if (config["sketch_arena_kb"].empty()) {
+        return false;
+    }
+    const std::string& value = config["sketch_arena_kb"][0];
+    size_t parsed = 0;
+    unsigned long long budget_kb = 0;
+    try {
+        budget_kb = std::stoull(value, &parsed);
+    } catch (const std::exception& e) {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != value.size() || value[0] == '-' ||
+        budget_kb > std::numeric_limits<size_t>::max() / 1024) {
+        log_err << "SketchArena: sketch_arena_kb must be a size in KB, got " << value << std::endl;
+        return false;
+    }
+    const size_t bytes = budget_kb * 1024;
+    if (reserve(bytes)) {
+        log_info << "SketchArena: reserved " << budget_kb << " KB from " << conf_path << std::endl;
+        return true;
+    }
+    // Every profile passes its config, the first one with a budget reserves the arena
+    const size_t capacity = get_capacity();
+    if (capacity != 0 && capacity != bytes) {
+        log_err << "SketchArena: ignoring sketch_arena_kb = " << budget_kb << " of " << conf_path
+                << ", the arena already has " << capacity / 1024 << " KB" << std::endl;
+    }
+    return false;
+}
+
+SketchArena::Account* SketchArena::account(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& account : accounts_) {
+        if (account->name == name) return account.get();
+    }
+    accounts_.emplace_back(new Account());
+    accounts_.back()->name = name;
+    return accounts_.back().get();
+}
+
+SketchArena::Account* SketchArena::default_account() const {
+    return default_account_;
+}
+
+/**
+ * @brief Returns the index of the smallest power of two block holding bytes
+ */
+uint32_t SketchArena::size_class(size_t bytes) {
+    if (bytes <= MIN_BLOCK_SIZE) return 0;
+    return 64 - __builtin_clzll(static_cast<unsigned long long>(bytes - 1)) - 4;
+}
+
+void* SketchArena::pop_free(uint32_t index) {
+    std::lock_guard<std::mutex> lock(free_list_mutexes_[index]);
+    void* ptr = free_lists_[index];
+    if (ptr != nullptr) {
+        free_lists_[index] = *static_cast<void**>(ptr);
+    }
+    return ptr;
+}
+
+void* SketchArena::bump(size_t block_size) {
+    char* region = region_.load(std::memory_order_acquire);
+    if (region == nullptr) return nullptr;
+    const size_t capacity = capacity_.load(std::memory_order_relaxed);
+    size_t offset = offset_.load(std::memory_order_relaxed);
+    do {
+        if (capacity - offset < block_size) return nullptr;
+    } while (!offset_.compare_exchange_weak(offset, offset + block_size, std::memory_order_relaxed));
+    return region + offset;
+}
+
+void SketchArena::charge(Account* account, int64_t bytes) {
+    const int64_t in_use = account->bytes_in_use.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t peak = account->peak_bytes.load(std::memory_order_relaxed);
+    while (in_use > peak && !account->peak_bytes.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Allocates a block from the free list of its size, then from the unused
+ * part of the arena and only then from the heap. Requests above the largest
+ * size class always go to the heap and are charged with their own size.
+ */
+void* SketchArena::allocate(size_t bytes, Account* account) {
+    const uint32_t index = size_class(bytes);
+    const size_t block_size = index < NUM_SIZE_CLASSES ? MIN_BLOCK_SIZE << index : bytes;
+    void* ptr = nullptr;
+    if (index < NUM_SIZE_CLASSES) {
+        ptr = pop_free(index);
+        if (ptr == nullptr) ptr = bump(block_size);
+    }
+    if (ptr == nullptr) {
+        ptr = ::operator new(bytes);
+        account->heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    account->allocations.fetch_add(1, std::memory_order_relaxed);
+    charge(account, static_cast<int64_t>(block_size));
+    return ptr;
+}
+
+void SketchArena::deallocate(void* ptr, size_t bytes, Account* account) {
+    if (ptr == nullptr) return;
+    const uint32_t index = size_class(bytes);
+    const size_t block_size = index < NUM_SIZE_CLASSES ? MIN_BLOCK_SIZE << index : bytes;
+    account->bytes_in_use.fetch_sub(static_cast<int64_t>(block_size), std::memory_order_relaxed);
+
+    const char* region = region_.load(std::memory_order_acquire);
+    const char* block = static_cast<char*>(ptr);
+    if (index < NUM_SIZE_CLASSES && region != nullptr && block >= region && block < region + capacity_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(free_list_mutexes_[index]);
+        *static_cast<void**>(ptr) = free_lists_[index];
+        free_lists_[index] = ptr;
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+size_t SketchArena::get_capacity() const {
+    return capacity_.load();
+}
+
+size_t SketchArena::get_used() const {
+    return offset_.load();
+}
+
+std::vector<SketchArena::Account> SketchArena::get_usage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Account> usage;
+    for (const auto& account : accounts_) {
+        usage.push_back(*account);
+    }
+    return usage;
+}
+
+static void reportAccount(std::ostream& os, const SketchArena::Account& account) {
+    os << account.name << " in_use=" << account.bytes_in_use
+       << " peak=" << account.peak_bytes
+       << " allocations=" << account.allocations
+       << " heap_allocations=" << account.heap_allocations << std::endl;
+}
+
+void SketchArena::report(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os << "arena capacity=" << capacity_.load() << " used=" << offset_.load() << std::endl;
+    for (const auto& account : accounts_) {
+        reportAccount(os, *account);
+    }
+}
+
+void SketchArena::report(std::ostream& os, const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& account : accounts_) {
+        if (account->name == name) {
+            reportAccount(os, *account);
+            return;
+        }
+    }
+}
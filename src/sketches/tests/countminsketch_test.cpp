@@ -0,0 +1,105 @@
+#include "countminsketch.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Zipf-like stream of class pairs over 1000 classes, returns the exact counts
+static std::map<uint64_t, uint64_t> feedPairs(CountMinSketch& sketch, uint32_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<double> weights(1000);
+    for (size_t i = 0; i < weights.size(); ++i) weights[i] = 1.0 / (i + 1);
+    std::discrete_distribution<int> cls(weights.begin(), weights.end());
+    std::map<uint64_t, uint64_t> exact;
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint64_t key = CountMinSketch::pair_key(cls(rng), cls(rng));
+        sketch.update(key);
+        ++exact[key];
+    }
+    return exact;
+}
+
+TEST(CountMinSketchTest, EstimatesNeverUndercount) {
+    CountMinSketch sketch(1024, 4);
+    EXPECT_EQ(sketch.get_width(), 1024u);
+    const std::map<uint64_t, uint64_t> exact = feedPairs(sketch, 200000, 1);
+    EXPECT_EQ(sketch.get_total_weight(), 200000u);
+
+    const double bound = sketch.get_relative_error() * sketch.get_total_weight();
+    size_t within_bound = 0;
+    for (const auto& entry : exact) {
+        const uint64_t estimate = sketch.get_estimate(entry.first);
+        EXPECT_GE(estimate, entry.second);
+        if (estimate - entry.second <= bound) ++within_bound;
+    }
+    // the bound holds with probability 1 - e^-depth per key
+    EXPECT_GE(within_bound, exact.size() * 98 / 100);
+    EXPECT_LE(sketch.get_estimate(CountMinSketch::pair_key(5000, 5001)), bound);
+}
+
+TEST(CountMinSketchTest, HeavyHittersAreTopPairs) {
+    CountMinSketch sketch;
+    const std::map<uint64_t, uint64_t> exact = feedPairs(sketch, 100000, 2);
+    std::vector<std::pair<uint64_t, uint64_t>> sorted(exact.begin(), exact.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint64_t, uint64_t>& a,
+                                               const std::pair<uint64_t, uint64_t>& b) {
+        return a.second > b.second;
+    });
+
+    const auto hitters = sketch.get_heavy_hitters(sorted[9].second);
+    ASSERT_GE(hitters.size(), 10u);
+    for (size_t i = 0; i < 10; ++i) {
+        const bool found = std::any_of(hitters.begin(), hitters.end(), [&](const CountMinSketch::heavy_hitter& h) {
+            return h.first == sorted[i].first;
+        });
+        EXPECT_TRUE(found) << "pair " << i;
+    }
+    EXPECT_EQ(CountMinSketch::pair_classes(sorted[0].first), std::make_pair(0, 0));
+    EXPECT_TRUE(sketch.get_heavy_hitters(1000000).empty());
+}
+
+TEST(CountMinSketchTest, MergeAddsCounts) {
+    CountMinSketch device1, device2;
+    const uint64_t key = CountMinSketch::pair_key(3, 7);
+    for (int i = 0; i < 500; ++i) device1.update(key);
+    device2.update(key, 250);
+    feedPairs(device2, 10000, 3);
+    device1.merge(device2);
+    EXPECT_GE(device1.get_estimate(key), 750u);
+    EXPECT_EQ(device1.get_total_weight(), 10750u);
+    EXPECT_EQ(device1.get_heavy_hitters().front().first, key);
+
+    CountMinSketch narrow(512, 4);
+    EXPECT_THROW(device1.merge(narrow), std::invalid_argument);
+}
+
+TEST(CountMinSketchTest, ConcurrentUpdates) {
+    CountMinSketch sketch;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&sketch]() {
+            for (int i = 0; i < 10000; ++i) sketch.update(CountMinSketch::pair_key(i % 10, 1));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(sketch.get_total_weight(), 40000u);
+    EXPECT_EQ(sketch.get_estimate(CountMinSketch::pair_key(0, 1)), 4000u);
+}
+
+TEST(CountMinSketchTest, SerializeRoundTrip) {
+    CountMinSketch sketch(256, 3, 16);
+    feedPairs(sketch, 20000, 4);
+    std::stringstream ss;
+    sketch.serialize(ss);
+    CountMinSketch restored = CountMinSketch::deserialize(ss);
+    EXPECT_EQ(restored.get_width(), 256u);
+    EXPECT_EQ(restored.get_depth(), 3);
+    EXPECT_EQ(restored.get_total_weight(), sketch.get_total_weight());
+    EXPECT_EQ(restored.get_heavy_hitters(), sketch.get_heavy_hitters());
+
+    std::stringstream garbage("not a sketch");
+    EXPECT_THROW(CountMinSketch::deserialize(garbage), std::invalid_argument);
+}
@@ -0,0 +1,143 @@
+#include "embeddingstats.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Helper to generate embeddings with a known per-dimension mean and spread
+static std::vector<std::vector<float>> makeEmbeddings(size_t count, uint32_t dims, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::vector<std::vector<float>> embeddings(count, std::vector<float>(dims));
+    for (auto& embedding : embeddings) {
+        for (uint32_t d = 0; d < dims; ++d) {
+            std::normal_distribution<float> dist(static_cast<float>(d), 1.0f + d * 0.5f);
+            embedding[d] = dist(gen);
+        }
+    }
+    return embeddings;
+}
+
+TEST(EmbeddingStatsTest, MeanAndVarianceMatchExact) {
+    const uint32_t dims = 7;
+    auto embeddings = makeEmbeddings(500, dims, 1);
+    EmbeddingStats stats(dims);
+    for (const auto& embedding : embeddings) stats.update(embedding.data());
+
+    for (uint32_t d = 0; d < dims; ++d) {
+        double mean = 0.0, var = 0.0;
+        for (const auto& e : embeddings) mean += e[d];
+        mean /= embeddings.size();
+        for (const auto& e : embeddings) var += (e[d] - mean) * (e[d] - mean);
+        var /= embeddings.size();
+        EXPECT_NEAR(stats.get_mean()[d], mean, 1e-6);
+        EXPECT_NEAR(stats.get_variance()[d], var, 1e-4);
+    }
+    EXPECT_EQ(stats.get_n(), 500u);
+}
+
+TEST(EmbeddingStatsTest, MergeEqualsSingleStream) {
+    const uint32_t dims = 5;
+    auto embeddings = makeEmbeddings(400, dims, 2);
+    EmbeddingStats all(dims, {1, 3}, 2);
+    EmbeddingStats first(dims, {1, 3}, 2);
+    EmbeddingStats second(dims, {1, 3}, 2);
+    for (size_t i = 0; i < embeddings.size(); ++i) {
+        all.update(embeddings[i].data());
+        (i < 150 ? first : second).update(embeddings[i].data());
+    }
+    first.merge(second);
+
+    EXPECT_EQ(first.get_n(), all.get_n());
+    for (uint32_t d = 0; d < dims; ++d) {
+        EXPECT_NEAR(first.get_mean()[d], all.get_mean()[d], 1e-9);
+        EXPECT_NEAR(first.get_variance()[d], all.get_variance()[d], 1e-6);
+    }
+    EXPECT_EQ(first.get_sketches().at(3)->get_merged().get_n(), 400u);
+    EXPECT_THROW(first.merge(EmbeddingStats(dims + 1)), std::invalid_argument);
+}
+
+TEST(EmbeddingStatsTest, CovarianceSketchCapturesDominantDirection) {
+    const uint32_t dims = 4;
+    std::mt19937 gen(3);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    EmbeddingStats stats(dims, {}, 2);
+    for (int i = 0; i < 1000; ++i) {
+        // energy concentrated along (1, 1, 0, 0)
+        float a = dist(gen) * 10.0f;
+        std::vector<float> e = {a + dist(gen) * 0.1f, a + dist(gen) * 0.1f, dist(gen) * 0.1f, dist(gen) * 0.1f};
+        stats.update(e.data());
+    }
+    auto b = stats.get_covariance_sketch();
+    ASSERT_EQ(b.size(), 2u * dims);
+    // Top row should point along (1, 1, 0, 0)
+    float norm = std::sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+    EXPECT_NEAR(std::fabs(b[0] / norm), std::sqrt(0.5f), 0.05f);
+    EXPECT_NEAR(std::fabs(b[1] / norm), std::sqrt(0.5f), 0.05f);
+    // ||b0||^2 approximates the energy along that direction, about 2 * 100 * n
+    EXPECT_NEAR(norm * norm / 1000.0f, 200.0f, 40.0f);
+}
+
+TEST(EmbeddingStatsTest, SerializeRoundTrip) {
+    const uint32_t dims = 3;
+    auto embeddings = makeEmbeddings(50, dims, 4);
+    EmbeddingStats stats(dims, {0}, 2);
+    for (const auto& embedding : embeddings) stats.update(embedding.data());
+
+    std::stringstream ss;
+    stats.serialize(ss);
+    EmbeddingStats restored = EmbeddingStats::deserialize(ss);
+    EXPECT_EQ(restored.get_n(), stats.get_n());
+    EXPECT_EQ(restored.get_mean(), stats.get_mean());
+    EXPECT_EQ(restored.get_variance(), stats.get_variance());
+    EXPECT_EQ(restored.get_covariance_sketch(), stats.get_covariance_sketch());
+}
+
+TEST(EmbeddingStatsTest, SerializeWhileUpdating) {
+    const uint32_t dims = 6;
+    auto embeddings = makeEmbeddings(2000, dims, 5);
+    EmbeddingStats stats(dims, {2}, 2);
+    std::thread writer([&]() {
+        for (const auto& embedding : embeddings) stats.update(embedding.data());
+    });
+    uint64_t last_n = 0;
+    for (int i = 0; i < 50; ++i) {
+        std::stringstream ss;
+        stats.serialize(ss);
+        EmbeddingStats restored = EmbeddingStats::deserialize(ss);
+        EXPECT_GE(restored.get_n(), last_n);
+        last_n = restored.get_n();
+    }
+    writer.join();
+    EXPECT_EQ(stats.get_n(), 2000u);
+    EXPECT_EQ(stats.get_sketches().at(2)->get_merged().get_n(), 2000u);
+}
+
+TEST(EmbeddingStatsTest, DeserializeRejectsOversizedHeader) {
+    EmbeddingStats stats(4, {}, 2);
+    stats.update(makeEmbeddings(1, 4, 6)[0].data());
+    std::stringstream ss;
+    stats.serialize(ss);
+    const std::string bytes = ss.str();
+
+    // dims of 2^30 would need 16 GB of means and variances, the stream has a few bytes
+    std::string corrupt = bytes;
+    const uint32_t dims = 1u << 30;
+    corrupt.replace(4, sizeof(dims), reinterpret_cast<const char*>(&dims), sizeof(dims));
+    std::stringstream dims_stream(corrupt);
+    EXPECT_THROW(EmbeddingStats::deserialize(dims_stream), std::invalid_argument);
+
+    // A rank above the configured one is rejected before the buffer is sized by it
+    corrupt = bytes;
+    const uint32_t rank = 1u << 30;
+    corrupt.replace(8, sizeof(rank), reinterpret_cast<const char*>(&rank), sizeof(rank));
+    std::stringstream rank_stream(corrupt);
+    EXPECT_THROW(EmbeddingStats::deserialize(rank_stream, stats), std::invalid_argument);
+
+    std::stringstream valid(bytes);
+    EXPECT_EQ(EmbeddingStats::deserialize(valid, stats).get_n(), 1u);
+}
+
+TEST(EmbeddingStatsTest, InvalidSketchDimension) {
+    EXPECT_THROW(EmbeddingStats(3, {3}), std::out_of_range);
+}
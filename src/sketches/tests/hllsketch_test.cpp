@@ -0,0 +1,77 @@
+#include "hllsketch.h"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+TEST(HllSketchTest, EstimatesDistinctItems) {
+    HllSketch sketch;
+    EXPECT_TRUE(sketch.is_empty());
+    EXPECT_EQ(sketch.get_estimate(), 0.0);
+
+    for (uint64_t n : {10ull, 1000ull, 100000ull, 1000000ull}) {
+        HllSketch counter;
+        for (uint64_t i = 0; i < n; ++i) counter.update(i);
+        EXPECT_NEAR(counter.get_estimate(), n, 0.05 * n) << "n " << n;
+        EXPECT_LE(counter.get_lower_bound(3), n);
+        EXPECT_GE(counter.get_upper_bound(3), n);
+    }
+    EXPECT_THROW(HllSketch(3), std::invalid_argument);
+}
+
+TEST(HllSketchTest, DuplicatesKeepVersion) {
+    HllSketch sketch;
+    for (uint64_t i = 0; i < 5000; ++i) sketch.update(std::to_string(i));
+    const uint64_t version = sketch.get_version();
+    const double estimate = sketch.get_estimate();
+    EXPECT_GT(version, 0u);
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        for (uint64_t i = 0; i < 5000; ++i) sketch.update(std::to_string(i));
+    }
+    EXPECT_EQ(sketch.get_version(), version);
+    EXPECT_EQ(sketch.get_estimate(), estimate);
+}
+
+TEST(HllSketchTest, MergeCountsUnion) {
+    HllSketch merged;
+    for (int part = 0; part < 4; ++part) {
+        HllSketch sketch;
+        // overlapping ranges, the union is [0, 250000)
+        for (uint64_t i = part * 50000ull; i < part * 50000ull + 100000; ++i) sketch.update(i);
+        merged.merge(sketch);
+    }
+    EXPECT_NEAR(merged.get_estimate(), 250000, 0.05 * 250000);
+
+    HllSketch smaller(10);
+    EXPECT_THROW(merged.merge(smaller), std::invalid_argument);
+}
+
+TEST(HllSketchTest, ConcurrentUpdates) {
+    HllSketch sketch;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&sketch, t]() {
+            for (uint64_t i = t * 25000; i < (t + 1) * 25000; ++i) sketch.update(i);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    HllSketch serial;
+    for (uint64_t i = 0; i < 100000; ++i) serial.update(i);
+    EXPECT_EQ(sketch.get_estimate(), serial.get_estimate());
+}
+
+TEST(HllSketchTest, SerializeRoundTrip) {
+    HllSketch sketch(10);
+    for (uint64_t i = 0; i < 20000; ++i) sketch.update(i);
+    std::stringstream ss;
+    sketch.serialize(ss);
+    EXPECT_EQ(ss.str().size(), 12u + 1024u);
+    HllSketch restored = HllSketch::deserialize(ss);
+    EXPECT_EQ(restored.get_lg_k(), 10);
+    EXPECT_EQ(restored.get_version(), sketch.get_version());
+    EXPECT_EQ(restored.get_estimate(), sketch.get_estimate());
+
+    std::stringstream garbage("not a sketch");
+    EXPECT_THROW(HllSketch::deserialize(garbage), std::invalid_argument);
+}
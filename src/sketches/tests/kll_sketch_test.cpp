@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <kll_sketch.hpp>
+#include <kll_sketch_view.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+typedef datasketches::kll_sketch<float> distributionBox;
+
+TEST(KllSketchTest, BulkUpdateMatchesSequentialUpdate) {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1000.0f);
+    std::vector<float> values(100000);
+    for (auto& value : values) value = dist(gen);
+
+    distributionBox sequential;
+    for (const auto value : values) sequential.update(value);
+
+    distributionBox bulk;
+    // Uneven batch sizes so batches straddle compactions
+    size_t offset = 0;
+    for (size_t batch = 1; offset < values.size(); batch = batch * 3 + 1) {
+        const size_t n = std::min(batch, values.size() - offset);
+        bulk.update(values.data() + offset, n);
+        offset += n;
+    }
+
+    EXPECT_EQ(bulk.get_n(), sequential.get_n());
+    EXPECT_EQ(bulk.get_num_retained(), sequential.get_num_retained());
+    EXPECT_EQ(bulk.get_min_item(), sequential.get_min_item());
+    EXPECT_EQ(bulk.get_max_item(), sequential.get_max_item());
+
+    std::sort(values.begin(), values.end());
+    const double eps = bulk.get_normalized_rank_error(false);
+    for (double rank : {0.01, 0.25, 0.5, 0.75, 0.99}) {
+        const float quantile = bulk.get_quantile(rank);
+        const double true_rank = static_cast<double>(std::upper_bound(values.begin(), values.end(), quantile) - values.begin()) / values.size();
+        EXPECT_NEAR(true_rank, rank, 3 * eps);
+    }
+}
+
+TEST(KllSketchTest, BulkUpdateSkipsNaN) {
+    distributionBox sketch;
+    std::vector<float> values = {1.0f, std::numeric_limits<float>::quiet_NaN(), 3.0f};
+    sketch.update(values.data(), values.size());
+    EXPECT_EQ(sketch.get_n(), 2u);
+    EXPECT_EQ(sketch.get_min_item(), 1.0f);
+    EXPECT_EQ(sketch.get_max_item(), 3.0f);
+    sketch.update(values.data(), 0);
+    EXPECT_EQ(sketch.get_n(), 2u);
+
+    // Trailing NaNs after a full level 0 compact no more than update() does
+    distributionBox full(200), sequential(200);
+    for (int i = 0; i < 200; ++i) {
+        full.update(static_cast<float>(i));
+        sequential.update(static_cast<float>(i));
+    }
+    std::vector<float> nans(10, std::numeric_limits<float>::quiet_NaN());
+    full.update(nans.data(), nans.size());
+    for (const float nan : nans) sequential.update(nan);
+    EXPECT_EQ(full.get_num_retained(), 200u);
+    EXPECT_EQ(full.get_num_retained(), sequential.get_num_retained());
+    EXPECT_EQ(full.get_n(), 200u);
+}
+
+#ifdef KLL_SIMD_AVX2
+TEST(KllSketchTest, VectorizedHalvingMatchesScalar) {
+    if (!__builtin_cpu_supports("avx2")) GTEST_SKIP() << "no AVX2";
+    for (uint32_t half : {1u, 7u, 8u, 9u, 16u, 33u, 100u}) {
+        for (uint32_t offset : {0u, 1u}) {
+            std::vector<float> down(2 * half + 3), up(2 * half + 3);
+            for (size_t i = 0; i < down.size(); ++i) down[i] = up[i] = static_cast<float>(i);
+            std::vector<float> expected_down(down), expected_up(up);
+            for (uint32_t i = 0; i < half; ++i) expected_down[2 + i] = expected_down[2 + offset + 2 * i];
+            for (uint32_t i = 0, end = 2 + 2 * half; i < half; ++i) expected_up[end - 1 - i] = expected_up[end - 1 - offset - 2 * i];
+
+            datasketches::kll_simd::halve_down_avx2(down.data(), 2, half, offset);
+            datasketches::kll_simd::halve_up_avx2(up.data(), 2, half, offset);
+            EXPECT_EQ(down, expected_down) << "half " << half << " offset " << offset;
+            EXPECT_EQ(up, expected_up) << "half " << half << " offset " << offset;
+        }
+    }
+}
+
+TEST(KllSketchTest, VectorizedMergeMatchesScalar) {
+    if (!__builtin_cpu_supports("avx2")) GTEST_SKIP() << "no AVX2";
+    std::mt19937 gen(2);
+    std::uniform_int_distribution<int> dist(0, 50);  // many duplicates
+    for (uint32_t len_a : {8u, 9u, 31u, 64u, 200u}) {
+        for (uint32_t len_b : {8u, 15u, 40u, 257u}) {
+            // In-place layout of compress: a, then the output area ending with b
+            std::vector<float> buf(2 * len_a + len_b);
+            for (uint32_t i = 0; i < len_a; ++i) buf[i] = static_cast<float>(dist(gen));
+            for (uint32_t i = 0; i < len_b; ++i) buf[2 * len_a + i] = static_cast<float>(dist(gen));
+            std::sort(buf.begin(), buf.begin() + len_a);
+            std::sort(buf.begin() + 2 * len_a, buf.end());
+            std::vector<float> expected(len_a + len_b);
+            std::merge(buf.begin(), buf.begin() + len_a, buf.begin() + 2 * len_a, buf.end(), expected.begin());
+
+            ASSERT_TRUE(datasketches::kll_simd::merge_avx2(buf.data(), len_a, buf.data() + 2 * len_a, len_b, buf.data() + len_a));
+            EXPECT_TRUE(std::equal(expected.begin(), expected.end(), buf.begin() + len_a)) << len_a << " " << len_b;
+        }
+    }
+
+    std::vector<float> a(8, 1.0f), b(8, 2.0f), out(16);
+    a[0] = -0.0f;
+    EXPECT_FALSE(datasketches::kll_simd::merge_avx2(a.data(), 8, b.data(), 8, out.data()));
+}
+#endif
+
+TEST(KllSketchTest, VectorizedCompactionIsBitCompatible) {
+    std::mt19937 gen(3);
+    std::normal_distribution<float> dist(0.0f, 10.0f);
+    std::vector<float> values(200000);
+    for (auto& value : values) value = std::round(dist(gen) * 4.0f) / 4.0f + 0.5f;
+
+    auto build = [&values](bool simd) {
+        datasketches::kll_simd::set_enabled(simd);
+        datasketches::random_utils::random_bit.seed(7);
+        distributionBox first, second;
+        for (size_t i = 0; i < values.size(); ++i) {
+            (i % 3 ? first : second).update(values[i]);
+        }
+        first.merge(second);
+        datasketches::kll_simd::set_enabled(true);
+        return first.serialize();
+    };
+    EXPECT_EQ(build(true), build(false));
+}
+
+TEST(KllSketchTest, ViewMatchesDeserializedSketch) {
+    std::mt19937 gen(3);
+    std::normal_distribution<float> dist(50.0f, 10.0f);
+    for (const uint32_t n : {1u, 7u, 150u, 5000u, 200000u}) {
+        distributionBox sketch;
+        for (uint32_t i = 0; i < n; ++i) sketch.update(std::round(dist(gen)));
+        const auto bytes = sketch.serialize();
+        const distributionBox loaded = distributionBox::deserialize(bytes.data(), bytes.size());
+        const datasketches::kll_sketch_view<float> view(bytes.data(), bytes.size());
+
+        EXPECT_EQ(view.get_n(), loaded.get_n());
+        EXPECT_EQ(view.get_num_retained(), loaded.get_num_retained());
+        EXPECT_EQ(view.get_min_item(), loaded.get_min_item());
+        EXPECT_EQ(view.get_max_item(), loaded.get_max_item());
+        for (const bool inclusive : {true, false}) {
+            for (int i = 0; i <= 100; ++i) {
+                const double rank = i / 100.0;
+                EXPECT_EQ(view.get_quantile(rank, inclusive), loaded.get_quantile(rank, inclusive))
+                    << "n=" << n << " rank=" << rank;
+            }
+            for (float item = 0.0f; item <= 100.0f; item += 2.5f) {
+                EXPECT_EQ(view.get_rank(item, inclusive), loaded.get_rank(item, inclusive));
+            }
+            const float split_points[] = {30.0f, 45.0f, 50.0f, 55.0f, 70.0f};
+            double cdf[6];
+            view.get_CDF(split_points, 5, cdf, inclusive);
+            const auto expected = loaded.get_CDF(split_points, 5, inclusive);
+            for (int i = 0; i < 6; ++i) EXPECT_EQ(cdf[i], expected[i]);
+        }
+    }
+}
+
+TEST(KllSketchTest, ViewValidatesHeader) {
+    distributionBox empty;
+    const auto empty_bytes = empty.serialize();
+    const datasketches::kll_sketch_view<float> empty_view(empty_bytes.data(), empty_bytes.size());
+    EXPECT_TRUE(empty_view.is_empty());
+    EXPECT_THROW(empty_view.get_quantile(0.5), std::runtime_error);
+
+    distributionBox sketch;
+    for (int i = 0; i < 1000; ++i) sketch.update(static_cast<float>(i));
+    auto bytes = sketch.serialize();
+    EXPECT_THROW(datasketches::kll_sketch_view<float>(bytes.data(), bytes.size() - 4), std::invalid_argument);
+    EXPECT_THROW(datasketches::kll_sketch_view<float>(bytes.data(), 4), std::out_of_range);
+    auto wrong_family = bytes;
+    wrong_family[2] = 7;
+    EXPECT_THROW(datasketches::kll_sketch_view<float>(wrong_family.data(), wrong_family.size()), std::invalid_argument);
+    auto wrong_levels = bytes;
+    wrong_levels[20] += 1;  // first level offset
+    EXPECT_THROW(datasketches::kll_sketch_view<float>(wrong_levels.data(), wrong_levels.size()), std::invalid_argument);
+}
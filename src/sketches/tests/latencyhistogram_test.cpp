@@ -0,0 +1,64 @@
+#include "latencyhistogram.h"
+#include <gtest/gtest.h>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+TEST(LatencyHistogramTest, BucketBoundaries) {
+    for (uint64_t v : {0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456ull, (1ull << 35) + 7}) {
+        uint32_t index = LatencyHistogram::bucket_index(v);
+        ASSERT_LT(index, LatencyHistogram::NUM_BUCKETS);
+        EXPECT_LE(LatencyHistogram::bucket_lower_bound(index), v);
+        EXPECT_GT(LatencyHistogram::bucket_lower_bound(index) + LatencyHistogram::bucket_width(index), v);
+    }
+    EXPECT_EQ(LatencyHistogram::bucket_index(1ull << 40), LatencyHistogram::NUM_BUCKETS - 1);
+}
+
+TEST(LatencyHistogramTest, PercentilesWithinRelativeError) {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 10000; ++i) {
+        histogram.record(i * 0.01f);  // 0.01 ms .. 100 ms
+    }
+    EXPECT_EQ(histogram.get_n(), 10000u);
+    EXPECT_NEAR(histogram.get_quantile(0.5), 50.0, 50.0 * 0.04);
+    EXPECT_NEAR(histogram.get_quantile(0.99), 99.0, 99.0 * 0.04);
+    EXPECT_NEAR(histogram.get_quantile(0.999), 99.9, 99.9 * 0.04);
+}
+
+TEST(LatencyHistogramTest, IgnoresInvalidValues) {
+    LatencyHistogram histogram;
+    histogram.record(-1.0f);
+    histogram.record(std::numeric_limits<float>::quiet_NaN());
+    EXPECT_EQ(histogram.get_n(), 0u);
+    EXPECT_EQ(histogram.get_quantile(0.5), 0.0);
+    histogram.record(std::numeric_limits<float>::infinity());
+    EXPECT_EQ(histogram.get_n(), 1u);
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecording) {
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&histogram, t]() {
+            for (int i = 0; i < 100000; ++i) histogram.record(1.0f + t);
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(histogram.get_n(), 400000u);
+}
+
+TEST(LatencyHistogramTest, MergeAndSerialize) {
+    LatencyHistogram a, b;
+    for (int i = 0; i < 100; ++i) a.record(5.0f);
+    for (int i = 0; i < 300; ++i) b.record(20.0f);
+    a.merge(b);
+    EXPECT_EQ(a.get_n(), 400u);
+
+    std::stringstream ss;
+    a.serialize(ss);
+    LatencyHistogram restored = LatencyHistogram::deserialize(ss);
+    EXPECT_EQ(restored.get_n(), 400u);
+    EXPECT_EQ(restored.get_quantile(0.2), a.get_quantile(0.2));
+    EXPECT_EQ(restored.get_quantile(0.9), a.get_quantile(0.9));
+}
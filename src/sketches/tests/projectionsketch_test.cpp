@@ -0,0 +1,117 @@
+#include "projectionsketch.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Helper to generate count x dims gaussian embeddings around the given mean
+static std::vector<float> makeEmbeddings(size_t count, uint32_t dims, float mean, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> dist(mean, 1.0f);
+    std::vector<float> embeddings(count * dims);
+    for (auto& value : embeddings) value = dist(gen);
+    return embeddings;
+}
+
+TEST(ProjectionSketchTest, SameSeedSameProjection) {
+    ProjectionSketch a(16, 8, 7);
+    ProjectionSketch b(16, 8, 7);
+    ProjectionSketch c(16, 8, 8);
+    auto embeddings = makeEmbeddings(1, 16, 0.0f, 1);
+    std::vector<float> pa(8), pb(8), pc(8);
+    a.project(embeddings.data(), 1, pa.data());
+    b.project(embeddings.data(), 1, pb.data());
+    c.project(embeddings.data(), 1, pc.data());
+    EXPECT_EQ(pa, pb);
+    EXPECT_NE(pa, pc);
+}
+
+TEST(ProjectionSketchTest, BatchMatchesSingleProjection) {
+    const uint32_t dims = 37;
+    ProjectionSketch sketch(dims, 32);
+    auto embeddings = makeEmbeddings(5, dims, 0.0f, 2);
+    std::vector<float> batch(5 * 32);
+    sketch.project(embeddings.data(), 5, batch.data());
+    for (size_t row = 0; row < 5; ++row) {
+        std::vector<float> single(32);
+        sketch.project(embeddings.data() + row * dims, 1, single.data());
+        for (size_t p = 0; p < 32; ++p) {
+            EXPECT_NEAR(single[p], batch[row * 32 + p], 1e-5);
+        }
+    }
+}
+
+TEST(ProjectionSketchTest, DriftScoreAgainstBaseline) {
+    const uint32_t dims = 24;
+    ProjectionSketch baseline(dims);
+    auto base_data = makeEmbeddings(2000, dims, 0.0f, 3);
+    baseline.update(base_data.data(), 2000);
+    const std::string path = "projection_baseline.bin";
+    {
+        std::ofstream os(path, std::ios::binary);
+        baseline.serialize(os);
+    }
+
+    ProjectionSketch same(dims);
+    auto same_data = makeEmbeddings(2000, dims, 0.0f, 4);
+    same.update(same_data.data(), 2000);
+    ASSERT_TRUE(same.load_baseline(path));
+
+    ProjectionSketch shifted(dims);
+    auto shifted_data = makeEmbeddings(2000, dims, 1.0f, 5);
+    shifted.update(shifted_data.data(), 2000);
+    ASSERT_TRUE(shifted.load_baseline(path));
+
+    EXPECT_LT(same.compute_drift_score(), 0.05);
+    EXPECT_GT(shifted.compute_drift_score(), 10 * same.get_drift_score());
+
+    ProjectionSketch other_seed(dims, 32, 1);
+    EXPECT_FALSE(other_seed.load_baseline(path));
+    EXPECT_TRUE(std::isnan(other_seed.compute_drift_score()));
+    std::remove(path.c_str());
+}
+
+TEST(ProjectionSketchTest, MergeAndSerialize) {
+    const uint32_t dims = 8;
+    ProjectionSketch a(dims, 4);
+    ProjectionSketch b(dims, 4);
+    auto data = makeEmbeddings(100, dims, 0.0f, 6);
+    a.update(data.data(), 60);
+    b.update(data.data() + 60 * dims, 40);
+    a.merge(b);
+    EXPECT_EQ(a.get_n(), 100u);
+    EXPECT_EQ(a.get_sketches()[0].get_n(), 100u);
+    EXPECT_THROW(a.merge(ProjectionSketch(dims, 4, 9)), std::invalid_argument);
+
+    std::stringstream ss;
+    a.serialize(ss);
+    ProjectionSketch restored = ProjectionSketch::deserialize(ss);
+    EXPECT_EQ(restored.get_n(), 100u);
+    EXPECT_EQ(restored.get_projections(), 4);
+    EXPECT_EQ(restored.get_sketches()[3].get_quantile(0.5), a.get_sketches()[3].get_quantile(0.5));
+}
+
+TEST(ProjectionSketchTest, SerializeWhileUpdating) {
+    const uint32_t dims = 16;
+    ProjectionSketch sketch(dims, 8);
+    auto data = makeEmbeddings(4000, dims, 0.0f, 7);
+    std::thread writer([&]() {
+        for (size_t i = 0; i < 4000; i += 10) {
+            sketch.update(data.data() + i * dims, 10);
+        }
+    });
+    uint64_t last_n = 0;
+    for (int i = 0; i < 50; ++i) {
+        std::stringstream ss;
+        sketch.serialize(ss);
+        ProjectionSketch restored = ProjectionSketch::deserialize(ss);
+        EXPECT_GE(restored.get_n(), last_n);
+        EXPECT_EQ(restored.get_sketches()[0].get_n(), restored.get_n());
+        last_n = restored.get_n();
+    }
+    writer.join();
+    EXPECT_EQ(sketch.get_n(), 4000u);
+}
@@ -0,0 +1,88 @@
+#include "reqsketch.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <vector>
+
+static std::vector<float> shuffledRange(uint32_t n, uint32_t seed) {
+    std::vector<float> values(n);
+    std::iota(values.begin(), values.end(), 0.0f);
+    std::mt19937 rng(seed);
+    std::shuffle(values.begin(), values.end(), rng);
+    return values;
+}
+
+TEST(ReqSketchTest, ExactBelowCapacity) {
+    ReqSketch sketch;
+    EXPECT_TRUE(sketch.is_empty());
+    EXPECT_THROW(sketch.get_quantile(0.5), std::runtime_error);
+    for (int i = 1; i <= 50; ++i) sketch.update(static_cast<float>(i));
+    sketch.update(std::numeric_limits<float>::quiet_NaN());
+    EXPECT_EQ(sketch.get_n(), 50u);
+    EXPECT_EQ(sketch.get_num_retained(), 50u);
+    EXPECT_EQ(sketch.get_min_item(), 1.0f);
+    EXPECT_EQ(sketch.get_max_item(), 50.0f);
+    EXPECT_EQ(sketch.get_quantile(0.5), 25.0f);
+    EXPECT_DOUBLE_EQ(sketch.get_rank(40.0f), 0.8);
+}
+
+TEST(ReqSketchTest, HighRanksHaveRelativeError) {
+    const uint32_t n = 1000000;
+    ReqSketch sketch;
+    for (float value : shuffledRange(n, 1)) sketch.update(value);
+    EXPECT_EQ(sketch.get_n(), n);
+    EXPECT_LT(sketch.get_num_retained(), n / 100);
+
+    // the error of a rank r is a fraction of 1 - r
+    for (double rank : {0.9, 0.99, 0.999, 0.9999}) {
+        const double estimated = sketch.get_rank(static_cast<float>(rank * n));
+        EXPECT_NEAR(estimated, rank, 0.05 * (1.0 - rank)) << "rank " << rank;
+    }
+    EXPECT_EQ(sketch.get_quantile(1.0), n - 1.0f);
+}
+
+TEST(ReqSketchTest, MergeKeepsAccuracy) {
+    const uint32_t n = 200000;
+    const std::vector<float> values = shuffledRange(n, 2);
+    ReqSketch merged;
+    for (int part = 0; part < 4; ++part) {
+        ReqSketch sketch;
+        sketch.update(values.data() + part * n / 4, n / 4);
+        merged.merge(sketch);
+    }
+    EXPECT_EQ(merged.get_n(), n);
+    EXPECT_EQ(merged.get_min_item(), 0.0f);
+    EXPECT_EQ(merged.get_max_item(), n - 1.0f);
+    for (double rank : {0.99, 0.999}) {
+        EXPECT_NEAR(merged.get_rank(static_cast<float>(rank * n)), rank, 0.05 * (1.0 - rank));
+    }
+
+    ReqSketch low_ranks(ReqSketch::DEFAULT_K, ArenaAllocator<float>(), false);
+    low_ranks.update(1.0f);
+    EXPECT_THROW(merged.merge(low_ranks), std::invalid_argument);
+}
+
+TEST(ReqSketchTest, SerializeRoundTrip) {
+    ReqSketch sketch(20);
+    for (float value : shuffledRange(100000, 3)) sketch.update(value);
+    std::stringstream ss;
+    sketch.serialize(ss);
+    ReqSketch restored = ReqSketch::deserialize(ss);
+    EXPECT_EQ(restored.get_k(), 20);
+    EXPECT_EQ(restored.get_n(), sketch.get_n());
+    EXPECT_EQ(restored.get_num_retained(), sketch.get_num_retained());
+    for (double rank : {0.1, 0.5, 0.99, 0.999}) {
+        EXPECT_EQ(restored.get_quantile(rank), sketch.get_quantile(rank));
+    }
+
+    // the restored sketch keeps compacting like the original
+    restored.update(1.0f);
+    EXPECT_EQ(restored.get_n(), 100001u);
+
+    std::stringstream garbage("not a sketch");
+    EXPECT_THROW(ReqSketch::deserialize(garbage), std::invalid_argument);
+}
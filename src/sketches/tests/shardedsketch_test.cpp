@@ -0,0 +1,259 @@
+#include "shardedsketch.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+TEST(ShardedSketchTest, SingleThreadMatchesPlainSketch) {
+    ShardedSketch sharded;
+    distributionBox plain;
+    // Fewer items than k, so no randomized compaction makes the sketches differ
+    for (int i = 0; i < 150; ++i) {
+        sharded.update(static_cast<float>(i));
+        plain.update(static_cast<float>(i));
+    }
+    EXPECT_EQ(sharded.get_num_shards(), 1u);
+
+    std::stringstream sharded_stream, plain_stream;
+    sharded.serialize(sharded_stream);
+    plain.serialize(plain_stream);
+    EXPECT_EQ(sharded_stream.str(), plain_stream.str());
+}
+
+TEST(ShardedSketchTest, ConcurrentUpdatesCreateOneShardPerThread) {
+    ShardedSketch sharded;
+    const int num_threads = 4;
+    const int per_thread = 20000;
+    std::atomic<int> done(0);
+    std::atomic<bool> exit(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&sharded, &done, &exit, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                sharded.update(static_cast<float>(t * per_thread + i));
+            }
+            done.fetch_add(1);
+            while (!exit.load()) std::this_thread::yield();
+        });
+    }
+    while (done.load() < num_threads) std::this_thread::yield();
+    EXPECT_EQ(sharded.get_num_shards(), static_cast<size_t>(num_threads));
+    const uint64_t version = sharded.get_version();
+    exit.store(true);
+    for (auto& thread : threads) thread.join();
+
+    // The exited threads left their updates in the retired ring
+    EXPECT_EQ(sharded.get_num_shards(), 0u);
+    EXPECT_EQ(sharded.get_version(), version);
+    distributionBox merged = sharded.get_merged();
+    EXPECT_EQ(merged.get_n(), static_cast<uint64_t>(num_threads * per_thread));
+    EXPECT_EQ(merged.get_min_item(), 0.0f);
+    EXPECT_EQ(merged.get_max_item(), static_cast<float>(num_threads * per_thread - 1));
+    EXPECT_NEAR(merged.get_rank(num_threads * per_thread / 2.0f), 0.5, 0.02);
+}
+
+TEST(ShardedSketchTest, ReqShardsMergeIntoReqSketch) {
+    ShardedReqSketch sharded;
+    const int num_threads = 4;
+    const int per_thread = 50000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&sharded, t]() {
+            for (int i = 0; i < per_thread; ++i) {
+                sharded.update(static_cast<float>(i * num_threads + t));
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    const float n = static_cast<float>(num_threads * per_thread);
+    ReqSketch merged = sharded.get_merged();
+    EXPECT_EQ(merged.get_k(), ReqSketch::DEFAULT_K);
+    EXPECT_EQ(merged.get_n(), static_cast<uint64_t>(n));
+    EXPECT_NEAR(merged.get_rank(0.999f * n), 0.999, 0.0001);
+
+    std::stringstream ss;
+    sharded.serialize(ss);
+    EXPECT_EQ(ReqSketch::deserialize(ss).get_n(), merged.get_n());
+}
+
+TEST(ShardedSketchTest, SerializesWhileUpdating) {
+    ShardedSketch sharded;
+    std::thread writer([&sharded]() {
+        std::vector<float> batch(256, 1.0f);
+        for (int i = 0; i < 2000; ++i) {
+            sharded.update(batch.data(), batch.size());
+        }
+    });
+    for (int i = 0; i < 50; ++i) {
+        std::stringstream ss;
+        sharded.serialize(ss);
+        distributionBox loaded = distributionBox::deserialize(ss);
+        EXPECT_LE(loaded.get_n(), 2000u * 256u);
+    }
+    writer.join();
+
+    std::stringstream ss;
+    sharded.serialize(ss);
+    EXPECT_EQ(distributionBox::deserialize(ss).get_n(), 2000u * 256u);
+}
+
+TEST(ShardedSketchTest, ThreadCachesAreKeptPerSketch) {
+    auto* first = new ShardedSketch();
+    first->update(1.0f);
+    delete first;
+
+    // A new sketch may reuse the address, it still has to get a shard of its own
+    ShardedSketch second;
+    second.update(2.0f);
+    EXPECT_EQ(second.get_num_shards(), 1u);
+    EXPECT_EQ(second.get_merged().get_n(), 1u);
+}
+
+TEST(ShardedSketchTest, SnapshotBufferDrainsEveryWrite) {
+    SnapshotBuffer<uint64_t> buffer(0);
+    const uint64_t writes = 200000;
+    std::thread writer([&buffer]() {
+        for (uint64_t i = 0; i < writes; ++i) {
+            buffer.write([](uint64_t& count) { ++count; });
+        }
+    });
+    uint64_t drained = 0;
+    auto drain = [&drained](uint64_t& count) {
+        drained += count;
+        count = 0;
+    };
+    while (drained < writes) {
+        buffer.drain(drain);
+    }
+    writer.join();
+    buffer.drain(drain);
+    buffer.drain(drain);
+    EXPECT_EQ(drained, writes);
+}
+
+namespace {
+uint64_t fake_seconds = 0;
+uint64_t fake_clock() { return fake_seconds; }
+}
+
+TEST(ShardedSketchTest, WindowFromConfig) {
+    SketchWindow window = SketchWindow::fromConfig({"60", "60"});
+    EXPECT_TRUE(window.enabled());
+    EXPECT_EQ(window.intervals, 60u);
+    EXPECT_EQ(window.interval_seconds, 60u);
+    EXPECT_FALSE(SketchWindow::fromConfig({}).enabled());
+    EXPECT_FALSE(SketchWindow::fromConfig({"60", "minute"}).enabled());
+}
+
+TEST(ShardedSketchTest, WindowDropsExpiredIntervals) {
+    fake_seconds = 1000;
+    ShardedSketch sharded(200, ArenaAllocator<float>(), SketchWindow{3, 10});
+    sharded.clock_ = &fake_clock;
+
+    for (int interval = 0; interval < 5; ++interval) {
+        for (int i = 0; i < 10; ++i) {
+            sharded.update(static_cast<float>(interval));
+        }
+        distributionBox merged = sharded.get_merged();
+        EXPECT_EQ(merged.get_n(), 10u * std::min(interval + 1, 3));
+        EXPECT_EQ(merged.get_max_item(), static_cast<float>(interval));
+        EXPECT_EQ(merged.get_min_item(), static_cast<float>(std::max(interval - 2, 0)));
+        fake_seconds += 10;
+    }
+
+    // Without updates the window keeps sliding until it is empty
+    EXPECT_EQ(sharded.get_merged().get_n(), 20u);
+    fake_seconds += 10;
+    EXPECT_EQ(sharded.get_merged().get_n(), 10u);
+    fake_seconds += 10;
+    EXPECT_TRUE(sharded.get_merged().is_empty());
+}
+
+TEST(ShardedSketchTest, WindowRecyclesBucketsBetweenDrains) {
+    fake_seconds = 0;
+    ShardedSketch sharded(200, ArenaAllocator<float>(), SketchWindow{2, 1});
+    sharded.clock_ = &fake_clock;
+    // The ring wraps around twice without a drain, only the last window survives
+    for (int second = 0; second < 5; ++second) {
+        fake_seconds = second;
+        sharded.update(static_cast<float>(second));
+    }
+    distributionBox merged = sharded.get_merged();
+    EXPECT_EQ(merged.get_n(), 2u);
+    EXPECT_EQ(merged.get_min_item(), 3.0f);
+    EXPECT_EQ(merged.get_max_item(), 4.0f);
+}
+
+TEST(ShardedSketchTest, WindowAllocatesOnlyUpdatedBuckets) {
+    fake_seconds = 0;
+    SketchArena::Account* account = SketchArena::instance().account("WindowMemoryTest");
+    ShardedSketch sharded(200, arenaAllocator("WindowMemoryTest"), SketchWindow{60, 1});
+    sharded.clock_ = &fake_clock;
+    const int64_t before = account->bytes_in_use;
+    sharded.update(1.0f);
+    // One sketch of 200 items, not one per bucket of the two live rings and the total
+    const int64_t one_bucket = account->bytes_in_use - before;
+    EXPECT_GT(one_bucket, 0);
+    EXPECT_LT(one_bucket, 2 * 1024);
+
+    // A drained bucket moves, the live rings hold no sketch until the next update
+    EXPECT_EQ(sharded.get_merged().get_n(), 1u);
+    size_t buckets = 0;
+    for (const auto& bucket : sharded.shards_[0]->total) {
+        buckets += bucket.sketch.has_value();
+    }
+    EXPECT_EQ(buckets, 1u);
+
+    // A recycled bucket frees its sketch until its new interval is updated
+    fake_seconds = 60;
+    sharded.update(2.0f);
+    EXPECT_EQ(sharded.get_merged().get_n(), 1u);
+    EXPECT_EQ(sharded.shards_[0]->total[0].sketch->get_n(), 1u);
+}
+
+TEST(ShardedSketchTest, CachedWindowIsReusedUntilUpdated) {
+    ShardedSketch sharded;
+    sharded.update(1.0f);
+    EXPECT_EQ(sharded.get_merged().get_n(), 1u);
+    EXPECT_TRUE(sharded.cache_valid_);
+    EXPECT_EQ(sharded.get_merged().get_n(), 1u);
+    sharded.update(2.0f);
+    EXPECT_EQ(sharded.get_merged().get_n(), 2u);
+    EXPECT_FALSE(sharded.set_window(SketchWindow{60, 60}));
+}
+
+TEST(ShardedSketchTest, RestoredSnapshotMergesWithUpdates) {
+    distributionBox snapshot;
+    for (int i = 0; i < 100; ++i) {
+        snapshot.update(static_cast<float>(i));
+    }
+    ShardedSketch sharded;
+    sharded.restore(snapshot);
+    EXPECT_EQ(sharded.get_version(), 100u);
+    EXPECT_EQ(sharded.get_merged().get_n(), 100u);
+
+    sharded.update(1000.0f);
+    const distributionBox merged = sharded.get_merged();
+    EXPECT_EQ(merged.get_n(), 101u);
+    EXPECT_EQ(merged.get_min_item(), 0.0f);
+    EXPECT_EQ(merged.get_max_item(), 1000.0f);
+    EXPECT_EQ(sharded.get_num_shards(), 1u);
+}
+
+TEST(ShardedSketchTest, ThreadsExitAfterTheSketch) {
+    auto* sharded = new ShardedSketch();
+    std::atomic<bool> updated(false);
+    std::atomic<bool> exit(false);
+    std::thread thread([sharded, &updated, &exit]() {
+        sharded->update(1.0f);
+        updated.store(true);
+        while (!exit.load()) std::this_thread::yield();
+    });
+    while (!updated.load()) std::this_thread::yield();
+    // The exiting thread must not touch the destroyed sketch
+    delete sharded;
+    exit.store(true);
+    thread.join();
+}
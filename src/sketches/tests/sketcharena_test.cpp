@@ -0,0 +1,143 @@
+#include "sketcharena.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+class SketchArenaTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // The arena is process-wide, the first reservation wins
+        SketchArena::instance().reserve(ARENA_SIZE);
+    }
+
+    static constexpr size_t ARENA_SIZE = 1 << 20;
+};
+
+TEST_F(SketchArenaTest, SizeClasses) {
+    EXPECT_EQ(SketchArena::size_class(1), 0u);
+    EXPECT_EQ(SketchArena::size_class(16), 0u);
+    EXPECT_EQ(SketchArena::size_class(17), 1u);
+    EXPECT_EQ(SketchArena::size_class(32), 1u);
+    EXPECT_EQ(SketchArena::size_class(800), 6u);  // 1024 byte block
+}
+
+TEST_F(SketchArenaTest, ReservesOnlyOnce) {
+    EXPECT_EQ(SketchArena::instance().get_capacity(), ARENA_SIZE);
+    EXPECT_FALSE(SketchArena::instance().reserve(2 * ARENA_SIZE));
+    EXPECT_EQ(SketchArena::instance().get_capacity(), ARENA_SIZE);
+}
+
+TEST_F(SketchArenaTest, LaterConfigsKeepTheArena) {
+    const std::string conf_path = "/tmp/sketcharena_test.ini";
+    {
+        std::ofstream ini_file(conf_path, std::ios::trunc);
+        ini_file << "[generic]\n";
+        ini_file << "sketch_arena_kb = " << 4 * ARENA_SIZE / 1024 << "\n";
+    }
+    // A conflicting size is only logged, the first reservation stays
+    EXPECT_FALSE(SketchArena::instance().configure(conf_path));
+    EXPECT_EQ(SketchArena::instance().get_capacity(), ARENA_SIZE);
+    EXPECT_FALSE(SketchArena::instance().configure("/tmp/sketcharena_missing.ini"));
+    std::remove(conf_path.c_str());
+}
+
+TEST_F(SketchArenaTest, FreedBlocksAreReused) {
+    SketchArena& arena = SketchArena::instance();
+    SketchArena::Account* account = arena.account("ReuseTest");
+    void* first = arena.allocate(100, account);
+    const size_t used = arena.get_used();
+    arena.deallocate(first, 100, account);
+    void* second = arena.allocate(120, account);  // same 128 byte class
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(arena.get_used(), used);
+    EXPECT_EQ(account->bytes_in_use, 128);
+    arena.deallocate(second, 120, account);
+    EXPECT_EQ(account->bytes_in_use, 0);
+    EXPECT_EQ(account->peak_bytes, 128);
+    EXPECT_EQ(account->heap_allocations, 0u);
+}
+
+TEST_F(SketchArenaTest, FallsBackToHeapWhenFull) {
+    SketchArena& arena = SketchArena::instance();
+    SketchArena::Account* account = arena.account("FullTest");
+    void* block = arena.allocate(2 * ARENA_SIZE, account);
+    ASSERT_NE(block, nullptr);
+    EXPECT_EQ(account->heap_allocations, 1u);
+    arena.deallocate(block, 2 * ARENA_SIZE, account);
+    EXPECT_EQ(account->bytes_in_use, 0);
+}
+
+TEST_F(SketchArenaTest, OversizedRequestsGoToTheHeap) {
+    SketchArena& arena = SketchArena::instance();
+    SketchArena::Account* account = arena.account("OversizedTest");
+    // Above the largest size class, where the block size would overflow
+    const size_t bytes = size_t(1) << 62;
+    EXPECT_GE(SketchArena::size_class(bytes), SketchArena::NUM_SIZE_CLASSES);
+    const size_t used = arena.get_used();
+    EXPECT_THROW(arena.allocate(bytes, account), std::bad_alloc);
+    EXPECT_EQ(arena.get_used(), used);
+    EXPECT_EQ(account->bytes_in_use, 0);
+    EXPECT_EQ(account->allocations, 0u);
+}
+
+TEST_F(SketchArenaTest, ConcurrentAllocations) {
+    SketchArena& arena = SketchArena::instance();
+    SketchArena::Account* account = arena.account("ConcurrentTest");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&arena, account, t]() {
+            std::vector<std::pair<void*, size_t>> blocks;
+            for (int i = 0; i < 10000; ++i) {
+                if (blocks.size() == 8) {
+                    for (const auto& block : blocks) {
+                        arena.deallocate(block.first, block.second, account);
+                    }
+                    blocks.clear();
+                }
+                const size_t bytes = size_t(16) << ((i + t) % 6);
+                blocks.emplace_back(arena.allocate(bytes, account), bytes);
+            }
+            for (const auto& block : blocks) {
+                arena.deallocate(block.first, block.second, account);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(account->bytes_in_use, 0);
+    EXPECT_EQ(account->allocations, 40000u);
+}
+
+TEST_F(SketchArenaTest, SketchesAreChargedToTheirProfile) {
+    SketchArena& arena = SketchArena::instance();
+    auto fill = []() {
+        distributionBox sketch(200, std::less<float>(), arenaAllocator("SketchTest"));
+        for (int i = 0; i < 100000; ++i) {
+            sketch.update(static_cast<float>(i));
+        }
+        EXPECT_GT(SketchArena::instance().account("SketchTest")->bytes_in_use, 0);
+        EXPECT_GT(sketch.get_quantile(0.5), 0.0f);
+    };
+
+    fill();
+    EXPECT_EQ(arena.account("SketchTest")->bytes_in_use, 0);
+    EXPECT_EQ(arena.account("SketchTest")->heap_allocations, 0u);
+
+    // After warm-up a sketch of the same shape only reuses freed blocks
+    const size_t used = arena.get_used();
+    fill();
+    EXPECT_EQ(arena.get_used(), used);
+    EXPECT_EQ(arena.account("SketchTest")->heap_allocations, 0u);
+
+    std::stringstream report;
+    arena.report(report);
+    EXPECT_NE(report.str().find("SketchTest in_use=0"), std::string::npos);
+
+    std::stringstream profile_report;
+    arena.report(profile_report, "SketchTest");
+    EXPECT_EQ(profile_report.str().rfind("SketchTest in_use=0 peak=", 0), 0u);
+    std::stringstream missing_report;
+    arena.report(missing_report, "NoSuchProfile");
+    EXPECT_TRUE(missing_report.str().empty());
+}
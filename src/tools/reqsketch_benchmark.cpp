@@ -0,0 +1,176 @@
+/**
+ * @file reqsketch_benchmark.cpp
+ * @brief Compares ReqSketch with kll_sketch<float> on metric-like streams
+ *
+ * Usage: reqsketch_benchmark [--n N] [--input values.txt]
+ *
+ * For every stream and sketch the tool prints the update throughput, the
+ * memory the sketch holds in its arena account after the stream, its
+ * serialized size, and the rank error at the median and the tail ranks.
+ * The rank error of a rank r is |rank(exact quantile of r) - r|, the tail
+ * error divides it by 1 - r, so 1.0 means the error is as large as the tail.
+ *
+ * The built-in streams model the metrics the profiles record: inference
+ * latency (log-normal with rare 10x stalls), image sharpness (Pareto, a few
+ * very sharp frames), SNR noise (normal) and CPU usage (bounded).
+ * --input replaces them by one recorded stream, one value per line.
+ */
+
+#include "reqsketch.h"
+#include "sketcharena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <kll_sketch.hpp>
+
+static const double RANKS[] = {0.5, 0.99, 0.999, 0.9999};
+
+struct Stream {
+    std::string name;
+    std::vector<float> values;
+};
+
+static std::vector<Stream> syntheticStreams(size_t n) {
+    std::mt19937_64 rng(42);
+    std::lognormal_distribution<float> latency(2.0f, 0.35f);
+    std::bernoulli_distribution stall(0.002);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::normal_distribution<float> snr(12.0f, 3.0f);
+    std::normal_distribution<float> cpu(35.0f, 12.0f);
+
+    std::vector<Stream> streams = {{"latency_ms", {}}, {"sharpness", {}}, {"noise_snr", {}}, {"cpu_usage", {}}};
+    for (auto& stream : streams) stream.values.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        streams[0].values.push_back(latency(rng) * (stall(rng) ? 10.0f : 1.0f));
+        // Pareto with x_min 20 and alpha 1.5
+        streams[1].values.push_back(20.0f / std::pow(1.0f - uniform(rng), 1.0f / 1.5f));
+        streams[2].values.push_back(snr(rng));
+        streams[3].values.push_back(std::min(100.0f, std::max(0.0f, cpu(rng))));
+    }
+    return streams;
+}
+
+static bool readStream(const std::string& path, Stream& stream) {
+    std::ifstream is(path);
+    if (!is) return false;
+    stream.name = path;
+    float value;
+    while (is >> value) stream.values.push_back(value);
+    return !stream.values.empty();
+}
+
+struct Result {
+    double ns_per_update;
+    int64_t arena_bytes;
+    size_t serialized_bytes;
+    uint32_t retained;
+    std::vector<double> rank_errors;
+};
+
+// Averages the rank errors over a few runs, the compactions of both sketches are randomized
+template <typename Sketch, typename Make>
+static Result run(const Stream& stream, const std::vector<float>& sorted, Make make, int runs) {
+    Result result{0, 0, 0, 0, std::vector<double>(std::size(RANKS), 0.0)};
+    for (int r = 0; r < runs; ++r) {
+        SketchArena::Account* account = SketchArena::instance().account("benchmark");
+        const int64_t bytes_before = account->bytes_in_use;
+        {
+            Sketch sketch = make(ArenaAllocator<float>(account));
+            const auto start = std::chrono::steady_clock::now();
+            for (float value : stream.values) sketch.update(value);
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+            result.ns_per_update += elapsed.count() / stream.values.size() / runs;
+            result.arena_bytes = account->bytes_in_use - bytes_before;
+            result.retained = sketch.get_num_retained();
+
+            std::stringstream ss;
+            sketch.serialize(ss);
+            result.serialized_bytes = ss.str().size();
+
+            for (size_t i = 0; i < std::size(RANKS); ++i) {
+                const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(RANKS[i] * sorted.size()));
+                const float exact = sorted[index];
+                // exact rank of the value, ties included
+                const double exact_rank = static_cast<double>(
+                    std::upper_bound(sorted.begin(), sorted.end(), exact) - sorted.begin()) / sorted.size();
+                result.rank_errors[i] += std::abs(sketch.get_rank(exact) - exact_rank) / runs;
+            }
+        }
+    }
+    return result;
+}
+
+static void print(const std::string& stream, const std::string& sketch, const Result& result) {
+    std::cout << std::left << std::setw(12) << stream << std::setw(12) << sketch << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << result.ns_per_update
+              << std::setw(12) << result.arena_bytes << std::setw(12) << result.serialized_bytes
+              << std::setw(10) << result.retained;
+    for (size_t i = 0; i < std::size(RANKS); ++i) {
+        std::cout << std::scientific << std::setprecision(2) << std::setw(11) << result.rank_errors[i]
+                  << std::fixed << std::setprecision(3) << std::setw(8) << result.rank_errors[i] / (1.0 - RANKS[i]);
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t n = 1000000;
+    int runs = 5;
+    std::string input;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--n" && i + 1 < argc) {
+            n = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--runs" && i + 1 < argc) {
+            runs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--input" && i + 1 < argc) {
+            input = argv[++i];
+        } else {
+            std::cerr << "usage: reqsketch_benchmark [--n N] [--runs R] [--input values.txt]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<Stream> streams;
+    if (input.empty()) {
+        streams = syntheticStreams(n);
+    } else {
+        streams.emplace_back();
+        if (!readStream(input, streams.back())) {
+            std::cerr << "no values in " << input << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cout << std::left << std::setw(12) << "stream" << std::setw(12) << "sketch" << std::right
+              << std::setw(10) << "ns/update" << std::setw(12) << "arena_B" << std::setw(12) << "serial_B"
+              << std::setw(10) << "retained";
+    for (double rank : RANKS) {
+        std::ostringstream label;
+        label << "p" << rank * 100;
+        std::cout << std::setw(11) << label.str() + "_err" << std::setw(8) << "/tail";
+    }
+    std::cout << std::endl;
+
+    typedef datasketches::kll_sketch<float, std::less<float>, ArenaAllocator<float>> kll_type;
+    for (const Stream& stream : streams) {
+        std::vector<float> sorted = stream.values;
+        std::sort(sorted.begin(), sorted.end());
+        for (uint16_t k : {200, 400}) {
+            print(stream.name, "kll k=" + std::to_string(k), run<kll_type>(stream, sorted,
+                  [k](const ArenaAllocator<float>& allocator) { return kll_type(k, std::less<float>(), allocator); }, runs));
+        }
+        for (uint16_t k : {12, 24}) {
+            print(stream.name, "req k=" + std::to_string(k), run<ReqSketch>(stream, sorted,
+                  [k](const ArenaAllocator<float>& allocator) { return ReqSketch(k, allocator); }, runs));
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file sketchquery_cli.cpp
+ * @brief Command line tool printing merged quantiles of saved sketch directories
+ *
+ * Usage: sketchquery [--format csv|json] [--ranks 0.5,0.9] [--cdf 10,20]
+ *                    [--threads N] <file or directory>...
+ */
+
+#include "sketchquery.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+static const char* USAGE =
+    "usage: sketchquery [--format csv|json] [--ranks r1,r2,...] [--cdf x1,x2,...] [--threads N] path...\n"
+    "  Merges the KLL sketches of all *.bin files below the paths by file name and\n"
+    "  prints min, max, quantiles and CDF of every metric.\n";
+
+template <typename T>
+static bool parseList(const std::string& value, std::vector<T>& out) {
+    out.clear();
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        try {
+            out.push_back(static_cast<T>(std::stod(item)));
+        } catch (const std::exception& e) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string format = "csv";
+    std::vector<double> ranks = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+    std::vector<float> split_points;
+    unsigned threads = 0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--format" && has_value) {
+            format = argv[++i];
+        } else if (arg == "--ranks" && has_value) {
+            if (!parseList(argv[++i], ranks)) {
+                std::cerr << "invalid ranks: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--cdf" && has_value) {
+            if (!parseList(argv[++i], split_points)) {
+                std::cerr << "invalid split points: " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg == "--threads" && has_value) {
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "-h" || arg == "--help" || arg.rfind("--", 0) == 0) {
+            std::cerr << USAGE;
+            return arg == "-h" || arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || (format != "csv" && format != "json")) {
+        std::cerr << USAGE;
+        return EXIT_FAILURE;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    SketchQuery query(threads);
+    size_t files = 0;
+    for (const auto& path : paths) {
+        files = query.addPath(path);
+    }
+    query.run();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    try {
+        if (format == "json") {
+            query.writeJson(std::cout, ranks, split_points);
+        } else {
+            query.writeCsv(std::cout, ranks, split_points);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "query failed: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cerr << files << " files, " << query.getMetrics().size() << " metrics, "
+              << query.getSkipped() << " skipped in " << elapsed.count() << " ms" << std::endl;
+    return EXIT_SUCCESS;
+}